@@ -0,0 +1,120 @@
+// Dissolve.cpp
+//
+// Fixed point cross dissolve of rows of RGBA pixels. See Dissolve.h.
+//
+
+#include <iostream>
+#include <math.h>
+#include "Dissolve.h"
+#include "Pixel.h"
+#include "WarpSimd.h"
+using namespace std;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  include <immintrin.h>
+#  define MORPHER_X86_SIMD
+#endif
+
+//================================================
+/*
+dissolveWeight(float alpha)
+
+* PURPOSE: weight of the second image of a blend in 1/32768 steps. 1 is kept just below 32768 so
+*          the weight fits a signed 16 bit value; the blend still returns y exactly at alpha 1
+*          since the difference of two channels is at most 255.
+* INPUTS: param -- float alpha -- visibility of the second image, from 0 to 1
+* OUTPUTS: int, weight from 0 to 32767
+*/
+//================================================
+int dissolveWeight(float alpha){
+	int weight = lround(alpha * 32768.0);
+	return max(0, min(weight, 32767));
+}
+
+//================================================
+/*
+dissolveRowScalar(unsigned char* x, unsigned char* y, unsigned char* out, int count, int weight,
+		  bool blendAlpha)
+
+* PURPOSE: blend count RGBA pixels one channel at a time, see dissolveRow
+* INPUTS: param -- unsigned char* x, y -- the two rows, 4 values per pixel
+*         param -- unsigned char* out -- receives the blend
+*         param -- int count -- number of pixels
+*         param -- int weight -- weight of y, from dissolveWeight
+*         param -- bool blendAlpha -- blend the alpha channel, else write 255
+* OUTPUTS: none
+*/
+//================================================
+static void dissolveRowScalar(unsigned char* x, unsigned char* y, unsigned char* out, int count, int weight,
+		bool blendAlpha){
+	for (int i = 0; i < 4 * count; i++){
+		int difference = y[i] - x[i];
+		int value = x[i] + ((difference * weight + 16384) >> 15); // arithmetic shift, rounds half up
+		out[i] = ((i & 3) == 3 && !blendAlpha) ? 255 : value;
+	}
+}
+
+#ifdef MORPHER_X86_SIMD
+//================================================
+/*
+dissolveRowAvx2(unsigned char* x, unsigned char* y, unsigned char* out, int count, int weight,
+		bool blendAlpha)
+
+* PURPOSE: same as dissolveRowScalar, 8 pixels at a time. The bytes are widened to 16 bits and
+*          the rounded multiply-high (mulhrs) gives (difference * weight + 16384) >> 15 for 16
+*          channels per instruction.
+* INPUTS: see dissolveRowScalar
+* OUTPUTS: int, number of pixels blended from the start of the row (a multiple of 8), the caller
+*          blends the rest with dissolveRowScalar
+*/
+//================================================
+__attribute__((target("avx2")))
+static int dissolveRowAvx2(unsigned char* x, unsigned char* y, unsigned char* out, int count, int weight,
+		bool blendAlpha){
+	const __m256i weights = _mm256_set1_epi16(weight);
+	const __m256i opaque = _mm256_set1_epi32(blendAlpha ? 0 : 0xFF000000);
+	int i = 0;
+	for (; i + 8 <= count; i += 8){
+		__m256i xBytes = _mm256_loadu_si256((__m256i*)(x + 4 * i));
+		__m256i yBytes = _mm256_loadu_si256((__m256i*)(y + 4 * i));
+		__m256i blended[2];
+		for (int h = 0; h < 2; h++){ // pixels 0 - 3, then 4 - 7
+			__m256i xWords = _mm256_cvtepu8_epi16((h == 0) ? _mm256_castsi256_si128(xBytes) : _mm256_extracti128_si256(xBytes, 1));
+			__m256i yWords = _mm256_cvtepu8_epi16((h == 0) ? _mm256_castsi256_si128(yBytes) : _mm256_extracti128_si256(yBytes, 1));
+			__m256i difference = _mm256_sub_epi16(yWords, xWords);
+			blended[h] = _mm256_add_epi16(xWords, _mm256_mulhrs_epi16(difference, weights));
+		}
+		// packus works within 128 bit lanes, the permute puts the 8 pixels back in order
+		__m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(blended[0], blended[1]), 0xD8);
+		_mm256_storeu_si256((__m256i*)(out + 4 * i), _mm256_or_si256(bytes, opaque));
+	}
+	return i;
+}
+#endif
+
+//================================================
+/*
+dissolveRow(Pixel* x, Pixel* y, Pixel* out, int count, int weight, bool blendAlpha)
+
+* PURPOSE: cross dissolve two rows of pixels, out = x + round((y - x) * weight / 32768) for every
+*          channel, with AVX2 when the processor supports it
+* INPUTS: param -- Pixel* x, y -- the two rows
+*         param -- Pixel* out -- receives the blend, may be x or y
+*         param -- int count -- number of pixels
+*         param -- int weight -- weight of y, from dissolveWeight
+*         param -- bool blendAlpha -- blend the alpha channel too, else out is opaque
+* OUTPUTS: none
+*/
+//================================================
+void dissolveRow(Pixel* x, Pixel* y, Pixel* out, int count, int weight, bool blendAlpha){
+	unsigned char* xBytes = (unsigned char*)x; // a Pixel is its four channel values
+	unsigned char* yBytes = (unsigned char*)y;
+	unsigned char* outBytes = (unsigned char*)out;
+	int done = 0;
+#ifdef MORPHER_X86_SIMD
+	if (simdWidthAvailable() >= 8){
+		done = dissolveRowAvx2(xBytes, yBytes, outBytes, count, weight, blendAlpha);
+	}
+#endif
+	dissolveRowScalar(xBytes + 4 * done, yBytes + 4 * done, outBytes + 4 * done, count - done, weight, blendAlpha);
+}
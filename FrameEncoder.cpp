@@ -0,0 +1,269 @@
+// FrameEncoder.cpp
+//
+// Writes frames to image files on a set of encoder threads. See FrameEncoder.h.
+//
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <sstream>
+#include <cstdio>
+#include "FrameEncoder.h"
+#include "Pixel.h"
+#include "Pixmap.h"
+using namespace std;
+
+//================================================
+/*
+FrameEncoder(int numThreads, int maxFrames, function<bool(Pixmap&, string)> writer)
+
+* PURPOSE: variable constructor, start the encoder threads
+* INPUTS: param -- int numThreads -- encoder threads, <= 0 for one per core
+*         param -- int maxFrames -- most frames queued or being written at once,
+*                  <= 0 for numThreads
+*         param -- function<bool(Pixmap&, string)> writer -- writes a frame to a file,
+*                  called on the encoder threads, returns false on error
+* OUTPUTS: none
+*/
+//================================================
+FrameEncoder::FrameEncoder(int numThreads, int maxFrames, function<bool(Pixmap&, string)> writer){
+	if (numThreads <= 0){
+		numThreads = thread::hardware_concurrency();
+	}
+	if (numThreads <= 0){ // hardware_concurrency() may not know
+		numThreads = 1;
+	}
+	if (maxFrames <= 0){
+		maxFrames = numThreads;
+	}
+	this->maxFrames = maxFrames;
+	this->writer = writer;
+	busyWorkers = 0;
+	failed = false;
+	stopping = false;
+	for (int i = 0; i < numThreads; i++){
+		workers.push_back(thread(&FrameEncoder::workerLoop, this));
+	}
+}
+
+//================================================
+/*
+~FrameEncoder()
+
+* PURPOSE: destructor, write the queued frames and stop the threads
+* INPUTS: none
+* OUTPUTS: none
+*/
+//================================================
+FrameEncoder::~FrameEncoder(void){
+	finish();
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for (int i = 0; i < workers.size(); i++){
+		workers[i].join();
+	}
+}
+
+//================================================
+/*
+workerLoop()
+
+* PURPOSE: body of an encoder thread, write queued frames until the encoder stops
+* INPUTS: none
+* OUTPUTS: none
+*/
+//================================================
+void FrameEncoder::workerLoop(void){
+	while (true){
+		Job job;
+		{
+			unique_lock<mutex> guard(lock);
+			while (jobs.empty() && !stopping){
+				jobReady.wait(guard);
+			}
+			if (jobs.empty()){ // stopping, and nothing left to write
+				return;
+			}
+			job = move(jobs.front());
+			jobs.pop_front();
+			busyWorkers = busyWorkers + 1;
+		}
+
+		bool ok = writer((job.borrowed != NULL) ? *job.borrowed : job.frame, job.filename);
+		job.frame = Pixmap(); // return the pixels to the pool before the next frame is queued
+
+		{
+			lock_guard<mutex> guard(lock);
+			if (!ok){
+				failed = true;
+			}
+			busyWorkers = busyWorkers - 1;
+		}
+		jobDone.notify_all();
+	}
+}
+
+//================================================
+/*
+queueJob(Job& job)
+
+* PURPOSE: add a job to the queue, waiting while maxFrames frames are queued or being written
+* INPUTS: param -- Job& job -- the job, moved into the queue
+* OUTPUTS: none
+*/
+//================================================
+void FrameEncoder::queueJob(Job& job){
+	{
+		unique_lock<mutex> guard(lock);
+		while (jobs.size() + busyWorkers >= maxFrames){
+			jobDone.wait(guard);
+		}
+		jobs.push_back(move(job));
+	}
+	jobReady.notify_one();
+}
+
+//================================================
+/*
+write(Pixmap&& frame, string filename)
+
+* PURPOSE: queue a frame to be written by the next free encoder thread, the encoder takes the
+*          frame over and returns its pixels to the pixel pool once written
+* INPUTS: param -- Pixmap&& frame -- the frame, left empty
+*         param -- string filename -- file to write
+* OUTPUTS: none
+*/
+//================================================
+void FrameEncoder::write(Pixmap&& frame, string filename){
+	Job job;
+	job.frame = move(frame);
+	job.borrowed = NULL;
+	job.filename = filename;
+	queueJob(job);
+}
+
+//================================================
+/*
+writeBorrowed(Pixmap& frame, string filename)
+
+* PURPOSE: queue a frame that stays with the caller to be written by the next free encoder thread
+* INPUTS: param -- Pixmap& frame -- the frame, kept alive and unchanged until finish()
+*         param -- string filename -- file to write
+* OUTPUTS: none
+*/
+//================================================
+void FrameEncoder::writeBorrowed(Pixmap& frame, string filename){
+	Job job;
+	job.borrowed = &frame;
+	job.filename = filename;
+	queueJob(job);
+}
+
+//================================================
+/*
+finish()
+
+* PURPOSE: wait until every queued frame has been written
+* INPUTS: none
+* OUTPUTS: bool, false if any frame could not be written
+*/
+//================================================
+bool FrameEncoder::finish(void){
+	unique_lock<mutex> guard(lock);
+	while (!jobs.empty() || busyWorkers > 0){
+		jobDone.wait(guard);
+	}
+	return !failed;
+}
+
+//================================================
+/*
+hasFailed()
+
+* PURPOSE: tell whether a frame written so far could not be written, without waiting
+* INPUTS: none
+* OUTPUTS: bool, true after a failed write
+*/
+//================================================
+bool FrameEncoder::hasFailed(void){
+	lock_guard<mutex> guard(lock);
+	return failed;
+}
+
+//================================================
+/*
+checkFramePattern(string outfilename, string& error)
+
+* PURPOSE: check that a name with a '%' in it is a pattern frameFilename can format: exactly one
+*          integer conversion "%d", optionally zero padded to a width ("%03d", "%4d"), and any
+*          number of "%%" for a literal '%'. Any other conversion would read arguments that are
+*          not there.
+* INPUTS: param -- string outfilename -- base name or pattern given by the user
+*         param -- string& error -- receives why the pattern is not valid
+* OUTPUTS: bool, false if it is not valid
+*/
+//================================================
+bool checkFramePattern(string outfilename, string& error){
+	int conversions = 0;
+	for (int i = 0; i < outfilename.size(); i++){
+		if (outfilename[i] != '%'){
+			continue;
+		}
+		i++;
+		if (i < outfilename.size() && outfilename[i] == '%'){
+			continue;
+		}
+		while (i < outfilename.size() && outfilename[i] >= '0' && outfilename[i] <= '9'){ // zero flag and width
+			i++;
+		}
+		if (i >= outfilename.size() || outfilename[i] != 'd'){
+			error = "Output pattern " + outfilename + " may only hold one %d (ex. %03d) and %%.";
+			return false;
+		}
+		conversions++;
+	}
+	if (conversions > 1 || (conversions == 0 && outfilename.find('%') != string::npos)){
+		error = "Output pattern " + outfilename + " must hold exactly one %d (ex. %03d).";
+		return false;
+	}
+	return true;
+}
+
+//================================================
+/*
+frameFilename(string outfilename, int index)
+
+* PURPOSE: build the filename of one frame in a written sequence. If outfilename contains a printf
+*          style conversion (ex. "morph_%03d.png") the index is formatted into it, otherwise the index
+*          and ".png" are appended to the base name (ex. "img" becomes "img0.png", "img1.png", ...)
+* INPUTS: param -- string outfilename -- base name or pattern given by the user
+*         param -- int index -- sequence number of the frame
+* OUTPUTS: string, the filename for that frame, empty if the pattern is not valid (see
+*          checkFramePattern) or the name would be 1024 characters or more
+*/
+//================================================
+string frameFilename(string outfilename, int index){
+	if (outfilename.find('%') != string::npos){
+		string error;
+		if (!checkFramePattern(outfilename, error)){
+			return "";
+		}
+		char buffer[1024];
+		int length = snprintf(buffer, sizeof(buffer), outfilename.c_str(), index);
+		if (length < 0 || length >= sizeof(buffer)){
+			return "";
+		}
+		return string(buffer);
+	}
+	ostringstream sin; // convert sequence number to a string
+	sin << outfilename << index << ".png";
+	return sin.str();
+}
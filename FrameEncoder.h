@@ -0,0 +1,80 @@
+// FrameEncoder.h
+//
+// Class FrameEncoder writes finished frames to image files on its own worker threads, so that
+// encoding (PNG compression costs about as much as rendering a frame) runs in parallel with
+// itself and with the rendering of the next frames. Frames are handed over with write() and
+// queued; the call returns at once unless the queue is full.
+//
+// Memory stays bounded: the queue holds at most maxFrames frames (those being written
+// included), and write() waits for a frame to be written when it is full. write() takes the
+// frame over, and its pixels go back to the pixel pool once it is written, where the renderer
+// picks them up for a later frame. writeBorrowed() writes a frame the caller keeps (ex. the
+// frames of pmArray); it must not change until finish() returns.
+//
+// Members of the class include:
+//  vector<thread> workers - the encoder threads
+//  deque<Job> jobs - frames waiting to be written, with their filenames
+//  int maxFrames - most frames queued or being written
+//  function<bool(Pixmap&, string)> writer - writes one frame to one file, false on error
+//
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "Pixel.h"
+#include "Pixmap.h"
+using namespace std;
+
+#ifndef FRAMEENCODER
+#define FRAMEENCODER
+
+class FrameEncoder{
+	private:
+		struct Job{
+			Pixmap frame; // frame handed over by write()
+			Pixmap* borrowed; // frame of writeBorrowed(), NULL for write()
+			string filename;
+		};
+		vector<thread> workers;
+		mutex lock;
+		condition_variable jobReady; // a job was queued, or the encoder is stopping
+		condition_variable jobDone; // a job finished, the queue has room
+		deque<Job> jobs;
+		int maxFrames;
+		int busyWorkers;
+		bool failed;
+		bool stopping;
+		function<bool(Pixmap&, string)> writer;
+
+		void workerLoop(void);
+		void queueJob(Job& job);
+	public:
+		// constructor -- numThreads <= 0 uses one thread per core, maxFrames <= 0 allows
+		// numThreads frames (one per encoder thread)
+		FrameEncoder(int numThreads, int maxFrames, function<bool(Pixmap&, string)> writer);
+		~FrameEncoder(void);
+
+		// queue frame to be written to filename, the encoder takes it over. Waits while the
+		// queue is full.
+		void write(Pixmap&& frame, string filename);
+		// queue a frame the caller keeps, unchanged until finish()
+		void writeBorrowed(Pixmap& frame, string filename);
+		// wait until every queued frame is written, false if any write failed
+		bool finish(void);
+		// true once a write has failed, so a caller can stop producing frames early
+		bool hasFailed(void);
+};
+
+// false, with the reason in error, if outfilename has a '%' but is not a pattern of exactly
+// one %d (zero padding and a width allowed) and any %%
+bool checkFramePattern(string outfilename, string& error);
+// filename of frame index of a sequence written to outfilename, a base name ("img" gives
+// img0.png, img1.png ...) or a printf style pattern ("img%03d.png"). Empty if the pattern is
+// not valid or the name too long.
+string frameFilename(string outfilename, int index);
+
+#endif
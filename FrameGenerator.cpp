@@ -0,0 +1,754 @@
+// FrameGenerator.cpp
+//
+// Renders the frames of a morph through a chain of images on demand. See FrameGenerator.h.
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <math.h>
+#include "FrameGenerator.h"
+#include "Pixmap.h"
+#include "Pixel.h"
+#include "Segment.h"
+#include "SegmentTable.h"
+#include "ThreadPool.h"
+#include "Warp.h"
+#include "Trace.h"
+using namespace std;
+
+//================================================
+/*
+FrameGenerator(vector<Pixmap*>& images, vector<float>& times, ThreadPool* pool)
+
+* PURPOSE: variable constructor, pair the segments of each adjacent pair of images by id
+* INPUTS: param -- vector<Pixmap*>& images -- the images of the chain, at least 2, with their
+*                  segments; the generator keeps the pointers, the images must outlive it
+*         param -- vector<float>& times -- time of each frame of a pair, from 0 to 1
+*         param -- ThreadPool* pool -- threads the frames are rendered on, NULL to render them
+*                  on the calling thread
+* OUTPUTS: none
+*/
+//================================================
+FrameGenerator::FrameGenerator(vector<Pixmap*>& images, vector<float>& times, ThreadPool* pool){
+	this->images = images;
+	this->times = times;
+	this->pool = pool;
+	for (int i = 0; i < images.size(); i++){
+		segments.push_back(images[i]->getSegmentList());
+	}
+	pairImages();
+}
+
+//================================================
+/*
+FrameGenerator(vector<Pixmap*>& images, vector< vector<Segment> >& segments, vector<float>& times,
+	       ThreadPool* pool)
+
+* PURPOSE: variable constructor with the segments of the images given apart from the images, so
+*          that images shared by several morphs (see JobScheduler) carry no segments of their own
+* INPUTS: param -- vector< vector<Segment> >& segments -- segments of each image, in order
+*         see the constructor above for the others
+* OUTPUTS: none
+*/
+//================================================
+FrameGenerator::FrameGenerator(vector<Pixmap*>& images, vector< vector<Segment> >& segments, vector<float>& times,
+		ThreadPool* pool){
+	this->images = images;
+	this->segments = segments;
+	this->times = times;
+	this->pool = pool;
+	pairImages();
+}
+
+//================================================
+/*
+forEachTask(int numTasks, function<void(int)> task)
+
+* PURPOSE: run task(0) ... task(numTasks - 1) across the pool, or one after another on the
+*          calling thread if the generator has no pool. A job that runs as one task of the pool
+*          beside others (see JobScheduler) renders that way: waiting in parallelFor would run
+*          other jobs nested on its stack and spread its own tiles across the pool.
+* INPUTS: param -- int numTasks -- number of tasks
+*         param -- function<void(int)> task -- the task, given its number
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::forEachTask(int numTasks, function<void(int)> task){
+	if (pool == NULL){
+		for (int i = 0; i < numTasks; i++){
+			task(i);
+		}
+		return;
+	}
+	pool->parallelFor(numTasks, task);
+}
+
+//================================================
+/*
+pairImages()
+
+* PURPOSE: pair the segments of each adjacent pair of images by id, make the tiled copies of the
+*          images if the warps read them, and count the frames of a pair; the whole frames are
+*          rendered (constructor helper)
+* INPUTS: none, uses images, segments and times
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::pairImages(void){
+	pairTables.resize(images.size() - 1);
+	for (int p = 0; p + 1 < images.size(); p++){
+		int unmatched = buildSegmentTable(pairTables[p], segments[p + 1], segments[p], warpSettings.c);
+		if (unmatched > 0){
+			cerr << unmatched << " segment(s) of " << images[p]->getFilename()
+			     << " have no segment with the same id in " << images[p + 1]->getFilename() << endl;
+		}
+	}
+
+	if (warpSettings.tiledSources){ // tiled copies for the warps to read, see TiledPixmap.h
+		for (int i = 0; i < images.size(); i++){
+			tiledImages.push_back(TiledPixmap(*images[i]));
+		}
+	}
+	region = wholeFrame(images[0]->getWidth(), images[0]->getHeight());
+	setTimes(times);
+}
+
+//================================================
+/*
+setTimes(vector<float>& times)
+
+* PURPOSE: change the times of the frames of a pair, keeping the paired segments (and tiled
+*          images), so that a generator can be reused for another sequence of the same morph
+* INPUTS: param -- vector<float>& times -- time of each frame of a pair, from 0 to 1
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::setTimes(vector<float>& times){
+	this->times = times;
+	// a pair after the first starts on the image the previous pair ended on, leave that frame out
+	bool sharedEnds = times.size() >= 2 && times.front() == 0 && times.back() == 1;
+	framesPerPair = sharedEnds ? times.size() - 1 : times.size();
+}
+
+//================================================
+/*
+setRegion(FrameRegion region, Pixmap* mask, string& error)
+
+* PURPOSE: render only part of the frames from now on, a rectangle of the images narrowed by a
+*          mask (see FrameRegion.h); the tiles of the frames are then those of the rectangle
+* INPUTS: param -- FrameRegion region -- the rectangle, whether to crop and the fill color
+*         param -- Pixmap* mask -- NULL, or the mask, the size of the images
+*         param -- string& error -- receives why the region is not valid
+* OUTPUTS: bool, false if the mask is another size or nothing is covered
+*/
+//================================================
+bool FrameGenerator::setRegion(FrameRegion region, Pixmap* mask, string& error){
+	if (!fitRegion(region, images[0]->getWidth(), images[0]->getHeight(), mask, error)){
+		return false;
+	}
+	this->region = region;
+	return true;
+}
+
+//================================================
+/*
+getNumFrames(), getPair(int frame), getTime(int frame)
+
+* PURPOSE: getters, number of frames in the sequence, the pair a frame belongs to and its time
+*          within that pair
+* INPUTS: param -- int frame -- frame number, from 0 to getNumFrames() - 1
+* OUTPUTS: int / int / float
+*/
+//================================================
+int FrameGenerator::getNumFrames(void){
+	return times.size() + ((pairTables.size() - 1) * framesPerPair);
+}
+
+int FrameGenerator::getPair(int frame){
+	int pair, index;
+	locateFrame(frame, pair, index);
+	return pair;
+}
+
+float FrameGenerator::getTime(int frame){
+	int pair, index;
+	locateFrame(frame, pair, index);
+	return times[index];
+}
+
+//================================================
+/*
+locateFrame(int frame, int& pair, int& index)
+
+* PURPOSE: find the pair a frame of the sequence belongs to and its place in the times
+* INPUTS: param -- int frame -- frame number, from 0 to getNumFrames() - 1
+*         param -- int& pair, index -- set to the pair and the index of the time of the frame
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::locateFrame(int frame, int& pair, int& index){
+	if (frame < times.size()){ // the first pair has every time
+		pair = 0;
+		index = frame;
+		return;
+	}
+	int later = frame - times.size();
+	pair = 1 + (later / framesPerPair);
+	index = (times.size() - framesPerPair) + (later % framesPerPair);
+}
+
+//================================================
+/*
+segmentsAt(int pair, float t)
+
+* PURPOSE: interpolate the segments of the morph of a pair at time t, a weighted average of each
+*          pair of segments. At t = 0 and t = 1 these are the segments of the images themselves.
+* INPUTS: param -- int pair -- the pair, its images are pair and pair + 1
+*         param -- float t -- time, from 0 (first image) to 1 (second image)
+* OUTPUTS: vector<Segment>, one segment per pair of segments, with their id
+*/
+//================================================
+vector<Segment> FrameGenerator::segmentsAt(int pair, float t){
+	if (t == 0){
+		return segments[pair];
+	}
+	if (t == 1){
+		return segments[pair + 1];
+	}
+
+	SegmentTable& pairTable = pairTables[pair];
+	float transVal = 1.0 - t; // weight of the segments of the first image
+	vector<Segment> frameSegments;
+	for (int j = 0; j < pairTable.count; j++){
+		float startX = (pairTable.px[j] * transVal) + (pairTable.ppx[j] * (1 - transVal));
+		float startY = (pairTable.py[j] * transVal) + (pairTable.ppy[j] * (1 - transVal));
+		float endX = (pairTable.qx[j] * transVal) + (pairTable.qpx[j] * (1 - transVal));
+		float endY = (pairTable.qy[j] * transVal) + (pairTable.qpy[j] * (1 - transVal));
+		frameSegments.push_back(Segment(startX, startY, endX, endY, pairTable.id[j]));
+	}
+	return frameSegments;
+}
+
+//================================================
+/*
+buildFrameTables(int frame, SegmentTable& tableA, SegmentTable& tableB)
+
+* PURPOSE: compile the segment pairs of the two warps of a frame, the images of its pair onto
+*          the segments of the frame
+* INPUTS: param -- int frame -- frame number, from 0 to getNumFrames() - 1
+*         param -- SegmentTable& tableA, tableB -- filled for the first and second image
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::buildFrameTables(int frame, SegmentTable& tableA, SegmentTable& tableB){
+	int pair, index;
+	locateFrame(frame, pair, index);
+	vector<Segment> destSegments = segmentsAt(pair, times[index]);
+	buildSegmentTable(tableA, segments[pair], destSegments, warpSettings.c);
+	buildSegmentTable(tableB, segments[pair + 1], destSegments, warpSettings.c);
+}
+
+//================================================
+/*
+renderFrame(int frame, Pixmap& out)
+
+* PURPOSE: render one frame of the sequence: warp the images of its pair to the segments of the
+*          frame and cross dissolve them, tile by tile on the thread pool (see morphRegion).
+*          out is reused when it already has the size of the images, so a caller that renders
+*          every frame into the same Pixmap allocates a single frame for the whole sequence.
+*          Every pixel of out is written, so out need not be cleared.
+* INPUTS: param -- int frame -- frame number, from 0 to getNumFrames() - 1
+*         param -- Pixmap& out -- receives the frame
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::renderFrame(int frame, Pixmap& out){
+	renderFrames(frame, 1, &out);
+}
+
+//================================================
+/*
+renderFrames(int first, int count, Pixmap* out)
+
+* PURPOSE: render count consecutive frames of the sequence at once. Every (frame, tile) pair is
+*          one task for the thread pool, so the frames, of one pair or of several, render in
+*          parallel and a thread never waits for the last tiles of a single frame. Each out is
+*          reused when it already has the size of the frames (see prepareFrame).
+* INPUTS: param -- int first -- number of the first frame
+*         param -- int count -- number of frames
+*         param -- Pixmap* out -- array of count Pixmaps, receives the frames in order
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::renderFrames(int first, int count, Pixmap* out){
+	vector<SegmentTable> tablesA(count); // segment pairs of each warp, compiled once before the pixel loops
+	vector<SegmentTable> tablesB(count);
+	vector<int> pairs(count);
+	vector<float> alphas(count);
+	{
+		TraceScope interpolate("interpolate");
+		for (int f = 0; f < count; f++){
+			prepareFrame(out[f]);
+			buildFrameTables(first + f, tablesA[f], tablesB[f]);
+			pairs[f] = getPair(first + f);
+			alphas[f] = getTime(first + f); // alpha value of the images coincides with time changes
+			interpolate.addSegments(tablesA[f].count + tablesB[f].count);
+		}
+	}
+
+	int tilesPerFrame = getTilesPerFrame();
+	forEachTask(count * tilesPerFrame, [&](int task){
+		int f = task / tilesPerFrame;
+		renderTile(task % tilesPerFrame, pairs[f], tablesA[f], tablesB[f], out[f], alphas[f]);
+	});
+}
+
+//================================================
+/*
+renderRegion(int pair, SegmentTable& tableA, SegmentTable& tableB, Pixmap& out, float alpha,
+	     int rowStart, int rowEnd, int colStart, int colEnd)
+
+* PURPOSE: warp both images of a pair over a region of a frame and dissolve them, reading the
+*          tiled copies of the images if there are any (see morphRegion)
+* INPUTS: param -- int pair -- the pair of the frame
+*         param -- SegmentTable& tableA, tableB -- segments of the frame paired with those of the
+*                  first and second image
+*         param -- Pixmap& out -- the frame
+*         param -- float alpha -- its time
+*         param -- int rowStart, rowEnd, colStart, colEnd -- the region, ends excluded
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::renderRegion(int pair, SegmentTable& tableA, SegmentTable& tableB, Pixmap& out, float alpha,
+		int rowStart, int rowEnd, int colStart, int colEnd){
+	if (tiledImages.empty()){
+		morphRegion(*images[pair], tableA, *images[pair + 1], tableB, out, alpha, rowStart, rowEnd, colStart, colEnd);
+	}
+	else{
+		morphRegion(tiledImages[pair], tableA, tiledImages[pair + 1], tableB, out, alpha,
+			rowStart, rowEnd, colStart, colEnd);
+	}
+}
+
+//================================================
+/*
+renderFrameProgressive(int frame, Pixmap& out, int previewStep, atomic<bool>& previewed,
+		       atomic<int>& tilesDone, atomic<bool>& cancel)
+
+* PURPOSE: render one frame in two passes, so that a viewer can show it long before it is done.
+*          The preview pass computes one pixel of every previewStep x previewStep block (its top
+*          left) and copies it over the block, 1 / previewStep^2 of the work of the frame, a row
+*          of blocks per task (see previewRegion); previewed is set once every row is done. The
+*          full pass renders the frame tile by tile over the preview, as renderFrame does,
+*          counting the finished tiles in tilesDone, so the frame sharpens a tile at a time. The
+*          counters are atomics, read without a lock by the viewer while the pool writes the
+*          frame. A set cancel stops the frame between rows of blocks or tiles; a preview
+*          stopped part way is not marked previewed, out may still hold recycled pixels.
+* INPUTS: param -- int frame -- frame number, from 0 to getNumFrames() - 1
+*         param -- Pixmap& out -- receives the frame, reallocated only if its size differs
+*         param -- int previewStep -- block size of the preview, 1 skips the preview
+*         param -- atomic<bool>& previewed -- set once the whole preview is in out
+*         param -- atomic<int>& tilesDone -- counts the tiles of the full pass, from 0
+*         param -- atomic<bool>& cancel -- stops the frame when set
+* OUTPUTS: bool, true if the frame was rendered in full, false if it was cancelled
+*/
+//================================================
+bool FrameGenerator::renderFrameProgressive(int frame, Pixmap& out, int previewStep, atomic<bool>& previewed,
+		atomic<int>& tilesDone, atomic<bool>& cancel){
+	prepareFrame(out);
+	SegmentTable tableA, tableB;
+	buildFrameTables(frame, tableA, tableB);
+	int pair = getPair(frame);
+	float alpha = getTime(frame);
+
+	if (previewStep > 1){ // a row of blocks at a time, over the rectangle of the region
+		TraceScope trace("preview frame", long((region.width + previewStep - 1) / previewStep) * ((region.height + previewStep - 1) / previewStep));
+		forEachTask((region.height + previewStep - 1) / previewStep, [&](int blockRow){
+			if (cancel){
+				return;
+			}
+			int rowStart = region.y + (blockRow * previewStep);
+			int rowEnd = min(rowStart + previewStep, region.y + region.height);
+			if (tiledImages.empty()){
+				previewRegion(*images[pair], tableA, *images[pair + 1], tableB, out, alpha, rowStart, rowEnd,
+					region.x, region.x + region.width, previewStep);
+			}
+			else{
+				previewRegion(tiledImages[pair], tableA, tiledImages[pair + 1], tableB, out, alpha, rowStart, rowEnd,
+					region.x, region.x + region.width, previewStep);
+			}
+		});
+		if (cancel){ // out holds blocks of the preview and the recycled pixels of another frame
+			return false;
+		}
+		previewed = true;
+	}
+
+	forEachTask(getTilesPerFrame(), [&](int task){
+		if (cancel){
+			return;
+		}
+		renderTile(task, pair, tableA, tableB, out, alpha);
+		tilesDone++;
+	});
+	return !cancel;
+}
+
+//================================================
+/*
+renderTiles(int frame, Pixmap& out, vector<int>& tiles, atomic<int>& tilesDone, atomic<bool>& cancel)
+
+* PURPOSE: render again only some tiles of a frame already in out, the ones a segment edit
+*          changed (see setSegments), each as the full pass of renderFrameProgressive renders
+*          it, so they match a frame rendered whole
+* INPUTS: param -- int frame -- frame number, from 0 to getNumFrames() - 1
+*         param -- Pixmap& out -- the frame, the size of the images
+*         param -- vector<int>& tiles -- numbers of the tiles to render
+*         param -- atomic<int>& tilesDone -- counts the tiles rendered
+*         param -- atomic<bool>& cancel -- stops the frame between tiles when set
+* OUTPUTS: bool, true if every tile was rendered, false if it was cancelled
+*/
+//================================================
+bool FrameGenerator::renderTiles(int frame, Pixmap& out, vector<int>& tiles, atomic<int>& tilesDone,
+		atomic<bool>& cancel){
+	SegmentTable tableA, tableB;
+	buildFrameTables(frame, tableA, tableB);
+	int pair = getPair(frame);
+	float alpha = getTime(frame);
+	forEachTask(tiles.size(), [&](int i){
+		if (cancel){
+			return;
+		}
+		renderTile(tiles[i], pair, tableA, tableB, out, alpha);
+		tilesDone++;
+	});
+	return !cancel;
+}
+
+//================================================
+/*
+setSegments(int image, vector<Segment>& imageSegments, float tolerance,
+	    vector< vector<int> >& changedTiles)
+
+* PURPOSE: replace the segments of one image of the chain (a segment moved, added or removed)
+*          and pair them again with its neighbours, then find what that changes in the frames.
+*          Only the frames of the pairs on either side of the image can change. For each of
+*          their tiles the source positions of both warps, before and after, are compared
+*          with segmentChangeBound, each weighted by the visibility of its image in the
+*          dissolve (a change in the second image does not show at t = 0), and the tile is
+*          changed if that exceeds tolerance. The weights fall with distance, so an edit
+*          usually changes the tiles around the segment and few others; a tolerance of 0 gives
+*          every tile whose pixels can differ at all.
+* INPUTS: param -- int image -- the image, from 0
+*         param -- vector<Segment>& imageSegments -- its new segments
+*         param -- float tolerance -- movement in pixels of a source position left unrendered
+*         param -- vector< vector<int> >& changedTiles -- receives, for every frame of the
+*                  sequence, the numbers of its changed tiles (see getTilesPerFrame)
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::setSegments(int image, vector<Segment>& imageSegments, float tolerance,
+		vector< vector<int> >& changedTiles){
+	TraceScope trace("segment edit");
+	changedTiles.assign(getNumFrames(), vector<int>());
+	vector<int> frames; // frames of the pairs that share the image
+	for (int f = 0; f < getNumFrames(); f++){
+		int pair = getPair(f);
+		if (pair == image - 1 || pair == image){
+			frames.push_back(f);
+		}
+	}
+	vector<SegmentTable> beforeA(frames.size());
+	vector<SegmentTable> beforeB(frames.size());
+	for (int i = 0; i < frames.size(); i++){
+		buildFrameTables(frames[i], beforeA[i], beforeB[i]);
+	}
+
+	segments[image] = imageSegments;
+	for (int p = max(image - 1, 0); p <= image && p < pairTables.size(); p++){
+		int unmatched = buildSegmentTable(pairTables[p], segments[p + 1], segments[p], warpSettings.c);
+		if (unmatched > 0){
+			cerr << unmatched << " segment(s) of " << images[p]->getFilename()
+			     << " have no segment with the same id in " << images[p + 1]->getFilename() << endl;
+		}
+	}
+
+	int tiles = getTilesPerFrame();
+	for (int i = 0; i < frames.size(); i++){
+		SegmentTable afterA, afterB;
+		buildFrameTables(frames[i], afterA, afterB);
+		float alpha = getTime(frames[i]);
+		vector<char> changed(tiles, 0);
+		forEachTask(tiles, [&](int task){
+			int rowStart, rowEnd, colStart, colEnd;
+			tileBounds(task, rowStart, rowEnd, colStart, colEnd);
+			double shift = 0;
+			if (alpha < 1){ // the first image shows
+				shift += (1 - alpha) * segmentChangeBound(beforeA[i], afterA, colStart, rowStart, colEnd - 1, rowEnd - 1,
+					warpSettings.a, warpSettings.b);
+			}
+			if (alpha > 0){ // the second image shows
+				shift += alpha * segmentChangeBound(beforeB[i], afterB, colStart, rowStart, colEnd - 1, rowEnd - 1,
+					warpSettings.a, warpSettings.b);
+			}
+			changed[task] = !(shift <= tolerance); // a bound that is not a number changes the tile
+		});
+		for (int task = 0; task < tiles; task++){
+			if (changed[task]){
+				changedTiles[frames[i]].push_back(task);
+			}
+		}
+	}
+}
+
+//================================================
+/*
+tileBounds(int tile, int& rowStart, int& rowEnd, int& colStart, int& colEnd)
+
+* PURPOSE: the pixels of a tile of a frame, in pixels of the images. The tiles cover the
+*          rectangle of the region, numbered row by row from its top left.
+* INPUTS: param -- int tile -- tile number, from 0 to getTilesPerFrame() - 1
+*         param -- int& rowStart, rowEnd, colStart, colEnd -- set to its pixels, ends excluded
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::tileBounds(int tile, int& rowStart, int& rowEnd, int& colStart, int& colEnd){
+	int tilesAcross = (region.width + TILE_SIZE - 1) / TILE_SIZE;
+	rowStart = region.y + ((tile / tilesAcross) * TILE_SIZE);
+	colStart = region.x + ((tile % tilesAcross) * TILE_SIZE);
+	rowEnd = min(rowStart + TILE_SIZE, region.y + region.height);
+	colEnd = min(colStart + TILE_SIZE, region.x + region.width);
+}
+
+//================================================
+/*
+renderTile(int tile, int pair, SegmentTable& tableA, SegmentTable& tableB, Pixmap& out, float alpha)
+
+* PURPOSE: render one tile of a frame. With a mask only the bounding box of the pixels it
+*          covers in the tile is warped and dissolved (nothing if it covers none), then the
+*          pixels it does not cover are set to the fill color and those it covers in part are
+*          blended over it by their coverage.
+* INPUTS: param -- int tile -- tile number, from 0 to getTilesPerFrame() - 1
+*         param -- int pair -- the pair of the frame
+*         param -- SegmentTable& tableA, tableB -- segments of the frame paired with those of the
+*                  first and second image
+*         param -- Pixmap& out -- the frame (see prepareFrame)
+*         param -- float alpha -- its time
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::renderTile(int tile, int pair, SegmentTable& tableA, SegmentTable& tableB, Pixmap& out,
+		float alpha){
+	int rowStart, rowEnd, colStart, colEnd;
+	tileBounds(tile, rowStart, rowEnd, colStart, colEnd);
+	if (region.coverage.empty()){
+		TraceScope trace("warp+dissolve tile", long(rowEnd - rowStart) * (colEnd - colStart), tableA.count);
+		renderRegion(pair, tableA, tableB, out, alpha, rowStart, rowEnd, colStart, colEnd);
+		return;
+	}
+
+	unsigned char* coverage = &region.coverage[0];
+	int top = rowEnd, bottom = rowStart, left = colEnd, right = colStart; // covered pixels of the tile
+	for (int row = rowStart; row < rowEnd; row++){
+		for (int col = colStart; col < colEnd; col++){
+			if (coverage[(long(row - region.y) * region.width) + (col - region.x)] > 0){
+				top = min(top, row);
+				bottom = max(bottom, row + 1);
+				left = min(left, col);
+				right = max(right, col + 1);
+			}
+		}
+	}
+	if (right > left){
+		TraceScope trace("warp+dissolve tile", long(bottom - top) * (right - left), tableA.count);
+		renderRegion(pair, tableA, tableB, out, alpha, top, bottom, left, right);
+	}
+
+	Pixel** rows = out.getPmPointer();
+	for (int row = rowStart; row < rowEnd; row++){
+		for (int col = colStart; col < colEnd; col++){
+			int weight = coverage[(long(row - region.y) * region.width) + (col - region.x)];
+			if (weight == 255){
+				continue;
+			}
+			Pixel& pixel = rows[row - out.getOriginY()][col - out.getOriginX()];
+			Pixel& fill = region.fill;
+			pixel = Pixel(((fill.getRVal() * (255 - weight)) + (pixel.getRVal() * weight) + 127) / 255,
+				((fill.getGVal() * (255 - weight)) + (pixel.getGVal() * weight) + 127) / 255,
+				((fill.getBVal() * (255 - weight)) + (pixel.getBVal() * weight) + 127) / 255,
+				((fill.getAVal() * (255 - weight)) + (pixel.getAVal() * weight) + 127) / 255);
+		}
+	}
+}
+
+//================================================
+/*
+prepareFrame(Pixmap& out)
+
+* PURPOSE: make out a frame of the region before its tiles render: the size of the rectangle
+*          with the full frame as its data window if the region crops, else the size of the
+*          images with the pixels outside the rectangle set to the fill color. out is
+*          reallocated only if its size differs.
+* INPUTS: param -- Pixmap& out -- the frame
+* OUTPUTS: none
+*/
+//================================================
+void FrameGenerator::prepareFrame(Pixmap& out){
+	int width = images[0]->getWidth();
+	int height = images[0]->getHeight();
+	int frameWidth = region.crop ? region.width : width;
+	int frameHeight = region.crop ? region.height : height;
+	if (out.getWidth() != frameWidth || out.getHeight() != frameHeight){
+		out = Pixmap(frameWidth, frameHeight);
+	}
+	if (region.crop){
+		out.setDataWindow(region.x, region.y, width, height);
+		return;
+	}
+	out.setDataWindow(0, 0, width, height);
+	if (region.width == width && region.height == height){
+		return;
+	}
+	Pixel** rows = out.getPmPointer();
+	for (int row = 0; row < height; row++){
+		bool inside = row >= region.y && row < region.y + region.height;
+		for (int col = 0; col < width; col++){
+			if (!inside || col < region.x || col >= region.x + region.width){
+				rows[row][col] = region.fill;
+			}
+		}
+	}
+}
+
+//================================================
+/*
+getTilesPerFrame()
+
+* PURPOSE: getter, number of tiles of a frame (the tasks of its full pass), those of the
+*          rectangle of the region
+* INPUTS: none
+* OUTPUTS: int
+*/
+//================================================
+int FrameGenerator::getTilesPerFrame(void){
+	return ((region.width + TILE_SIZE - 1) / TILE_SIZE) * ((region.height + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+//================================================
+/*
+evenTimes(int numFrames)
+
+* PURPOSE: times of a sequence of evenly spaced frames, both images included
+* INPUTS: param -- int numFrames -- number of frames, at least 2
+* OUTPUTS: vector<float>, numFrames times from 0 to 1
+*/
+//================================================
+vector<float> evenTimes(int numFrames){
+	vector<float> times(numFrames);
+	for (int k = 0; k < numFrames; k++){
+		times[k] = float(k) / (numFrames - 1);
+	}
+	return times;
+}
+
+//================================================
+/*
+easeTimes(vector<float>& times, string curve)
+
+* PURPOSE: map every time through an easing curve, so the morph can start and/or end slowly
+*          instead of changing at a constant rate. The curves keep 0 at 0 and 1 at 1.
+*            linear    t
+*            easein    t^2, slow start
+*            easeout   1 - (1 - t)^2, slow end
+*            easeinout 3t^2 - 2t^3, slow start and end
+* INPUTS: param -- vector<float>& times -- times to reshape, in place
+*         param -- string curve -- name of the curve
+* OUTPUTS: bool, false if the curve is unknown (times are then unchanged)
+*/
+//================================================
+bool easeTimes(vector<float>& times, string curve){
+	if (curve != "linear" && curve != "easein" && curve != "easeout" && curve != "easeinout"){
+		return false;
+	}
+	for (int k = 0; k < times.size(); k++){
+		float t = times[k];
+		if (curve == "easein"){
+			times[k] = t * t;
+		}
+		else if (curve == "easeout"){
+			times[k] = 1 - ((1 - t) * (1 - t));
+		}
+		else if (curve == "easeinout"){
+			times[k] = (t * t) * (3 - (2 * t));
+		}
+	}
+	return true;
+}
+
+//================================================
+/*
+parseTimes(string list, vector<float>& times)
+
+* PURPOSE: read an explicit list of frame times, for sequences that hold, repeat or reverse
+* INPUTS: param -- string list -- comma separated times between 0 and 1 (ex. "0,0.1,0.3,0.6,1")
+*         param -- vector<float>& times -- filled with the times read
+* OUTPUTS: bool, false if the list is empty or a value is not a number in [0, 1]
+*/
+//================================================
+bool parseTimes(string list, vector<float>& times){
+	times.clear();
+	stringstream stream(list);
+	string value;
+	while (getline(stream, value, ',')){
+		char* end;
+		float t = strtof(value.c_str(), &end);
+		if (value.empty() || *end != '\0' || !(t >= 0 && t <= 1)){
+			return false;
+		}
+		times.push_back(t);
+	}
+	return !times.empty();
+}
+
+//================================================
+/*
+sequenceTimes(int numFrames, string list, string curve, vector<float>& times, string& error)
+
+* PURPOSE: times of the frames of a pair from the settings of a batch morph (nframes, -times and
+*          -ease)
+* INPUTS: param -- int numFrames -- frames of each pair, its two images included
+*         param -- string list -- comma separated times, or empty
+*         param -- string curve -- easing curve of evenly spaced times
+*         param -- vector<float>& times -- receives the times
+*         param -- string& error -- receives the reason the settings are not valid
+* OUTPUTS: bool, false if they are not valid
+*/
+//================================================
+bool sequenceTimes(int numFrames, string list, string curve, vector<float>& times, string& error){
+	stringstream reason;
+	if (list != ""){
+		if (!parseTimes(list, times)){
+			error = "Frame times must be a comma separated list of values from 0 to 1.";
+			return false;
+		}
+		if (times.size() != numFrames){
+			reason << "Frame count " << numFrames << " does not match the " << times.size() << " frame times given.";
+			error = reason.str();
+			return false;
+		}
+		return true;
+	}
+	if (numFrames < 2){
+		error = "Frame count must be at least 2 (the two source images).";
+		return false;
+	}
+	times = evenTimes(numFrames);
+	if (!easeTimes(times, curve)){
+		error = "Unknown easing curve " + curve + ", use linear, easein, easeout or easeinout.";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,139 @@
+// FrameGenerator.h
+//
+// Class FrameGenerator renders the frames of a morph through a chain of images (A -> B -> C ...)
+// one at a time, on demand. Each adjacent pair of images is its own morph, with its own segment
+// pairs: a frame of the pair is fully described by its time t (0 is the first image of the
+// pair, 1 the second), its segments are interpolated from the segments of the two images at t,
+// both images are warped to them and cross dissolved with alpha t. Nothing is kept between
+// frames, so a sequence of any length needs the input images and the frames the caller holds,
+// not one buffer per frame.
+//
+// The frames of the pairs are stitched into one sequence, numbered from 0: the frames of the
+// first pair, then those of the second, and so on. When the times run from 0 to 1, the first
+// frame of every pair after the first is left out, since it is the last frame of the previous
+// pair (the image they share). renderFrames() renders several frames of the sequence at once,
+// the tiles of all of them shared by the thread pool, so frames of different pairs render in
+// parallel.
+//
+// The times of the frames are given as a list, which may be evenly spaced (evenTimes), shaped
+// by an easing curve (easeTimes) or written out by hand (parseTimes), and are the same for
+// every pair.
+//
+// setRegion() restricts the frames to a rectangle or mask of the images (see FrameRegion.h):
+// only its tiles are warped and dissolved, and the frames are cropped to it or filled around it.
+//
+// setSegments() replaces the segments of one image after an edit and tells which tiles of
+// which frames it changes, so frames already rendered need only those rendered again
+// (renderTiles).
+//
+// Members of the class include:
+//  vector<Pixmap*> images - the images of the chain, with their segments, owned by the caller
+//  vector<TiledPixmap> tiledImages - tiled copies of the images the warps read when
+//                                    warpSettings.tiledSources is set, else empty
+//  vector< vector<Segment> > segments - segments of each image
+//  vector<SegmentTable> pairTables - for each pair, segments of the first image (P, Q) paired by
+//                                    id with those of the second (P', Q'), interpolated to give
+//                                    the segments of a frame
+//  vector<float> times - time of each frame of a pair
+//  int framesPerPair - frames each pair adds to the sequence after the first
+//  ThreadPool* pool - threads the tiles of the frames are rendered on, NULL for the calling
+//                    thread alone
+//  FrameRegion region - part of the frames rendered, the whole frame by default
+//
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <functional>
+#include "Pixmap.h"
+#include "TiledPixmap.h"
+#include "Segment.h"
+#include "SegmentTable.h"
+#include "ThreadPool.h"
+#include "FrameRegion.h"
+using namespace std;
+
+#ifndef FRAMEGENERATOR
+#define FRAMEGENERATOR
+
+class FrameGenerator{
+	private:
+		vector<Pixmap*> images;
+		vector<TiledPixmap> tiledImages;
+		vector< vector<Segment> > segments;
+		vector<SegmentTable> pairTables;
+		vector<float> times;
+		int framesPerPair;
+		ThreadPool* pool;
+		FrameRegion region;
+
+		void pairImages(void);
+		void locateFrame(int frame, int& pair, int& index);
+		void buildFrameTables(int frame, SegmentTable& tableA, SegmentTable& tableB);
+		void renderRegion(int pair, SegmentTable& tableA, SegmentTable& tableB, Pixmap& out, float alpha,
+				int rowStart, int rowEnd, int colStart, int colEnd);
+		void tileBounds(int tile, int& rowStart, int& rowEnd, int& colStart, int& colEnd);
+		void renderTile(int tile, int pair, SegmentTable& tableA, SegmentTable& tableB, Pixmap& out, float alpha);
+		void prepareFrame(Pixmap& out);
+		void forEachTask(int numTasks, function<void(int)> task);
+	public:
+		// constructor -- the images (at least 2) must be the same size, carry their segments and
+		// outlive the generator; with a NULL pool the frames render on the calling thread
+		FrameGenerator(vector<Pixmap*>& images, vector<float>& times, ThreadPool* pool);
+		// constructor -- as above, with the segments of each image given separately
+		FrameGenerator(vector<Pixmap*>& images, vector< vector<Segment> >& segments, vector<float>& times,
+				ThreadPool* pool);
+
+		// change the times of the frames of a pair, the segments stay paired
+		void setTimes(vector<float>& times);
+		// render only region, narrowed by mask if it is not NULL (see fitRegion). Returns false,
+		// with the reason in error, if it covers nothing; the region is then unchanged.
+		bool setRegion(FrameRegion region, Pixmap* mask, string& error);
+		// replace the segments of image number image and pair them again. changedTiles receives,
+		// for every frame, the tiles whose source positions may move by more than tolerance
+		// pixels (see segmentChangeBound), the ones to render again.
+		void setSegments(int image, vector<Segment>& imageSegments, float tolerance,
+				vector< vector<int> >& changedTiles);
+
+		int getNumFrames(void);
+		// pair a frame of the sequence belongs to (its images are pair and pair + 1)
+		int getPair(int frame);
+		// time of a frame within its pair
+		float getTime(int frame);
+
+		// segments of the morph of a pair at time t
+		vector<Segment> segmentsAt(int pair, float t);
+		// render frame number frame into out, which is reallocated only if its size differs
+		void renderFrame(int frame, Pixmap& out);
+		// render frames first ... first + count - 1 into out[0] ... out[count - 1] together
+		void renderFrames(int first, int count, Pixmap* out);
+		// render a frame as a coarse preview (one pixel per previewStep x previewStep block), then
+		// in full a tile at a time, reporting through the atomics and stopping when cancel is
+		// set. Returns false if it was cancelled.
+		bool renderFrameProgressive(int frame, Pixmap& out, int previewStep, atomic<bool>& previewed,
+				atomic<int>& tilesDone, atomic<bool>& cancel);
+		// render only the given tiles of a frame into out, which holds the rest of it, counting
+		// them in tilesDone and stopping when cancel is set. Returns false if it was cancelled.
+		bool renderTiles(int frame, Pixmap& out, vector<int>& tiles, atomic<int>& tilesDone, atomic<bool>& cancel);
+		// tiles of a frame, the tasks of the full pass of renderFrameProgressive, numbered row by
+		// row from the top left
+		int getTilesPerFrame(void);
+};
+
+// numFrames times evenly spaced from 0 to 1 (0, 0.25, 0.5, 0.75, 1 for 5 frames)
+vector<float> evenTimes(int numFrames);
+
+// reshape times in place with an easing curve: "linear", "easein", "easeout" or "easeinout".
+// Returns false if the curve is unknown.
+bool easeTimes(vector<float>& times, string curve);
+
+// read a comma separated list of times between 0 and 1 (ex. "0,0.1,0.3,0.6,1") into times.
+// Returns false if the list is empty or a value is not a number in [0, 1].
+bool parseTimes(string list, vector<float>& times);
+
+// times of the frames of a pair: the list (parseTimes) if there is one, which must have
+// numFrames times, else numFrames evenly spaced times reshaped by the easing curve. Returns
+// false, with the reason in error, if the settings are not valid.
+bool sequenceTimes(int numFrames, string list, string curve, vector<float>& times, string& error);
+
+#endif
@@ -0,0 +1,166 @@
+// FrameRegion.cpp
+//
+// The part of the frames of a morph that is rendered. See FrameRegion.h.
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include "FrameRegion.h"
+#include "Pixel.h"
+#include "Pixmap.h"
+using namespace std;
+
+//================================================
+/*
+wholeFrame(int width, int height)
+
+* PURPOSE: the region of a frame rendered in full, what a frame generator renders by default
+* INPUTS: param -- int width, height -- size of the images
+* OUTPUTS: FrameRegion, the whole rectangle, no mask, not cropped, opaque black fill
+*/
+//================================================
+FrameRegion wholeFrame(int width, int height){
+	FrameRegion region;
+	region.x = 0;
+	region.y = 0;
+	region.width = width;
+	region.height = height;
+	region.crop = false;
+	region.fill = Pixel(0, 0, 0, 255);
+	return region;
+}
+
+//================================================
+/*
+parseNumbers(string text, vector<int>& numbers)
+
+* PURPOSE: read a comma separated list of integers
+* INPUTS: param -- string text -- the list
+*         param -- vector<int>& numbers -- receives the integers
+* OUTPUTS: bool, false if an item is not an integer
+*/
+//================================================
+static bool parseNumbers(string text, vector<int>& numbers){
+	stringstream items(text);
+	string item;
+	numbers.clear();
+	while (getline(items, item, ',')){
+		stringstream value(item);
+		int number;
+		string rest;
+		if (!(value >> number) || (value >> rest)){
+			return false;
+		}
+		numbers.push_back(number);
+	}
+	return true;
+}
+
+//================================================
+/*
+parseRectangle(string text, FrameRegion& region), parseColor(string text, Pixel& color)
+
+* PURPOSE: read the rectangle of a region, "x,y,width,height", and a fill color, "r,g,b" or
+*          "r,g,b,a"
+* INPUTS: param -- string text -- the option value
+*         param -- FrameRegion& region / Pixel& color -- receives what was read
+* OUTPUTS: bool, false if the text is not valid, nothing is changed then
+*/
+//================================================
+bool parseRectangle(string text, FrameRegion& region){
+	vector<int> numbers;
+	if (!parseNumbers(text, numbers) || numbers.size() != 4 || numbers[2] <= 0 || numbers[3] <= 0){
+		return false;
+	}
+	region.x = numbers[0];
+	region.y = numbers[1];
+	region.width = numbers[2];
+	region.height = numbers[3];
+	return true;
+}
+
+bool parseColor(string text, Pixel& color){
+	vector<int> numbers;
+	if (!parseNumbers(text, numbers) || numbers.size() < 3 || numbers.size() > 4){
+		return false;
+	}
+	for (int i = 0; i < numbers.size(); i++){
+		if (numbers[i] < 0 || numbers[i] > 255){
+			return false;
+		}
+	}
+	color = Pixel(numbers[0], numbers[1], numbers[2], (numbers.size() == 4) ? numbers[3] : 255);
+	return true;
+}
+
+//================================================
+/*
+fitRegion(FrameRegion& region, int width, int height, Pixmap* mask, string& error)
+
+* PURPOSE: clip the rectangle of a region to the images, then, with a mask, shrink it to the
+*          bounding box of the pixels the mask covers (red channel above 0) within it and keep
+*          the coverage of its pixels. A mask that covers its whole bounding box leaves no
+*          coverage, the rectangle is then rendered in full.
+* INPUTS: param -- FrameRegion& region -- the region, its rectangle and coverage are set
+*         param -- int width, height -- size of the images
+*         param -- Pixmap* mask -- NULL, or the mask image, the size of the images
+*         param -- string& error -- receives why the region is not valid
+* OUTPUTS: bool, false if the mask is another size or the region covers no pixel
+*/
+//================================================
+bool fitRegion(FrameRegion& region, int width, int height, Pixmap* mask, string& error){
+	int left = max(region.x, 0);
+	int top = max(region.y, 0);
+	int right = min(region.x + region.width, width); // excluded
+	int bottom = min(region.y + region.height, height);
+	region.coverage.clear();
+	if (mask != NULL){
+		if (mask->getWidth() != width || mask->getHeight() != height){
+			error = "The mask " + mask->getFilename() + " is not the size of the images.";
+			return false;
+		}
+		Pixel** maskRows = mask->getPmPointer();
+		int coveredLeft = right, coveredTop = bottom, coveredRight = left, coveredBottom = top;
+		bool partial = false;
+		for (int row = top; row < bottom; row++){
+			for (int col = left; col < right; col++){
+				unsigned char value = maskRows[row][col].getRVal();
+				if (value > 0){
+					coveredLeft = min(coveredLeft, col);
+					coveredRight = max(coveredRight, col + 1);
+					coveredTop = min(coveredTop, row);
+					coveredBottom = max(coveredBottom, row + 1);
+				}
+			}
+		}
+		left = coveredLeft;
+		top = coveredTop;
+		right = coveredRight;
+		bottom = coveredBottom;
+		for (int row = top; row < bottom && !partial; row++){
+			for (int col = left; col < right && !partial; col++){
+				partial = maskRows[row][col].getRVal() < 255;
+			}
+		}
+		if (partial && right > left && bottom > top){
+			region.coverage.resize(long(right - left) * (bottom - top));
+			for (int row = top; row < bottom; row++){
+				for (int col = left; col < right; col++){
+					region.coverage[(long(row - top) * (right - left)) + (col - left)] = maskRows[row][col].getRVal();
+				}
+			}
+		}
+	}
+	if (right <= left || bottom <= top){
+		error = "The region covers no pixel of the images.";
+		return false;
+	}
+	region.x = left;
+	region.y = top;
+	region.width = right - left;
+	region.height = bottom - top;
+	return true;
+}
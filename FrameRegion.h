@@ -0,0 +1,56 @@
+// FrameRegion.h
+//
+// Struct FrameRegion is the part of the frames of a morph that is rendered, when only that
+// part is needed (ex. the face, composited over another plate). It is a rectangle of the
+// images, optionally narrowed by a mask image whose red channel gives the coverage of each
+// pixel: 0 is not rendered, 255 is rendered, values between blend the morph over the fill
+// color (an alpha mask with soft edges). A frame generator given a region (see
+// FrameGenerator::setRegion) warps and dissolves only the tiles of the rectangle, each only
+// over its covered pixels, so a frame costs in proportion to the area covered.
+//
+// The frames are then either the full size of the images, the pixels outside the region set
+// to the fill color, or cropped to the rectangle, with the full frame as their data window (see
+// Pixmap::setDataWindow), which the png and exr files written keep as their offset.
+//
+// Members of the struct include:
+//  int x, y, width, height - the rectangle, in pixels of the images
+//  vector<unsigned char> coverage - coverage of each pixel of the rectangle, row by row, from
+//                                   the mask; empty if the rectangle is covered in full
+//  bool crop - the frames are the rectangle alone, else the full size
+//  Pixel fill - color of the pixels not covered
+//
+#include <iostream>
+#include <vector>
+#include <string>
+#include "Pixel.h"
+#include "Pixmap.h"
+using namespace std;
+
+#ifndef FRAMEREGION
+#define FRAMEREGION
+
+struct FrameRegion{
+	int x, y, width, height;
+	vector<unsigned char> coverage;
+	bool crop;
+	Pixel fill;
+};
+
+// the whole of images of width x height, opaque black fill, not cropped
+FrameRegion wholeFrame(int width, int height);
+
+// read a rectangle "x,y,width,height" into the region. Returns false if it is not four
+// integers with a positive width and height.
+bool parseRectangle(string text, FrameRegion& region);
+
+// read a color "r,g,b" or "r,g,b,a" of values from 0 to 255 (a is 255 if left out). Returns
+// false if it is not.
+bool parseColor(string text, Pixel& color);
+
+// fit the region to images of width x height and narrow it to the pixels covered by mask (if
+// not NULL), which must be that size: the rectangle shrinks to the bounding box of the covered
+// pixels within it. Returns false, with the reason in error, if the sizes differ or nothing is
+// covered.
+bool fitRegion(FrameRegion& region, int width, int height, Pixmap* mask, string& error);
+
+#endif
@@ -0,0 +1,200 @@
+// FrameTextures.cpp
+//
+// Frames of the display window kept as OpenGL textures. See FrameTextures.h.
+//
+
+#include <iostream>
+#include <map>
+#include "FrameTextures.h"
+#include "Pixmap.h"
+#include "Pixel.h"
+#include "Trace.h"
+using namespace std;
+
+//================================================
+/*
+FrameTextures(long maxBytes), ~FrameTextures()
+
+* PURPOSE: variable constructor, no textures yet; destructor, deletes the textures
+* INPUTS: param -- long maxBytes -- texture memory the frames may take
+* OUTPUTS: none
+*/
+//================================================
+FrameTextures::FrameTextures(long maxBytes){
+	this->maxBytes = maxBytes;
+	bytes = 0;
+	useCount = 0;
+	uploads = 0;
+	evictions = 0;
+}
+
+FrameTextures::~FrameTextures(void){
+	clear();
+}
+
+//================================================
+/*
+evict(long neededBytes)
+
+* PURPOSE: delete the least recently drawn textures until neededBytes more fit in maxBytes
+* INPUTS: param -- long neededBytes -- size of the texture about to be created
+* OUTPUTS: none
+*/
+//================================================
+void FrameTextures::evict(long neededBytes){
+	while (!textures.empty() && bytes + neededBytes > maxBytes){
+		map<int, Texture>::iterator oldest = textures.begin();
+		for (map<int, Texture>::iterator it = textures.begin(); it != textures.end(); it++){
+			if (it->second.lastUsed < oldest->second.lastUsed){
+				oldest = it;
+			}
+		}
+		glDeleteTextures(1, &oldest->second.name);
+		bytes -= oldest->second.bytes;
+		textures.erase(oldest);
+		evictions += 1;
+	}
+}
+
+//================================================
+/*
+upload(int index, Pixmap& frame)
+
+* PURPOSE: create the texture of a frame from its pixels, making room for it first
+* INPUTS: param -- int index -- frame number
+*         param -- Pixmap& frame -- its pixels
+* OUTPUTS: bool, false if the frame is larger than a texture may be, or larger than maxBytes
+*/
+//================================================
+bool FrameTextures::upload(int index, Pixmap& frame){
+	GLint largest = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &largest);
+	long frameBytes = long(frame.getWidth()) * frame.getHeight() * sizeof(Pixel);
+	if (frame.getWidth() > largest || frame.getHeight() > largest || frameBytes > maxBytes){
+		return false;
+	}
+	evict(frameBytes);
+
+	TraceScope trace("upload texture", long(frame.getWidth()) * frame.getHeight());
+	Texture texture;
+	glGenTextures(1, &texture.name);
+	glBindTexture(GL_TEXTURE_2D, texture.name);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // shown at its own size
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4); // rows of 4 byte pixels
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, frame.getWidth(), frame.getHeight(), 0, GL_RGBA, GL_UNSIGNED_BYTE,
+		frame.getDataPointer());
+	if (glGetError() != GL_NO_ERROR){ // ex. a card without textures of any size, or out of memory
+		glDeleteTextures(1, &texture.name);
+		return false;
+	}
+	texture.bytes = frameBytes;
+	texture.lastUsed = useCount;
+	textures[index] = texture;
+	bytes += frameBytes;
+	uploads += 1;
+	return true;
+}
+
+//================================================
+/*
+draw(int index, Pixmap& frame)
+
+* PURPOSE: draw a frame as a textured rectangle the size of the frame, its first row at the top
+*          (the window coordinates put y = 0 at the bottom, see handleReshape in morpher.cpp)
+* INPUTS: param -- int index -- frame number, the texture it is kept by
+*         param -- Pixmap& frame -- its pixels, uploaded if it has no texture yet
+* OUTPUTS: bool, false if the frame cannot be a texture and nothing was drawn
+*/
+//================================================
+bool FrameTextures::draw(int index, Pixmap& frame){
+	useCount += 1;
+	map<int, Texture>::iterator found = textures.find(index);
+	if (found == textures.end()){
+		while (glGetError() != GL_NO_ERROR){} // errors of earlier calls are not the upload's
+		if (!upload(index, frame)){
+			return false;
+		}
+		found = textures.find(index);
+	}
+	found->second.lastUsed = useCount;
+
+	int width = frame.getWidth();
+	int height = frame.getHeight();
+	glBindTexture(GL_TEXTURE_2D, found->second.name);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE); // ignore the current color
+	glEnable(GL_TEXTURE_2D);
+	glBegin(GL_QUADS);
+	glTexCoord2f(0, 0);
+	glVertex2i(0, height);
+	glTexCoord2f(1, 0);
+	glVertex2i(width, height);
+	glTexCoord2f(1, 1);
+	glVertex2i(width, 0);
+	glTexCoord2f(0, 1);
+	glVertex2i(0, 0);
+	glEnd();
+	glDisable(GL_TEXTURE_2D);
+	return true;
+}
+
+//================================================
+/*
+remove(int index)
+
+* PURPOSE: delete the texture of a frame whose pixels changed, it is uploaded again when next
+*          drawn
+* INPUTS: param -- int index -- frame number
+* OUTPUTS: none
+*/
+//================================================
+void FrameTextures::remove(int index){
+	map<int, Texture>::iterator found = textures.find(index);
+	if (found != textures.end()){
+		glDeleteTextures(1, &found->second.name);
+		bytes -= found->second.bytes;
+		textures.erase(found);
+	}
+}
+
+//================================================
+/*
+clear()
+
+* PURPOSE: delete every texture and reset the counts, the frames have changed
+* INPUTS: none
+* OUTPUTS: none
+*/
+//================================================
+void FrameTextures::clear(void){
+	for (map<int, Texture>::iterator it = textures.begin(); it != textures.end(); it++){
+		glDeleteTextures(1, &it->second.name);
+	}
+	textures.clear();
+	bytes = 0;
+	uploads = 0;
+	evictions = 0;
+}
+
+//================================================
+/*
+getBytes(), getUploads(), getEvictions()
+
+* PURPOSE: getters, texture memory taken, and textures created and deleted since the last clear
+* INPUTS: none
+* OUTPUTS: long
+*/
+//================================================
+long FrameTextures::getBytes(void){
+	return bytes;
+}
+
+long FrameTextures::getUploads(void){
+	return uploads;
+}
+
+long FrameTextures::getEvictions(void){
+	return evictions;
+}
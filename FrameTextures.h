@@ -0,0 +1,69 @@
+// FrameTextures.h
+//
+// Class FrameTextures keeps the frames shown in the display window as OpenGL textures, so a
+// frame is sent to the graphics card once and drawing it again (on every redisplay, and on
+// every loop of the playback, see 'p' in morpher.cpp) is a single textured rectangle instead of
+// a glDrawPixels of all of its pixels. The textures are kept by frame number; when they would
+// take more than maxBytes of texture memory the least recently drawn ones are deleted, so a
+// sequence that does not fit is uploaded again as it plays rather than not at all.
+//
+// The caller clears the textures whenever the frames change (new images, in-betweens, a morph),
+// since a frame number then names another image. A frame larger than the largest texture the
+// card supports is not kept; draw() returns false and the caller draws its pixels directly.
+//
+// Members of the class include:
+//  map<int, Texture> textures - texture of each kept frame, with its size and last use
+//  long maxBytes - texture memory the kept frames may take
+//  long bytes - texture memory they take
+//  long useCount - draws so far, orders the textures by last use
+//  long uploads, evictions - textures created and deleted to make room, since the last clear
+//
+#include <iostream>
+#include <map>
+#include "Pixmap.h"
+using namespace std;
+
+#ifdef __APPLE__
+#  include <GLUT/glut.h>
+#else
+#  include <GL/glut.h>
+#endif
+
+#ifndef FRAMETEXTURES
+#define FRAMETEXTURES
+
+class FrameTextures{
+	private:
+		struct Texture{
+			GLuint name;
+			long bytes;
+			long lastUsed;
+		};
+		map<int, Texture> textures;
+		long maxBytes;
+		long bytes;
+		long useCount;
+		long uploads;
+		long evictions;
+
+		bool upload(int index, Pixmap& frame);
+		void evict(long neededBytes);
+	public:
+		// constructor -- maxBytes is the texture memory the frames may take
+		FrameTextures(long maxBytes);
+		~FrameTextures(void);
+
+		// draw frame number index (whose pixels are frame) with its top left corner at (0, height),
+		// uploading it first if it has no texture. Returns false if it cannot be a texture.
+		bool draw(int index, Pixmap& frame);
+		// delete the texture of one frame, that frame has changed
+		void remove(int index);
+		// delete every texture, the frames have changed
+		void clear(void);
+
+		long getBytes(void);
+		long getUploads(void);
+		long getEvictions(void);
+};
+
+#endif
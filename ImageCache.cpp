@@ -0,0 +1,258 @@
+// ImageCache.cpp
+//
+// Disk cache of decoded images, mapped into memory as Pixmap pixels. See ImageCache.h.
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "ImageCache.h"
+#include "Pixmap.h"
+#include "Pixel.h"
+using namespace std;
+
+#define CACHE_HEADER_BYTES 4096 // one page, the pixels start on a page boundary
+#define CACHE_MAGIC "MORPHRGB"
+#define CACHE_VERSION 1
+
+// first page of a cache file, the rest of the page is zero
+struct CacheHeader{
+	char magic[8]; // CACHE_MAGIC, no terminator
+	int version;
+	int width;
+	int height;
+	long sourceSize; // size in bytes of the source image file
+	long sourceSeconds; // modification time of the source image file
+	long sourceNanoseconds;
+	char path[CACHE_HEADER_BYTES - 48]; // absolute path of the source image file
+};
+static_assert(sizeof(CacheHeader) == CACHE_HEADER_BYTES, "the cache header must fill one page");
+
+// a file of the cache directory, for eviction
+struct CacheEntry{
+	string path;
+	long bytes;
+	timespec used; // modification time, set when the file is stored or loaded
+};
+
+//================================================
+/*
+sourceHeader(string filename, CacheHeader& header)
+
+* PURPOSE: fill the key fields of a header (path, size, modification time) from the source file
+* INPUTS: param -- string filename -- the source image file
+*         param -- CacheHeader& header -- zeroed and filled, width and height left 0
+* OUTPUTS: bool, false if the file cannot be found or its path is too long for the header
+*/
+//================================================
+static bool sourceHeader(string filename, CacheHeader& header){
+	memset(&header, 0, sizeof(header));
+	struct stat info;
+	char path[PATH_MAX];
+	if (stat(filename.c_str(), &info) != 0 || realpath(filename.c_str(), path) == NULL ||
+	    strlen(path) >= sizeof(header.path)){
+		return false;
+	}
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = CACHE_VERSION;
+	header.sourceSize = info.st_size;
+	header.sourceSeconds = info.st_mtim.tv_sec;
+	header.sourceNanoseconds = info.st_mtim.tv_nsec;
+	strcpy(header.path, path);
+	return true;
+}
+
+//================================================
+/*
+cacheFilename(string directory, CacheHeader& header)
+
+* PURPOSE: name of the cache file of a source, a hash of its path, size and modification time
+* INPUTS: param -- string directory -- the cache directory
+*         param -- CacheHeader& header -- key fields of the source, from sourceHeader
+* OUTPUTS: string, path of the cache file
+*/
+//================================================
+static string cacheFilename(string directory, CacheHeader& header){
+	stringstream key;
+	key << header.path << "|" << header.sourceSize << "|" << header.sourceSeconds << "." << header.sourceNanoseconds;
+	stringstream name;
+	name << directory << "/" << hex << hash<string>()(key.str()) << ".rgba";
+	return name.str();
+}
+
+//================================================
+/*
+sameSource(CacheHeader& a, CacheHeader& b)
+
+* PURPOSE: compare the key fields of two headers, so that two sources whose keys hash alike are
+*          never mistaken for each other
+* INPUTS: param -- CacheHeader& a, b -- the headers
+* OUTPUTS: bool, true if the format, path, size and modification time match
+*/
+//================================================
+static bool sameSource(CacheHeader& a, CacheHeader& b){
+	return memcmp(a.magic, b.magic, sizeof(a.magic)) == 0 && a.version == b.version &&
+	       a.sourceSize == b.sourceSize && a.sourceSeconds == b.sourceSeconds &&
+	       a.sourceNanoseconds == b.sourceNanoseconds && strcmp(a.path, b.path) == 0;
+}
+
+//================================================
+/*
+loadCachedImage(string directory, string filename, Pixmap& image)
+
+* PURPOSE: find the cache file of filename, check that it belongs to the source as it is now and
+*          map it privately into memory as the pixels of image, then mark it as recently used
+* INPUTS: param -- string directory -- the cache directory
+*         param -- string filename -- the source image file
+*         param -- Pixmap& image -- receives the image, left unchanged if it is not cached
+* OUTPUTS: bool, true if the image was loaded from the cache
+*/
+//================================================
+bool loadCachedImage(string directory, string filename, Pixmap& image){
+	CacheHeader wanted;
+	if (!sourceHeader(filename, wanted)){
+		return false;
+	}
+	string cachePath = cacheFilename(directory, wanted);
+	int file = open(cachePath.c_str(), O_RDONLY);
+	if (file < 0){
+		return false;
+	}
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size < CACHE_HEADER_BYTES){
+		close(file);
+		return false;
+	}
+	void* mapping = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	close(file); // the mapping keeps the file open
+	if (mapping == MAP_FAILED){
+		return false;
+	}
+	CacheHeader* header = (CacheHeader*)mapping;
+	if (!sameSource(*header, wanted) || header->width <= 0 || header->height <= 0 ||
+	    info.st_size != CACHE_HEADER_BYTES + long(header->width) * header->height * sizeof(Pixel)){
+		munmap(mapping, info.st_size);
+		return false;
+	}
+	image = Pixmap(header->width, header->height, mapping, info.st_size, CACHE_HEADER_BYTES);
+	utimensat(AT_FDCWD, cachePath.c_str(), NULL, 0); // used now, for the eviction order
+	return true;
+}
+
+//================================================
+/*
+writeAll(int file, const void* data, long bytes)
+
+* PURPOSE: write bytes to a file, in as many calls as it takes
+* INPUTS: param -- int file -- open file descriptor
+*         param -- const void* data -- what to write
+*         param -- long bytes -- how much
+* OUTPUTS: bool, false if a write failed
+*/
+//================================================
+static bool writeAll(int file, const void* data, long bytes){
+	const char* next = (const char*)data;
+	while (bytes > 0){
+		ssize_t written = write(file, next, bytes);
+		if (written <= 0){
+			return false;
+		}
+		next += written;
+		bytes -= written;
+	}
+	return true;
+}
+
+//================================================
+/*
+evictCache(string directory, long maxBytes)
+
+* PURPOSE: remove cache files, least recently used first, until the cache holds at most maxBytes
+* INPUTS: param -- string directory -- the cache directory
+*         param -- long maxBytes -- size limit
+* OUTPUTS: none
+*/
+//================================================
+static void evictCache(string directory, long maxBytes){
+	DIR* dir = opendir(directory.c_str());
+	if (dir == NULL){
+		return;
+	}
+	vector<CacheEntry> entries;
+	long total = 0;
+	struct dirent* item;
+	while ((item = readdir(dir)) != NULL){
+		string name = item->d_name;
+		struct stat info;
+		if (name.size() < 5 || name.compare(name.size() - 5, 5, ".rgba") != 0 ||
+		    stat((directory + "/" + name).c_str(), &info) != 0){
+			continue;
+		}
+		CacheEntry entry = {directory + "/" + name, long(info.st_size), info.st_mtim};
+		entries.push_back(entry);
+		total += info.st_size;
+	}
+	closedir(dir);
+
+	sort(entries.begin(), entries.end(), [](const CacheEntry& a, const CacheEntry& b){
+		return (a.used.tv_sec != b.used.tv_sec) ? a.used.tv_sec < b.used.tv_sec : a.used.tv_nsec < b.used.tv_nsec;
+	});
+	for (int i = 0; i < entries.size() && total > maxBytes; i++){
+		if (unlink(entries[i].path.c_str()) == 0){ // a mapped file stays readable until unmapped
+			total -= entries[i].bytes;
+		}
+	}
+}
+
+//================================================
+/*
+storeCachedImage(string directory, long maxBytes, string filename, Pixmap& image)
+
+* PURPOSE: write the header and pixels of image to a temporary file and rename it to its cache
+*          file, so another process never maps a half written file, then evict down to maxBytes.
+*          An image larger than the whole cache is not stored.
+* INPUTS: param -- string directory -- the cache directory, created if it does not exist
+*         param -- long maxBytes -- size limit of the cache
+*         param -- string filename -- the source image file image was decoded from
+*         param -- Pixmap& image -- the decoded image
+* OUTPUTS: bool, true if the image was stored
+*/
+//================================================
+bool storeCachedImage(string directory, long maxBytes, string filename, Pixmap& image){
+	long pixelBytes = long(image.getWidth()) * image.getHeight() * sizeof(Pixel);
+	CacheHeader header;
+	if (CACHE_HEADER_BYTES + pixelBytes > maxBytes || !sourceHeader(filename, header)){
+		return false;
+	}
+	header.width = image.getWidth();
+	header.height = image.getHeight();
+	mkdir(directory.c_str(), 0755); // fails harmlessly if it exists
+
+	string cachePath = cacheFilename(directory, header);
+	stringstream temporary;
+	temporary << cachePath << ".tmp" << getpid();
+	int file = open(temporary.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (file < 0){
+		return false;
+	}
+	bool written = writeAll(file, &header, sizeof(header)) && writeAll(file, image.getDataPointer(), pixelBytes);
+	written = (close(file) == 0) && written;
+	if (!written || rename(temporary.str().c_str(), cachePath.c_str()) != 0){
+		unlink(temporary.str().c_str());
+		return false;
+	}
+	evictCache(directory, maxBytes);
+	return true;
+}
@@ -0,0 +1,33 @@
+// ImageCache.h
+//
+// Disk cache of decoded images, so that a morph re-run on the same source images (while its
+// segments are tuned, say) does not decode them again. Each cached image is one raw file in the
+// cache directory: a header page (the source path, its size and modification time, the image
+// size) followed by the RGBA pixels, starting on a page boundary. A cached image is loaded by
+// mapping its file into memory (mmap) as the pixels of the Pixmap: nothing is decoded or
+// copied, pages are read from disk (or the page cache) as the morph touches them. The mapping is
+// private, so changes to the pixels never reach the file.
+//
+// A file is found by a key of the absolute path, size and modification time of the source, so
+// an edited image is decoded again; its stale entry ages out. Loading a file marks it as used
+// (its modification time), and storing a new one removes the least recently used files until
+// the cache fits its size limit.
+//
+#include <iostream>
+#include <string>
+#include "Pixmap.h"
+using namespace std;
+
+#ifndef IMAGECACHE
+#define IMAGECACHE
+
+// map the decoded pixels of image file filename from the cache in directory into image
+// (replacing it). Returns false if the image is not cached (or its source has changed).
+bool loadCachedImage(string directory, string filename, Pixmap& image);
+
+// store the decoded pixels of image file filename in the cache in directory (created if
+// needed), then remove the least recently used files until the cache holds at most maxBytes.
+// Returns false if the image could not be stored.
+bool storeCachedImage(string directory, long maxBytes, string filename, Pixmap& image);
+
+#endif
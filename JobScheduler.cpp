@@ -0,0 +1,410 @@
+// JobScheduler.cpp
+//
+// Runs the batch morphs of a manifest in one process. See JobScheduler.h.
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include "JobScheduler.h"
+#include "Pixmap.h"
+#include "Segment.h"
+#include "ThreadPool.h"
+#include "FrameGenerator.h"
+#include "FrameEncoder.h"
+#include "VideoWriter.h"
+#include "Trace.h"
+using namespace std;
+
+//================================================
+/*
+parseMorphJob(string text, MorphJob& job)
+
+* PURPOSE: read one job from its words, its options first, as written in a manifest line or a
+*          request to the morph server. The output of png frames must be a base name or a
+*          pattern of one %d (see checkFramePattern), as the server runs it as a format.
+* INPUTS: param -- string text -- the words
+*         param -- MorphJob& job -- filled, error set if the words are not a valid job
+* OUTPUTS: none
+*/
+//================================================
+void parseMorphJob(string text, MorphJob& job){
+	stringstream words(text);
+	vector<string> args;
+	string word;
+	while (words >> word){
+		args.push_back(word);
+	}
+	string timeList = "";
+	string easing = "linear";
+	job.numFrames = 0;
+	job.format = "";
+	job.framesPerSecond = 30;
+	int i = 0;
+	for (; i + 1 < args.size() && args[i][0] == '-'; i += 2){
+		if (args[i] == "-times"){
+			timeList = args[i + 1];
+		}
+		else if (args[i] == "-ease"){
+			easing = args[i + 1];
+		}
+		else if (args[i] == "-format"){
+			job.format = args[i + 1];
+		}
+		else if (args[i] == "-fps"){
+			job.framesPerSecond = atoi(args[i + 1].c_str());
+		}
+		else{
+			job.error = "Unknown option " + args[i] + ", a job takes -times, -ease, -format and -fps.";
+			return;
+		}
+	}
+	if (args.size() - i < 5){
+		job.error = "A job needs at least two images, a segment file, a frame count and an output.";
+		return;
+	}
+	job.images.assign(args.begin() + i, args.end() - 3);
+	job.segmentFile = args[args.size() - 3];
+	job.numFrames = atoi(args[args.size() - 2].c_str());
+	job.output = args[args.size() - 1];
+	if (!sequenceTimes(job.numFrames, timeList, easing, job.times, job.error)){
+		return;
+	}
+	if (job.format == ""){
+		job.format = formatForOutput(job.output);
+	}
+	if (job.format != "png" && videoFormatByName(job.format) < 0){
+		job.error = "Unknown output format " + job.format + ", use png, y4m, y4m444 or rgba.";
+		return;
+	}
+	if (job.format == "png" && !checkFramePattern(job.output, job.error)){ // the pattern is a printf format
+		return;
+	}
+	if (job.framesPerSecond <= 0){
+		job.error = "Frame rate must be at least 1.";
+	}
+}
+
+//================================================
+/*
+writeJobFrames(MorphJob& job, FrameGenerator& generator, ThreadPool* pool, bool framesInParallel,
+	       FILE* stream, function<bool(Pixmap&, string)> writer, int& frames, string& error)
+
+* PURPOSE: render every frame of a job and write it where the job says, as a batch morph does
+*          (see runBatch in morpher.cpp). With framesInParallel the frames render a window of
+*          one per thread at a time and png files are encoded on encoder threads; otherwise the
+*          frames render and are written one at a time on the calling thread.
+* INPUTS: param -- MorphJob& job -- the job, its output and format
+*         param -- FrameGenerator& generator -- renders the frames of the job
+*         param -- ThreadPool* pool -- the pool of the generator
+*         param -- bool framesInParallel -- split the frames across the pool
+*         param -- FILE* stream -- if not NULL, the video is written to it instead of the output
+*                  of the job (a video format is required)
+*         param -- function<bool(Pixmap&, string)> writer -- writes a png frame
+*         param -- int& frames -- counts the frames written
+*         param -- string& error -- receives the reason if a frame could not be written
+* OUTPUTS: bool, false if some frame could not be written
+*/
+//================================================
+bool writeJobFrames(MorphJob& job, FrameGenerator& generator, ThreadPool* pool, bool framesInParallel,
+		FILE* stream, function<bool(Pixmap&, string)> writer, int& frames, string& error){
+	VideoWriter video;
+	if (job.format != "png"){
+		bool opened = (stream != NULL) ? video.open(stream, videoFormatByName(job.format), job.framesPerSecond)
+		                               : video.open(job.output, videoFormatByName(job.format), job.framesPerSecond);
+		if (!opened){
+			error = "Could not open " + job.output + ".";
+			return false;
+		}
+	}
+	FrameEncoder* encoder = NULL;
+	if (job.format == "png" && framesInParallel){
+		encoder = new FrameEncoder(0, 0, writer);
+	}
+
+	int window = framesInParallel ? pool->getNumThreads() : 1;
+	vector<Pixmap> rendered(window);
+	bool written = true;
+	for (int first = 0; first < generator.getNumFrames() && written; first += window){
+		int count = min(window, generator.getNumFrames() - first);
+		generator.renderFrames(first, count, &rendered[0]);
+		for (int f = 0; f < count && written; f++){
+			string filename = frameFilename(job.output, first + f);
+			if (job.format == "png" && filename == ""){
+				written = false; // the name is too long
+			}
+			else if (encoder != NULL){
+				encoder->write(move(rendered[f]), filename);
+				written = !encoder->hasFailed();
+			}
+			else if (job.format == "png"){
+				written = writer(rendered[f], filename);
+			}
+			else{
+				TraceScope trace("encode video", long(rendered[f].getWidth()) * rendered[f].getHeight());
+				written = video.writeFrame(rendered[f]);
+			}
+			frames += written ? 1 : 0;
+		}
+	}
+	if (encoder != NULL){
+		written = encoder->finish() && written;
+		delete encoder;
+	}
+	written = video.close() && written;
+	if (!written){
+		error = "Could not write every frame of " + job.output + ".";
+	}
+	return written;
+}
+
+//================================================
+/*
+readManifest(string filename, vector<MorphJob>& jobs, string& error)
+
+* PURPOSE: read every job of a manifest, see JobScheduler.h for the format
+* INPUTS: param -- string filename -- the manifest
+*         param -- vector<MorphJob>& jobs -- receives the jobs, valid or not
+*         param -- string& error -- receives the reason the manifest could not be read
+* OUTPUTS: bool, false if the manifest could not be read
+*/
+//================================================
+bool readManifest(string filename, vector<MorphJob>& jobs, string& error){
+	ifstream manifest(filename.c_str());
+	if (manifest.fail()){
+		error = "Could not open manifest " + filename + ".";
+		return false;
+	}
+	string text;
+	for (int line = 1; getline(manifest, text); line++){
+		string::size_type first = text.find_first_not_of(" \t\r");
+		if (first == string::npos || text[first] == '#'){
+			continue;
+		}
+		MorphJob job;
+		job.line = line;
+		parseMorphJob(text, job);
+		if (job.error == "" && job.output == "-"){
+			job.error = "Jobs of a manifest cannot write to standard output.";
+		}
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+//================================================
+/*
+JobScheduler(vector<MorphJob>& jobs, ThreadPool* pool, function<bool(string, Pixmap&)> reader,
+	     function<bool(string, int&, int&)> sizer, function<bool(Pixmap&, string)> writer,
+	     long largeFramePixels)
+
+* PURPOSE: variable constructor, nothing runs until run()
+* INPUTS: param -- vector<MorphJob>& jobs -- the jobs, from readManifest
+*         param -- ThreadPool* pool -- threads the jobs run on
+*         param -- function<bool(string, Pixmap&)> reader -- decodes an image file, false on error
+*         param -- function<bool(string, int&, int&)> sizer -- reads the size of an image file
+*         param -- function<bool(Pixmap&, string)> writer -- writes a frame, false on error
+*         param -- long largeFramePixels -- frames of at least this many pixels render across
+*                  the pool, smaller jobs run side by side
+* OUTPUTS: none
+*/
+//================================================
+JobScheduler::JobScheduler(vector<MorphJob>& jobs, ThreadPool* pool, function<bool(string, Pixmap&)> reader,
+		function<bool(string, int&, int&)> sizer, function<bool(Pixmap&, string)> writer,
+		long largeFramePixels){
+	this->jobs = jobs;
+	this->pool = pool;
+	this->reader = reader;
+	this->sizer = sizer;
+	this->writer = writer;
+	this->largeFramePixels = largeFramePixels;
+}
+
+JobScheduler::~JobScheduler(void){
+	for (map<string, SharedImage*>::iterator it = images.begin(); it != images.end(); it++){
+		delete it->second;
+	}
+}
+
+//================================================
+/*
+acquireImage(string filename), releaseImage(string filename)
+
+* PURPOSE: get the decoded image of filename, decoding it if no job has yet, and give it back
+*          when a job is done with it. An image is freed when the last job that uses it gives it
+*          back. Two jobs that want the same image at once decode it once: the second waits
+*          on the lock of the image while the first decodes it.
+* INPUTS: param -- string filename -- the image file
+* OUTPUTS: acquireImage returns Pixmap*, the image, NULL if it could not be read
+*/
+//================================================
+Pixmap* JobScheduler::acquireImage(string filename){
+	SharedImage* shared;
+	{
+		lock_guard<mutex> guard(imagesLock);
+		shared = images[filename];
+	}
+	lock_guard<mutex> guard(shared->lock);
+	if (!shared->loaded && !shared->failed){
+		shared->failed = !reader(filename, shared->image);
+		shared->loaded = !shared->failed;
+	}
+	return shared->loaded ? &shared->image : NULL;
+}
+
+void JobScheduler::releaseImage(string filename){
+	SharedImage* shared;
+	{
+		lock_guard<mutex> guard(imagesLock);
+		shared = images[filename];
+	}
+	lock_guard<mutex> guard(shared->lock);
+	shared->users -= 1;
+	if (shared->users == 0){
+		shared->image = Pixmap(); // its pixels go back to the pool
+		shared->loaded = false;
+	}
+}
+
+//================================================
+/*
+renderJob(MorphJob& job, bool framesInParallel, vector<Pixmap*>& sources, JobResult& result)
+
+* PURPOSE: read the segments of a job, render its frames and write them (see writeJobFrames)
+* INPUTS: param -- MorphJob& job -- the job
+*         param -- bool framesInParallel -- split the frames across the pool, else render them
+*                  on the calling thread alone
+*         param -- vector<Pixmap*>& sources -- the decoded images of the job
+*         param -- JobResult& result -- receives the frames written, the frame size and the
+*                  error
+* OUTPUTS: bool, false if the job failed
+*/
+//================================================
+bool JobScheduler::renderJob(MorphJob& job, bool framesInParallel, vector<Pixmap*>& sources, JobResult& result){
+	int width = sources[0]->getWidth();
+	int height = sources[0]->getHeight();
+	for (int i = 1; i < sources.size(); i++){
+		if (sources[i]->getWidth() != width || sources[i]->getHeight() != height){
+			result.error = "Images " + job.images[0] + " and " + job.images[i] + " are not the same size.";
+			return false;
+		}
+	}
+	vector< vector<Segment> > segments;
+	if (!readSegmentFile(job.segmentFile, job.images, height, segments, result.error)){
+		return false;
+	}
+	for (int i = 1; i < segments.size(); i++){
+		if (segments[i].size() != segments[0].size()){
+			result.error = "Cannot interpolate segments, images do not have the same number of segments.";
+			return false;
+		}
+	}
+	result.framePixels = long(width) * height;
+
+	// a small job is one task of the pool among others, it renders its tiles on its own thread
+	FrameGenerator generator(sources, segments, job.times, framesInParallel ? pool : NULL);
+	return writeJobFrames(job, generator, pool, framesInParallel, NULL, writer, result.frames, result.error);
+}
+
+//================================================
+/*
+runJob(MorphJob& job, bool framesInParallel, JobResult& result)
+
+* PURPOSE: run one job: get its images, render and write it, give its images back and time it
+* INPUTS: param -- MorphJob& job -- the job
+*         param -- bool framesInParallel -- split its frames across the pool (see renderJob)
+*         param -- JobResult& result -- receives what became of the job
+* OUTPUTS: none
+*/
+//================================================
+void JobScheduler::runJob(MorphJob& job, bool framesInParallel, JobResult& result){
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	result.framesInParallel = framesInParallel;
+	vector<Pixmap*> sources;
+	for (int i = 0; i < job.images.size() && result.error == ""; i++){
+		Pixmap* image = acquireImage(job.images[i]);
+		if (image == NULL){
+			result.error = "Could not read image " + job.images[i] + ".";
+		}
+		sources.push_back(image);
+	}
+	result.succeeded = (result.error == "") && renderJob(job, framesInParallel, sources, result);
+
+	set<string> used(job.images.begin(), job.images.end());
+	for (set<string>::iterator it = used.begin(); it != used.end(); it++){
+		releaseImage(*it);
+	}
+	result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+//================================================
+/*
+run()
+
+* PURPOSE: run every valid job. The size of each job's frames is read from the header of its
+*          first image; jobs with smaller frames than largeFramePixels run side by side, one per
+*          task of the pool, then the larger jobs run one after another with their frames split
+*          across the pool. Every image is counted once per job that uses it, so it is freed
+*          after its last job.
+* INPUTS: none
+* OUTPUTS: vector<JobResult>, what became of each job, in the order of the manifest
+*/
+//================================================
+vector<JobResult> JobScheduler::run(void){
+	vector<JobResult> results(jobs.size());
+	vector<int> smallJobs;
+	vector<int> largeJobs;
+	map<string, long> framePixels; // by first image, so the header of an image is read once
+	for (int j = 0; j < jobs.size(); j++){
+		JobResult& result = results[j];
+		result.line = jobs[j].line;
+		result.output = jobs[j].output;
+		result.succeeded = false;
+		result.error = jobs[j].error;
+		result.frames = 0;
+		result.framePixels = 0;
+		result.framesInParallel = false;
+		result.seconds = 0;
+		if (jobs[j].error != ""){
+			continue;
+		}
+
+		set<string> used(jobs[j].images.begin(), jobs[j].images.end());
+		for (set<string>::iterator it = used.begin(); it != used.end(); it++){
+			SharedImage*& shared = images[*it];
+			if (shared == NULL){
+				shared = new SharedImage();
+				shared->loaded = false;
+				shared->failed = false;
+				shared->users = 0;
+			}
+			shared->users += 1;
+		}
+
+		string first = jobs[j].images[0];
+		if (framePixels.count(first) == 0){
+			int width = 0, height = 0;
+			framePixels[first] = sizer(first, width, height) ? long(width) * height : 0; // unreadable, fails as a small job
+		}
+		if (framePixels[first] >= largeFramePixels){
+			largeJobs.push_back(j);
+		}
+		else{
+			smallJobs.push_back(j);
+		}
+	}
+
+	pool->parallelFor(smallJobs.size(), [&](int i){
+		runJob(jobs[smallJobs[i]], false, results[smallJobs[i]]);
+	});
+	for (int i = 0; i < largeJobs.size(); i++){
+		runJob(jobs[largeJobs[i]], true, results[largeJobs[i]]);
+	}
+	return results;
+}
@@ -0,0 +1,124 @@
+// JobScheduler.h
+//
+// Runs a manifest of batch morphs in one process. A manifest lists one job per line, written
+// like the arguments of a batch morph (morpher -b ...) with the job's own options first:
+//
+//     [-times list | -ease curve] [-format f] [-fps n] imgA imgB [imgC ...] segmentfile nframes outpattern
+//
+// Blank lines and lines starting with '#' are skipped. Names are separated by spaces, so they
+// cannot contain any. Every job writes its frames to files; standard output ("-") is not
+// allowed since the jobs run side by side.
+//
+// Class JobScheduler runs the jobs of a manifest on one thread pool. The parallelism of a job
+// follows the size of its images: a job whose frames have at least largeFramePixels pixels has
+// enough tiles to keep every thread busy, so such jobs run one after another, each with its
+// frames rendered a window at a time across the pool and encoded on encoder threads (as in
+// batch mode). Smaller jobs run side by side, one per thread, each rendering the tiles of its
+// frames on that thread alone and writing them in order. An image used by several jobs is decoded once and kept until the last job
+// that uses it has finished; the segments of a job are read from its own segment file.
+// A job that fails (an unreadable image or segment file, a frame that cannot be written) is
+// reported and the others go on.
+//
+// The scheduler reads and writes images through the functions it is given, so it does not
+// depend on the image library, and they must be safe to call from several threads at once.
+//
+// Members of class JobScheduler include:
+//  vector<MorphJob> jobs - the jobs of the manifest
+//  ThreadPool* pool - threads the jobs run on
+//  function<bool(string, Pixmap&)> reader - decodes an image file
+//  function<bool(string, int&, int&)> sizer - reads the size of an image file, without decoding
+//  function<bool(Pixmap&, string)> writer - writes one frame to one image file
+//  long largeFramePixels - frames of at least this many pixels render across the pool
+//  map<string, SharedImage*> images - decoded images by filename, with the jobs still using them
+//
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+#include <functional>
+#include "Pixmap.h"
+#include <cstdio>
+#include "ThreadPool.h"
+#include "FrameGenerator.h"
+using namespace std;
+
+#ifndef JOBSCHEDULER
+#define JOBSCHEDULER
+
+// one line of a manifest
+struct MorphJob{
+	int line; // line number in the manifest, from 1
+	vector<string> images;
+	string segmentFile;
+	int numFrames; // frames of each pair, its two images included
+	string output; // base name or pattern of the frame files, or the video file
+	vector<float> times; // time of each frame of a pair
+	string format; // png, y4m, y4m444 or rgba
+	int framesPerSecond;
+	string error; // why the line is not a valid job, empty if it is
+};
+
+// what became of a job
+struct JobResult{
+	int line;
+	string output;
+	bool succeeded;
+	string error; // why it failed
+	int frames; // frames written
+	long framePixels; // pixels of a frame, 0 if the images could not be read
+	bool framesInParallel; // true if its frames were rendered across the pool
+	double seconds; // time from its start to its last frame written
+};
+
+// read a job from its words, the options first (the format of a manifest line). The error of
+// the job is set if they are not a valid job; an output of "-" is accepted here.
+void parseMorphJob(string text, MorphJob& job);
+
+// render every frame of a job and write it to the output of the job, or to stream if it is not
+// NULL (video formats only). With framesInParallel the frames render a window of one per
+// thread of pool at a time and png files are encoded on encoder threads, otherwise one at a
+// time on the calling thread. Counts the frames written in frames, returns false with the
+// reason in error if one could not be written.
+bool writeJobFrames(MorphJob& job, FrameGenerator& generator, ThreadPool* pool, bool framesInParallel,
+		FILE* stream, function<bool(Pixmap&, string)> writer, int& frames, string& error);
+
+// read the jobs of a manifest. Lines that are not valid jobs are kept, with their error, so
+// they can be reported with the others. Returns false if the manifest cannot be read.
+bool readManifest(string filename, vector<MorphJob>& jobs, string& error);
+
+class JobScheduler{
+	private:
+		struct SharedImage{
+			mutex lock; // held while the image is decoded
+			Pixmap image;
+			bool loaded;
+			bool failed;
+			int users; // jobs that have not finished with it
+		};
+		vector<MorphJob> jobs;
+		ThreadPool* pool;
+		function<bool(string, Pixmap&)> reader;
+		function<bool(string, int&, int&)> sizer;
+		function<bool(Pixmap&, string)> writer;
+		long largeFramePixels;
+		mutex imagesLock; // guards the map, not the images
+		map<string, SharedImage*> images;
+
+		Pixmap* acquireImage(string filename);
+		void releaseImage(string filename);
+		void runJob(MorphJob& job, bool framesInParallel, JobResult& result);
+		bool renderJob(MorphJob& job, bool framesInParallel, vector<Pixmap*>& sources, JobResult& result);
+	public:
+		// constructor -- largeFramePixels is the frame size from which a job's frames render
+		// across the pool
+		JobScheduler(vector<MorphJob>& jobs, ThreadPool* pool, function<bool(string, Pixmap&)> reader,
+				function<bool(string, int&, int&)> sizer, function<bool(Pixmap&, string)> writer,
+				long largeFramePixels);
+		~JobScheduler(void);
+
+		// run every job, returns their results in the order of the manifest
+		vector<JobResult> run(void);
+};
+
+#endif
@@ -0,0 +1,367 @@
+// LazyFrames.cpp
+//
+// Frames of the display window rendered progressively in the background, with prefetch. See
+// LazyFrames.h.
+//
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <iterator>
+#include "LazyFrames.h"
+#include "Trace.h"
+using namespace std;
+
+//================================================
+/*
+LazyFrames(vector<Pixmap*>& sources, vector<float>& times, ThreadPool* pool, int previewStep)
+
+* PURPOSE: variable constructor, pair the segments of the sources (see FrameGenerator) and start
+*          the background thread; no frame is rendered until one is shown
+* INPUTS: param -- vector<Pixmap*>& sources -- the images of the chain, with their segments
+*         param -- vector<float>& times -- time of each frame of a pair
+*         param -- ThreadPool* pool -- threads the tiles of the frames render on
+*         param -- int previewStep -- block size of the previews, 1 for none
+* OUTPUTS: none
+*/
+//================================================
+LazyFrames::LazyFrames(vector<Pixmap*>& sources, vector<float>& times, ThreadPool* pool, int previewStep)
+	: generator(sources, times, pool), slots(generator.getNumFrames()){
+	for (int i = 0; i < slots.size(); i++){
+		slots[i].state = FRAME_EMPTY;
+		slots[i].previewed = false;
+		slots[i].tilesDone = 0;
+	}
+	this->previewStep = max(previewStep, 1);
+	shown = -1;
+	rendering = -1;
+	stopFrame = false;
+	paused = false;
+	closing = false;
+	numReady = 0;
+	renderedShown = 0;
+	renderedAhead = 0;
+	renderer = thread(&LazyFrames::renderLoop, this);
+}
+
+LazyFrames::~LazyFrames(void){
+	{
+		lock_guard<mutex> guard(lock);
+		closing = true;
+		stopFrame = true;
+		wanted.clear();
+	}
+	changed.notify_all();
+	renderer.join();
+}
+
+//================================================
+/*
+renderLoop()
+
+* PURPOSE: body of the background thread, render the wanted frames that are still empty, the
+*          first wanted first, until the frames are discarded: in full, or only the stale tiles
+*          of an edited frame. A frame that is stopped goes back to empty, keeping what it had
+*          rendered on show until it starts over.
+* INPUTS: none
+* OUTPUTS: none
+*/
+//================================================
+void LazyFrames::renderLoop(void){
+	unique_lock<mutex> guard(lock);
+	while (true){
+		changed.wait(guard, [this]{ return closing || (!paused && !wanted.empty()); });
+		if (closing){
+			return;
+		}
+		int index = wanted.front();
+		wanted.pop_front();
+		if (slots[index].state != FRAME_EMPTY){
+			continue;
+		}
+		Slot& slot = slots[index];
+		slot.state = FRAME_RENDERING; // the frame is this thread's until it is ready or stopped
+		vector<int> staleTiles = slot.staleTiles;
+		slot.tilesDone = staleTiles.empty() ? 0 : generator.getTilesPerFrame() - staleTiles.size();
+		rendering = index;
+		stopFrame = false;
+		bool whileShown = (index == shown);
+		guard.unlock();
+		bool finished;
+		{
+			TraceScope trace(whileShown ? "render shown frame" : "prefetch frame");
+			if (staleTiles.empty()){
+				finished = generator.renderFrameProgressive(index, slot.frame, previewStep, slot.previewed, slot.tilesDone,
+					stopFrame);
+			}
+			else{ // an edited frame, shown as it was while its stale tiles are rendered
+				finished = generator.renderTiles(index, slot.frame, staleTiles, slot.tilesDone, stopFrame);
+			}
+		}
+		guard.lock();
+		rendering = -1;
+		if (finished){
+			slot.staleTiles.clear();
+			slot.state = FRAME_READY;
+			numReady++;
+			renderedShown += whileShown ? 1 : 0;
+			renderedAhead += whileShown ? 0 : 1;
+		}
+		else{
+			slot.state = FRAME_EMPTY;
+		}
+		changed.notify_all();
+	}
+}
+
+//================================================
+/*
+show(int index, int radius)
+
+* PURPOSE: make index the shown frame: the background thread is to render it first if it is
+*          not ready, then the empty frames up to radius away from it, in the order index + 1,
+*          index - 1, index + 2, ... (stepping forward is the more likely), wrapping around the
+*          ends of the sequence as the viewer does. A frame being rendered that is no longer
+*          among these is stopped, so a jump across the sequence is not held up by it.
+* INPUTS: param -- int index -- the frame shown
+*         param -- int radius -- frames on each side
+* OUTPUTS: none
+*/
+//================================================
+void LazyFrames::show(int index, int radius){
+	int count = slots.size();
+	{
+		lock_guard<mutex> guard(lock);
+		shown = index;
+		vector<int> near;
+		near.push_back(index);
+		for (int distance = 1; distance <= radius && distance < count; distance++){
+			near.push_back((index + distance) % count);
+			near.push_back(((index - distance) % count + count) % count);
+		}
+		wanted.clear();
+		for (int i = 0; i < near.size(); i++){
+			if (slots[near[i]].state == FRAME_EMPTY && find(wanted.begin(), wanted.end(), near[i]) == wanted.end()){
+				wanted.push_back(near[i]);
+			}
+		}
+		if (rendering >= 0 && find(near.begin(), near.end(), rendering) == near.end()){
+			stopFrame = true;
+		}
+	}
+	changed.notify_all();
+}
+
+//================================================
+/*
+peekFrame(int index, int& state), getTilesDone(int index), getNumReady()
+
+* PURPOSE: what the viewer draws while a frame renders, read from the atomics without a lock.
+*          A frame being rendered is written by the pool while it is drawn; the viewer may show
+*          a tile half way, never a pixel of another frame.
+* INPUTS: param -- int index -- frame number
+*         param -- int& state -- receives FRAME_EMPTY, FRAME_RENDERING or FRAME_READY
+* OUTPUTS: Pixmap*, the frame if it is at least previewed, else NULL / int, tiles of its full
+*          pass finished / int, frames ready
+*/
+//================================================
+Pixmap* LazyFrames::peekFrame(int index, int& state){
+	state = slots[index].state;
+	if (state == FRAME_READY || slots[index].previewed){
+		return &slots[index].frame;
+	}
+	return NULL;
+}
+
+int LazyFrames::getTilesDone(int index){
+	return slots[index].tilesDone;
+}
+
+int LazyFrames::getNumReady(void){
+	return numReady;
+}
+
+//================================================
+/*
+cancel(), resume(), isPaused()
+
+* PURPOSE: stop the background rendering (the frame being rendered stops between two tiles and
+*          keeps its preview) until resume(); resume it, the frames to render are given by the
+*          next show(); whether it is stopped
+* INPUTS: none
+* OUTPUTS: none / none / bool
+*/
+//================================================
+void LazyFrames::cancel(void){
+	lock_guard<mutex> guard(lock);
+	paused = true;
+	wanted.clear();
+	if (rendering >= 0){
+		stopFrame = true;
+	}
+}
+
+void LazyFrames::resume(void){
+	{
+		lock_guard<mutex> guard(lock);
+		paused = false;
+	}
+	changed.notify_all();
+}
+
+bool LazyFrames::isPaused(void){
+	lock_guard<mutex> guard(lock);
+	return paused;
+}
+
+//================================================
+/*
+getFrame(int index)
+
+* PURPOSE: get a frame in full, rendering it (or its stale tiles) on the calling thread if it is
+*          empty, or waiting for the background thread if it is rendering it
+* INPUTS: param -- int index -- frame number, from 0 to getNumFrames() - 1
+* OUTPUTS: Pixmap*, the frame
+*/
+//================================================
+Pixmap* LazyFrames::getFrame(int index){
+	unique_lock<mutex> guard(lock);
+	changed.wait(guard, [this, index]{ return slots[index].state != FRAME_RENDERING; });
+	Slot& slot = slots[index];
+	if (slot.state == FRAME_EMPTY){
+		slot.state = FRAME_RENDERING;
+		vector<int> staleTiles = slot.staleTiles;
+		guard.unlock();
+		if (staleTiles.empty()){
+			generator.renderFrame(index, slot.frame);
+		}
+		else{
+			atomic<bool> never(false);
+			generator.renderTiles(index, slot.frame, staleTiles, slot.tilesDone, never);
+		}
+		guard.lock();
+		slot.staleTiles.clear();
+		slot.previewed = true;
+		slot.tilesDone = generator.getTilesPerFrame();
+		slot.state = FRAME_READY;
+		numReady++;
+		renderedShown += 1;
+		changed.notify_all();
+	}
+	return &slot.frame;
+}
+
+//================================================
+/*
+editSegments(int image, vector<Segment>& segments, float tolerance, vector<int>& changedFrames)
+
+* PURPOSE: change the segments of a source image without discarding the frames. The frame being
+*          rendered is stopped first, and the background thread waits on the lock meanwhile.
+*          A ready frame the edit changes goes back to empty with its stale tiles, and keeps
+*          its pixels, so it is still shown (and counted as previewed) while they render; an
+*          empty frame with stale tiles from an earlier edit adds those of this one. An empty
+*          frame without, partly rendered or not at all, renders in full anyway.
+* INPUTS: param -- int image -- the source image, from 0
+*         param -- vector<Segment>& segments -- its new segments
+*         param -- float tolerance -- movement in pixels of a source position left unrendered
+*         param -- vector<int>& changedFrames -- receives the frames that changed
+* OUTPUTS: long, number of tiles to render again
+*/
+//================================================
+long LazyFrames::editSegments(int image, vector<Segment>& segments, float tolerance, vector<int>& changedFrames){
+	unique_lock<mutex> guard(lock);
+	if (rendering >= 0){
+		stopFrame = true;
+	}
+	changed.wait(guard, [this]{ return rendering < 0; });
+
+	vector< vector<int> > changedTiles;
+	generator.setSegments(image, segments, tolerance, changedTiles);
+	int tilesPerFrame = generator.getTilesPerFrame();
+	long tiles = 0;
+	changedFrames.clear();
+	for (int i = 0; i < slots.size(); i++){
+		Slot& slot = slots[i];
+		if (changedTiles[i].empty()){
+			continue;
+		}
+		if (slot.state == FRAME_READY){
+			slot.staleTiles = changedTiles[i];
+			slot.state = FRAME_EMPTY;
+			numReady--;
+		}
+		else if (!slot.staleTiles.empty()){
+			vector<int> merged;
+			set_union(slot.staleTiles.begin(), slot.staleTiles.end(), changedTiles[i].begin(), changedTiles[i].end(),
+				back_inserter(merged));
+			slot.staleTiles = merged;
+		}
+		else{
+			continue;
+		}
+		slot.tilesDone = tilesPerFrame - slot.staleTiles.size();
+		changedFrames.push_back(i);
+		tiles += slot.staleTiles.size();
+	}
+	return tiles;
+}
+
+//================================================
+/*
+getSegments(int index)
+
+* PURPOSE: segments of a frame, interpolated from those of the source images of its pair
+* INPUTS: param -- int index -- frame number
+* OUTPUTS: vector<Segment>, the segments
+*/
+//================================================
+vector<Segment> LazyFrames::getSegments(int index){
+	lock_guard<mutex> guard(lock); // the segments change in editSegments
+	return generator.segmentsAt(generator.getPair(index), generator.getTime(index));
+}
+
+//================================================
+/*
+setRegion(FrameRegion region, Pixmap* mask, string& error)
+
+* PURPOSE: render only part of the frames, see FrameGenerator::setRegion. The frames rendered
+*          so far are not rendered again, so it is called before the first show().
+* INPUTS: param -- FrameRegion region -- the rectangle, whether to crop and the fill color
+*         param -- Pixmap* mask -- NULL, or the mask, the size of the sources
+*         param -- string& error -- receives why the region is not valid
+* OUTPUTS: bool, false if the region covers nothing
+*/
+//================================================
+bool LazyFrames::setRegion(FrameRegion region, Pixmap* mask, string& error){
+	lock_guard<mutex> guard(lock);
+	return generator.setRegion(region, mask, error);
+}
+
+//================================================
+/*
+getNumFrames(), getTilesPerFrame(), getRenderedShown(), getRenderedAhead()
+
+* PURPOSE: getters, number of frames, tiles of a frame, and frames rendered while shown and
+*          ahead of time
+* INPUTS: none
+* OUTPUTS: int / int / long / long
+*/
+//================================================
+int LazyFrames::getNumFrames(void){
+	return slots.size();
+}
+
+int LazyFrames::getTilesPerFrame(void){
+	return generator.getTilesPerFrame();
+}
+
+long LazyFrames::getRenderedShown(void){
+	lock_guard<mutex> guard(lock);
+	return renderedShown;
+}
+
+long LazyFrames::getRenderedAhead(void){
+	lock_guard<mutex> guard(lock);
+	return renderedAhead;
+}
@@ -0,0 +1,127 @@
+// LazyFrames.h
+//
+// Class LazyFrames holds the frames of a morph shown in the display window, rendered only when
+// they are asked for, on a background thread so the window never waits for them. A frame is
+// described by its number alone (its pair, time and segments come from the FrameGenerator)
+// until the viewer shows it: show() puts it first in line for the background thread, followed
+// by the frames on either side of it, nearest first, which are rendered ahead while the user
+// looks at it. Rendered frames are kept until the sequence is discarded.
+//
+// Each frame renders progressively (see FrameGenerator::renderFrameProgressive): a coarse
+// preview first, within milliseconds, then the full frame a tile at a time over it. The viewer
+// polls peekFrame() and the progress getters, which read atomic counters and take no lock, and
+// draws whatever is there. Moving to a frame that is not among the wanted ones stops the frame
+// being rendered between two tiles, as does cancel(), which also pauses the background thread
+// until resume(); a stopped frame starts over when it is next wanted.
+//
+// getFrame() is the blocking way in, for writing every frame: it renders a frame on the calling
+// thread if it is not rendered yet, or waits for the background thread if it is rendering it.
+//
+// editSegments() changes the segments of a source image of the morph in place. The frames
+// rendered so far are kept: each one the edit changes goes back to empty with the list of its
+// stale tiles (see FrameGenerator::setSegments), still shown as it was, and is brought up to
+// date by rendering only those tiles, in the background when it is wanted or by getFrame().
+//
+// Members of the class include:
+//  FrameGenerator generator - renders the frames
+//  vector<Slot> slots - each frame, whether it is empty, being rendered or ready, its preview,
+//                       its finished tiles and the tiles an edit left stale
+//  deque<int> wanted - frames the background thread is to render, the shown one first
+//  int rendering - frame the background thread renders, -1 if none
+//  atomic<bool> stopFrame - set to stop that frame
+//  bool paused - set by cancel(), nothing is rendered in the background until resume()
+//  thread renderer - the background thread
+//  int previewStep - block size of the previews
+//  atomic<int> numReady - frames ready
+//  long renderedShown, renderedAhead - frames rendered while shown, and ahead of time
+//
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "Pixmap.h"
+#include "ThreadPool.h"
+#include "FrameGenerator.h"
+using namespace std;
+
+#ifndef LAZYFRAMES
+#define LAZYFRAMES
+
+#define FRAME_EMPTY 0
+#define FRAME_RENDERING 1
+#define FRAME_READY 2
+
+class LazyFrames{
+	private:
+		struct Slot{
+			atomic<int> state; // FRAME_EMPTY, FRAME_RENDERING or FRAME_READY
+			atomic<bool> previewed; // the frame holds at least its preview
+			atomic<int> tilesDone; // tiles of the full pass finished
+			vector<int> staleTiles; // tiles to render again after an edit, empty to render it all
+			Pixmap frame;
+		};
+		FrameGenerator generator;
+		vector<Slot> slots;
+		mutex lock; // guards the changes of state, the wanted frames and the counts
+		condition_variable changed;
+		deque<int> wanted;
+		int shown;
+		int rendering;
+		atomic<bool> stopFrame;
+		bool paused;
+		bool closing;
+		thread renderer;
+		int previewStep;
+		atomic<int> numReady;
+		long renderedShown;
+		long renderedAhead;
+
+		void renderLoop(void);
+	public:
+		// constructor -- the sources (with their segments) must outlive the frames; previews
+		// have one pixel per previewStep x previewStep block
+		LazyFrames(vector<Pixmap*>& sources, vector<float>& times, ThreadPool* pool, int previewStep);
+		// stops the background thread, between two tiles of the frame it is rendering
+		~LazyFrames(void);
+
+		int getNumFrames(void);
+		int getTilesPerFrame(void);
+		// render only part of the frames (see FrameGenerator::setRegion), before any is shown
+		bool setRegion(FrameRegion region, Pixmap* mask, string& error);
+
+		// the frame shown is index: render it first if it is not ready, then the frames up to
+		// radius away (the sequence wraps around), in place of the frames wanted before
+		void show(int index, int radius);
+		// the frame as far as it has been rendered, its preview or better, NULL if it is not
+		// even previewed yet. state receives FRAME_EMPTY, FRAME_RENDERING or FRAME_READY.
+		Pixmap* peekFrame(int index, int& state);
+		// tiles of the frame rendered in full so far
+		int getTilesDone(int index);
+		// frames ready
+		int getNumReady(void);
+
+		// stop rendering in the background until resume(), the frame being rendered is dropped
+		void cancel(void);
+		void resume(void);
+		bool isPaused(void);
+
+		// the frame, rendered now on the calling thread if it is not yet. The pointer is valid as
+		// long as the frames.
+		Pixmap* getFrame(int index);
+		// replace the segments of source image number image (see FrameGenerator::setSegments),
+		// keeping the frames rendered so far: the tiles they have whose source positions may move
+		// by more than tolerance pixels are rendered again when the frames are next wanted.
+		// changedFrames receives the frames that changed. Returns the number of tiles to render.
+		long editSegments(int image, vector<Segment>& segments, float tolerance, vector<int>& changedFrames);
+		// segments of a frame, interpolated from those of its pair
+		vector<Segment> getSegments(int index);
+
+		// frames rendered while shown, and ahead of time
+		long getRenderedShown(void);
+		long getRenderedAhead(void);
+};
+
+#endif
@@ -0,0 +1,849 @@
+// MorphServer.cpp
+//
+// Long running morph server on a Unix domain socket, with its client. See MorphServer.h.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include "MorphServer.h"
+#include "Pixmap.h"
+#include "Pixel.h"
+#include "Segment.h"
+#include "FrameGenerator.h"
+#include "JobScheduler.h"
+using namespace std;
+
+#define MAX_REQUEST_BYTES 65536 // longest request line accepted
+
+//================================================
+/*
+sendAll(int socket, string text)
+
+* PURPOSE: send all of text on a socket, in as many calls as it takes. A client that went away
+*          makes the send fail rather than raise SIGPIPE.
+* INPUTS: param -- int socket -- connected socket
+*         param -- string text -- what to send
+* OUTPUTS: bool, false if the connection failed
+*/
+//================================================
+static bool sendAll(int socket, string text){
+	const char* next = text.c_str();
+	long bytes = text.size();
+	while (bytes > 0){
+		ssize_t sent = send(socket, next, bytes, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR){
+			continue;
+		}
+		if (sent <= 0){
+			return false;
+		}
+		next += sent;
+		bytes -= sent;
+	}
+	return true;
+}
+
+//================================================
+/*
+receiveLine(int socket, string& line, string& rest)
+
+* PURPOSE: receive from a socket up to the end of a line
+* INPUTS: param -- int socket -- connected socket
+*         param -- string& line -- receives the line, without its end ("\n" or "\r\n")
+*         param -- string& rest -- receives what arrived after the end of the line
+* OUTPUTS: bool, false if the connection ended (or timed out) before the end of a line, or the
+*          line is longer than MAX_REQUEST_BYTES
+*/
+//================================================
+static bool receiveLine(int socket, string& line, string& rest){
+	string received;
+	char chunk[4096];
+	while (received.find('\n') == string::npos){
+		if (received.size() > MAX_REQUEST_BYTES){
+			return false;
+		}
+		ssize_t count = recv(socket, chunk, sizeof(chunk), 0);
+		if (count < 0 && errno == EINTR){
+			continue;
+		}
+		if (count <= 0){
+			return false;
+		}
+		received.append(chunk, count);
+	}
+	string::size_type end = received.find('\n');
+	line = received.substr(0, end);
+	rest = received.substr(end + 1);
+	if (line.size() > 0 && line[line.size() - 1] == '\r'){
+		line.erase(line.size() - 1);
+	}
+	return true;
+}
+
+//================================================
+/*
+receivePart(int socket, string& received)
+
+* PURPOSE: receive, without waiting, what has arrived on a socket towards a request line
+* INPUTS: param -- int socket -- connected socket
+*         param -- string& received -- what has arrived so far, appended to
+* OUTPUTS: int, 1 once received holds the end of a line, 0 if more is to come, -1 if the
+*          connection ended first or the line is longer than MAX_REQUEST_BYTES
+*/
+//================================================
+static int receivePart(int socket, string& received){
+	char chunk[4096];
+	ssize_t count = recv(socket, chunk, sizeof(chunk), MSG_DONTWAIT);
+	if (count < 0){
+		return (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+	}
+	if (count == 0){
+		return -1;
+	}
+	received.append(chunk, count);
+	if (received.find('\n') != string::npos){
+		return 1;
+	}
+	return (received.size() > MAX_REQUEST_BYTES) ? -1 : 0;
+}
+
+//================================================
+/*
+socketAddress(string path, sockaddr_un& address)
+
+* PURPOSE: fill the address of a Unix domain socket
+* INPUTS: param -- string path -- path of the socket
+*         param -- sockaddr_un& address -- filled
+* OUTPUTS: bool, false if the path is too long for a socket address
+*/
+//================================================
+static bool socketAddress(string path, sockaddr_un& address){
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)){
+		return false;
+	}
+	strcpy(address.sun_path, path.c_str());
+	return true;
+}
+
+//================================================
+/*
+connectTo(string path)
+
+* PURPOSE: connect to the server listening on a Unix domain socket
+* INPUTS: param -- string path -- path of the socket
+* OUTPUTS: int, the connected socket, -1 if no server is listening there
+*/
+//================================================
+static int connectTo(string path){
+	sockaddr_un address;
+	if (!socketAddress(path, address)){
+		return -1;
+	}
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server >= 0 && connect(server, (sockaddr*)&address, sizeof(address)) != 0){
+		close(server);
+		server = -1;
+	}
+	return server;
+}
+
+//================================================
+/*
+writePercentiles(ostream& out, vector<double> samples)
+
+* PURPOSE: write the 50th, 90th and 99th percentiles (nearest rank) and the largest of samples as
+*          a JSON object, null values if there are none
+* INPUTS: param -- ostream& out -- where to write
+*         param -- vector<double> samples -- the samples, in any order
+* OUTPUTS: none
+*/
+//================================================
+static void writePercentiles(ostream& out, vector<double> samples){
+	if (samples.empty()){
+		out << "{\"p50\": null, \"p90\": null, \"p99\": null, \"max\": null}";
+		return;
+	}
+	sort(samples.begin(), samples.end());
+	int ranks[3] = {50, 90, 99};
+	out << "{";
+	for (int i = 0; i < 3; i++){
+		long rank = (ranks[i] * long(samples.size()) + 99) / 100; // nearest rank, from 1
+		out << "\"p" << ranks[i] << "\": " << samples[max(rank, 1L) - 1] << ", ";
+	}
+	out << "\"max\": " << samples.back() << "}";
+}
+
+//================================================
+/*
+milliseconds(chrono::steady_clock::time_point from, chrono::steady_clock::time_point to)
+
+* PURPOSE: time between two points in milliseconds
+* INPUTS: param -- from, to -- the points
+* OUTPUTS: double
+*/
+//================================================
+static double milliseconds(chrono::steady_clock::time_point from, chrono::steady_clock::time_point to){
+	return chrono::duration<double, milli>(to - from).count();
+}
+
+//================================================
+/*
+MorphServer(string socketPath, ThreadPool* pool, function<bool(string, Pixmap&)> reader,
+	    function<bool(Pixmap&, string)> writer, long cacheBytes)
+
+* PURPOSE: variable constructor, nothing listens until start()
+* INPUTS: param -- string socketPath -- path of the socket
+*         param -- ThreadPool* pool -- threads the frames are rendered on
+*         param -- function<bool(string, Pixmap&)> reader -- decodes an image file, false on error
+*         param -- function<bool(Pixmap&, string)> writer -- writes a frame, false on error
+*         param -- long cacheBytes -- size limit of the decoded images kept between requests
+* OUTPUTS: none
+*/
+//================================================
+MorphServer::MorphServer(string socketPath, ThreadPool* pool, function<bool(string, Pixmap&)> reader,
+		function<bool(Pixmap&, string)> writer, long cacheBytes){
+	this->socketPath = socketPath;
+	this->pool = pool;
+	this->reader = reader;
+	this->writer = writer;
+	this->cacheBytes = cacheBytes;
+	listener = -1;
+	stopping = false;
+	imageBytes = 0;
+	requestCount = 0;
+	stats.completed = 0;
+	stats.failed = 0;
+	stats.imageHits = 0;
+	stats.imageMisses = 0;
+	stats.morphHits = 0;
+	stats.morphMisses = 0;
+	stats.running = 0;
+	stats.samples = 0;
+	stats.cachedImages = 0;
+	stats.cachedImageBytes = 0;
+	stats.cachedMorphs = 0;
+}
+
+MorphServer::~MorphServer(void){
+	if (worker.joinable()){
+		{
+			lock_guard<mutex> guard(queueLock);
+			stopping = true;
+		}
+		queueReady.notify_all();
+		worker.join();
+	}
+	if (listener >= 0){
+		close(listener);
+		unlink(socketPath.c_str());
+	}
+}
+
+//================================================
+/*
+start(string& error)
+
+* PURPOSE: create the socket and listen on it, and start the worker. A socket file left by a
+*          server that is no longer running is replaced; one a server still answers on is not.
+* INPUTS: param -- string& error -- receives the reason the server cannot start
+* OUTPUTS: bool, false if it cannot start
+*/
+//================================================
+bool MorphServer::start(string& error){
+	sockaddr_un address;
+	if (!socketAddress(socketPath, address)){
+		error = "Socket path " + socketPath + " is too long.";
+		return false;
+	}
+	int running = connectTo(socketPath);
+	if (running >= 0){
+		close(running);
+		error = "A morph server is already listening on " + socketPath + ".";
+		return false;
+	}
+	unlink(socketPath.c_str()); // stale, no server behind it
+
+	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0){
+		error = "Could not listen on " + socketPath + ": " + strerror(errno);
+		if (listener >= 0){
+			close(listener);
+			listener = -1;
+		}
+		return false;
+	}
+	worker = thread(&MorphServer::workerLoop, this);
+	return true;
+}
+
+//================================================
+/*
+serve()
+
+* PURPOSE: accept connections and read their request until a shutdown request. The connections
+*          are polled together, so a client slow to send its request holds up no other, and one
+*          that has not sent it within SERVER_REQUEST_TIMEOUT seconds is closed. Requests are
+*          answered as they complete (see answerRequest).
+* INPUTS: none
+* OUTPUTS: none, returns once the queued morphs are done and the socket is removed
+*/
+//================================================
+void MorphServer::serve(void){
+	signal(SIGPIPE, SIG_IGN); // a client that goes away makes a write fail instead
+	vector<Request> pending; // connections whose request line has not all arrived
+	bool shuttingDown = false;
+	while (listener >= 0 && !shuttingDown){
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		vector<pollfd> polled(pending.size() + 1);
+		polled[0].fd = listener;
+		polled[0].events = POLLIN;
+		int wait = -1; // milliseconds until the first pending request times out
+		for (int i = 0; i < pending.size(); i++){
+			polled[i + 1].fd = pending[i].client;
+			polled[i + 1].events = POLLIN;
+			double elapsed = milliseconds(pending[i].arrived, now);
+			int left = max(0, int(SERVER_REQUEST_TIMEOUT * 1000 - elapsed) + 1);
+			wait = (wait < 0) ? left : min(wait, left);
+		}
+		if (poll(&polled[0], polled.size(), wait) < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			cerr << "Could not wait for connections: " << strerror(errno) << endl;
+			break;
+		}
+
+		// read what has arrived, answering the complete requests in the order they connected
+		now = chrono::steady_clock::now();
+		vector<Request> waiting;
+		for (int i = 0; i < pending.size(); i++){
+			Request& request = pending[i];
+			int state = (polled[i + 1].revents != 0) ? receivePart(request.client, request.text) : 0;
+			if (state == 0 && milliseconds(request.arrived, now) >= SERVER_REQUEST_TIMEOUT * 1000){
+				state = -1;
+			}
+			if (state == 0){
+				waiting.push_back(request);
+			}
+			else if (state > 0 && !shuttingDown){
+				shuttingDown = answerRequest(request);
+			}
+			else{
+				close(request.client);
+			}
+		}
+		pending.swap(waiting);
+
+		if (!shuttingDown && (polled[0].revents & POLLIN) != 0){
+			int client = accept(listener, NULL, NULL);
+			if (client < 0){
+				if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN){
+					continue;
+				}
+				cerr << "Could not accept a connection: " << strerror(errno) << endl;
+				break;
+			}
+			// a reply, above all a streamed video, fails rather than waits on a client not reading
+			timeval timeout = {SERVER_SEND_TIMEOUT, 0};
+			setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+			Request request;
+			request.client = client;
+			request.arrived = now;
+			pending.push_back(request);
+		}
+	}
+	for (int i = 0; i < pending.size(); i++){
+		close(pending[i].client);
+	}
+
+	{
+		lock_guard<mutex> guard(queueLock);
+		stopping = true;
+	}
+	queueReady.notify_all();
+	worker.join();
+	close(listener);
+	unlink(socketPath.c_str());
+	listener = -1;
+	morphs.clear(); // the pixels of the cached images go back to the pool
+	images.clear();
+	imageBytes = 0;
+}
+
+//================================================
+/*
+answerRequest(Request& request)
+
+* PURPOSE: answer a request whose line has arrived. Stats and shutdown are answered here, morphs
+*          are queued for the worker unless they are not valid jobs (see parseMorphJob), which are
+*          answered with the error at once.
+* INPUTS: param -- Request& request -- the request, its text holding the line and what followed
+* OUTPUTS: bool, true for a shutdown request
+*/
+//================================================
+bool MorphServer::answerRequest(Request& request){
+	int client = request.client;
+	request.text = request.text.substr(0, request.text.find('\n'));
+	if (request.text.size() > 0 && request.text[request.text.size() - 1] == '\r'){
+		request.text.erase(request.text.size() - 1);
+	}
+	string command;
+	stringstream(request.text) >> command;
+	if (command == "stats"){
+		sendAll(client, statsJson() + "\n");
+		close(client);
+	}
+	else if (command == "shutdown"){
+		sendAll(client, "ok\n");
+		close(client);
+		return true;
+	}
+	else if (command == "morph"){
+		request.text = request.text.substr(request.text.find("morph") + 5);
+		MorphJob job;
+		parseMorphJob(request.text, job);
+		if (job.error != ""){ // answered now rather than after the morphs ahead of it
+			sendAll(client, "error " + job.error + "\n");
+			close(client);
+			return false;
+		}
+		{
+			lock_guard<mutex> guard(queueLock);
+			queue.push_back(request);
+		}
+		queueReady.notify_one();
+	}
+	else{
+		sendAll(client, "error Unknown request " + command + ", use morph, stats or shutdown.\n");
+		close(client);
+	}
+	return false;
+}
+
+//================================================
+/*
+workerLoop()
+
+* PURPOSE: body of the worker thread, run the queued morphs in the order they arrived until the
+*          server stops and the queue is empty
+* INPUTS: none
+* OUTPUTS: none
+*/
+//================================================
+void MorphServer::workerLoop(void){
+	while (true){
+		Request request;
+		{
+			unique_lock<mutex> guard(queueLock);
+			queueReady.wait(guard, [this]{ return stopping || !queue.empty(); });
+			if (queue.empty()){
+				return;
+			}
+			request = queue.front();
+			queue.pop_front();
+		}
+		handleMorph(request);
+	}
+}
+
+//================================================
+/*
+handleMorph(Request& request)
+
+* PURPOSE: run one morph request, reply to it and close its connection, and record its latency
+* INPUTS: param -- Request& request -- the request, the words after "morph"
+* OUTPUTS: none
+*/
+//================================================
+void MorphServer::handleMorph(Request& request){
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	{
+		lock_guard<mutex> guard(statsLock);
+		stats.running = 1;
+	}
+	requestCount += 1;
+
+	MorphJob job;
+	job.line = 0;
+	parseMorphJob(request.text, job);
+	string error = job.error;
+	int frames = 0;
+	bool streamed = false;
+	bool succeeded = (error == "") && runMorph(job, request.client, streamed, frames, error);
+	if (!streamed){ // a streamed video has already begun, the end of the connection ends it
+		stringstream reply;
+		if (succeeded){
+			reply << "ok " << frames << " " << milliseconds(start, chrono::steady_clock::now()) << "\n";
+		}
+		else{
+			reply << "error " << error << "\n";
+		}
+		sendAll(request.client, reply.str());
+	}
+	close(request.client);
+	if (!succeeded){
+		cerr << "Request" << request.text << " failed: " << error << endl;
+	}
+
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	lock_guard<mutex> guard(statsLock);
+	stats.running = 0;
+	stats.completed += succeeded ? 1 : 0;
+	stats.failed += succeeded ? 0 : 1;
+	if (stats.latencies.size() < SERVER_LATENCY_SAMPLES){
+		stats.latencies.push_back(milliseconds(request.arrived, end));
+		stats.waits.push_back(milliseconds(request.arrived, start));
+	}
+	else{
+		stats.latencies[stats.samples % SERVER_LATENCY_SAMPLES] = milliseconds(request.arrived, end);
+		stats.waits[stats.samples % SERVER_LATENCY_SAMPLES] = milliseconds(request.arrived, start);
+	}
+	stats.samples += 1;
+	stats.cachedImages = images.size();
+	stats.cachedImageBytes = imageBytes;
+	stats.cachedMorphs = morphs.size();
+}
+
+//================================================
+/*
+runMorph(MorphJob& job, int client, bool& streamed, int& frames, string& error)
+
+* PURPOSE: render the frames of a job with its prepared morph and write them to its output, or
+*          stream them to the client when the output is "-"
+* INPUTS: param -- MorphJob& job -- the job
+*         param -- int client -- connection of the request
+*         param -- bool& streamed -- set once the stream line has been sent, after which the
+*                  client cannot be sent an error
+*         param -- int& frames -- counts the frames written
+*         param -- string& error -- receives the reason the job failed
+* OUTPUTS: bool, false if the job failed
+*/
+//================================================
+bool MorphServer::runMorph(MorphJob& job, int client, bool& streamed, int& frames, string& error){
+	if (job.output == "-" && job.format == "png"){
+		error = "Streamed frames must be y4m, y4m444 or rgba.";
+		return false;
+	}
+	CachedMorph* morph = prepareMorph(job, error);
+	if (morph == NULL){
+		return false;
+	}
+	FrameGenerator& generator = *morph->generator;
+	generator.setTimes(job.times);
+	if (job.output != "-"){
+		return writeJobFrames(job, generator, pool, true, NULL, writer, frames, error);
+	}
+
+	stringstream header;
+	header << "stream " << job.format << " " << generator.getNumFrames() << " "
+	       << morph->images[0]->getWidth() << " " << morph->images[0]->getHeight() << "\n";
+	if (!sendAll(client, header.str())){
+		error = "The client went away.";
+		return false;
+	}
+	streamed = true;
+	FILE* stream = fdopen(dup(client), "wb");
+	if (stream == NULL){
+		error = "Could not open the connection as a stream.";
+		return false;
+	}
+	setvbuf(stream, NULL, _IONBF, 0); // nothing is left buffered after a timed out send
+	bool written = writeJobFrames(job, generator, pool, true, stream, writer, frames, error);
+	fclose(stream);
+	if (!written){
+		error = "The client went away or stopped reading the stream.";
+	}
+	return written;
+}
+
+//================================================
+/*
+prepareMorph(MorphJob& job, string& error)
+
+* PURPOSE: find the prepared morph of the images and segment file of a job, or prepare it: get
+*          the images (see getImage), read the segments and build the generator, which pairs
+*          them. A morph is found by the paths, sizes and modification times of its files, so
+*          editing the segment file (or an image) prepares it again. Beyond SERVER_MAX_MORPHS the
+*          least recently used morph is dropped.
+* INPUTS: param -- MorphJob& job -- the job, its times are set on the generator by the caller
+*         param -- string& error -- receives the reason the morph cannot be prepared
+* OUTPUTS: CachedMorph*, the morph, valid until the next call, NULL on error
+*/
+//================================================
+MorphServer::CachedMorph* MorphServer::prepareMorph(MorphJob& job, string& error){
+	vector<string> paths = job.images;
+	paths.push_back(job.segmentFile);
+	stringstream key;
+	for (int i = 0; i < paths.size(); i++){
+		struct stat info;
+		if (stat(paths[i].c_str(), &info) != 0){
+			error = "Could not find " + paths[i] + ".";
+			return NULL;
+		}
+		key << paths[i] << "|" << info.st_size << "|" << info.st_mtim.tv_sec << "." << info.st_mtim.tv_nsec << "\n";
+	}
+
+	map<string, CachedMorph>::iterator found = morphs.find(key.str());
+	if (found != morphs.end()){
+		found->second.lastUsed = requestCount;
+		for (int i = 0; i < job.images.size(); i++){ // its images are in use too
+			if (images.count(job.images[i]) > 0){
+				images[job.images[i]].lastUsed = requestCount;
+			}
+		}
+		lock_guard<mutex> guard(statsLock);
+		stats.morphHits += 1;
+		return &found->second;
+	}
+	{
+		lock_guard<mutex> guard(statsLock);
+		stats.morphMisses += 1;
+	}
+
+	CachedMorph morph;
+	vector<Pixmap*> sources;
+	for (int i = 0; i < job.images.size(); i++){
+		shared_ptr<Pixmap> image = getImage(job.images[i], error);
+		if (!image){
+			return NULL;
+		}
+		morph.images.push_back(image);
+		sources.push_back(image.get());
+	}
+	evictImages(job.images);
+	int width = sources[0]->getWidth();
+	int height = sources[0]->getHeight();
+	for (int i = 1; i < sources.size(); i++){
+		if (sources[i]->getWidth() != width || sources[i]->getHeight() != height){
+			error = "Images " + job.images[0] + " and " + job.images[i] + " are not the same size.";
+			return NULL;
+		}
+	}
+	vector< vector<Segment> > segments;
+	if (!readSegmentFile(job.segmentFile, job.images, height, segments, error)){
+		return NULL;
+	}
+	for (int i = 1; i < segments.size(); i++){
+		if (segments[i].size() != segments[0].size()){
+			error = "Cannot interpolate segments, images do not have the same number of segments.";
+			return NULL;
+		}
+	}
+
+	morph.generator = make_shared<FrameGenerator>(sources, segments, job.times, pool);
+	morph.paths = job.images;
+	morph.lastUsed = requestCount;
+	if (morphs.size() >= SERVER_MAX_MORPHS){
+		map<string, CachedMorph>::iterator oldest = morphs.begin();
+		for (map<string, CachedMorph>::iterator it = morphs.begin(); it != morphs.end(); it++){
+			if (it->second.lastUsed < oldest->second.lastUsed){
+				oldest = it;
+			}
+		}
+		morphs.erase(oldest);
+	}
+	CachedMorph& stored = morphs[key.str()];
+	stored = morph;
+	return &stored;
+}
+
+//================================================
+/*
+getImage(string path, string& error)
+
+* PURPOSE: get the decoded image of a file from the cache, or decode it (with reader) and keep
+*          it. A cached image whose file has changed size or modification time since is
+*          decoded again.
+* INPUTS: param -- string path -- the image file
+*         param -- string& error -- receives the reason the image cannot be read
+* OUTPUTS: shared_ptr<Pixmap>, the image, empty on error
+*/
+//================================================
+shared_ptr<Pixmap> MorphServer::getImage(string path, string& error){
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0){
+		error = "Could not find image " + path + ".";
+		return shared_ptr<Pixmap>();
+	}
+	map<string, CachedImage>::iterator found = images.find(path);
+	if (found != images.end()){
+		CachedImage& cached = found->second;
+		if (cached.fileSize == info.st_size && cached.fileSeconds == info.st_mtim.tv_sec &&
+		    cached.fileNanoseconds == info.st_mtim.tv_nsec){
+			cached.lastUsed = requestCount;
+			lock_guard<mutex> guard(statsLock);
+			stats.imageHits += 1;
+			return cached.image;
+		}
+		dropImage(path); // the file has changed
+	}
+	{
+		lock_guard<mutex> guard(statsLock);
+		stats.imageMisses += 1;
+	}
+
+	shared_ptr<Pixmap> image = make_shared<Pixmap>();
+	if (!reader(path, *image)){
+		error = "Could not read image " + path + ".";
+		return shared_ptr<Pixmap>();
+	}
+	CachedImage cached;
+	cached.image = image;
+	cached.bytes = long(image->getWidth()) * image->getHeight() * sizeof(Pixel);
+	cached.fileSize = info.st_size;
+	cached.fileSeconds = info.st_mtim.tv_sec;
+	cached.fileNanoseconds = info.st_mtim.tv_nsec;
+	cached.lastUsed = requestCount;
+	images[path] = cached;
+	imageBytes += cached.bytes;
+	return image;
+}
+
+//================================================
+/*
+dropImage(string path), evictImages(vector<string>& keep)
+
+* PURPOSE: remove an image from the cache, with the prepared morphs that use it so that its
+*          pixels are freed; remove the least recently used images, except those in keep (the
+*          images of the current request), until the images kept fit cacheBytes
+* INPUTS: param -- string path -- the image file
+*         param -- vector<string>& keep -- paths not to remove
+* OUTPUTS: none
+*/
+//================================================
+void MorphServer::dropImage(string path){
+	map<string, CachedImage>::iterator found = images.find(path);
+	if (found == images.end()){
+		return;
+	}
+	imageBytes -= found->second.bytes;
+	images.erase(found);
+	for (map<string, CachedMorph>::iterator it = morphs.begin(); it != morphs.end();){
+		vector<string>& paths = it->second.paths;
+		if (find(paths.begin(), paths.end(), path) != paths.end()){
+			it = morphs.erase(it);
+		}
+		else{
+			it++;
+		}
+	}
+}
+
+void MorphServer::evictImages(vector<string>& keep){
+	while (imageBytes > cacheBytes){
+		map<string, CachedImage>::iterator oldest = images.end();
+		for (map<string, CachedImage>::iterator it = images.begin(); it != images.end(); it++){
+			if (find(keep.begin(), keep.end(), it->first) == keep.end() &&
+			    (oldest == images.end() || it->second.lastUsed < oldest->second.lastUsed)){
+				oldest = it;
+			}
+		}
+		if (oldest == images.end()){
+			return; // only the images of the request are left
+		}
+		dropImage(oldest->first);
+	}
+}
+
+//================================================
+/*
+statsJson()
+
+* PURPOSE: the reply to a stats request, see MorphServer.h
+* INPUTS: none
+* OUTPUTS: string, one line of JSON
+*/
+//================================================
+string MorphServer::statsJson(void){
+	long queued;
+	{
+		lock_guard<mutex> guard(queueLock);
+		queued = queue.size();
+	}
+	lock_guard<mutex> guard(statsLock);
+	stringstream json;
+	json << "{\"queued\": " << queued << ", \"running\": " << stats.running
+	     << ", \"completed\": " << stats.completed << ", \"failed\": " << stats.failed << ", \"latency_ms\": ";
+	writePercentiles(json, stats.latencies);
+	json << ", \"queue_wait_ms\": ";
+	writePercentiles(json, stats.waits);
+	json << ", \"image_cache\": {\"entries\": " << stats.cachedImages
+	     << ", \"mb\": " << stats.cachedImageBytes / 1048576.0
+	     << ", \"hits\": " << stats.imageHits << ", \"misses\": " << stats.imageMisses << "}"
+	     << ", \"morph_cache\": {\"entries\": " << stats.cachedMorphs
+	     << ", \"hits\": " << stats.morphHits << ", \"misses\": " << stats.morphMisses << "}}";
+	return json.str();
+}
+
+//================================================
+/*
+sendRequest(string socketPath, string request, ostream& out)
+
+* PURPOSE: the client of the server: send one request and copy its reply, a streamed video to
+*          standard output (its stream line to the error output), any other reply to out
+* INPUTS: param -- string socketPath -- path of the server's socket
+*         param -- string request -- the request line, without its end
+*         param -- ostream& out -- receives the reply lines
+* OUTPUTS: bool, false if the server cannot be reached, the reply is an error or a stream ended
+*          before its frames were all sent (as far as its size tells)
+*/
+//================================================
+bool sendRequest(string socketPath, string request, ostream& out){
+	int server = connectTo(socketPath);
+	if (server < 0){
+		cerr << "Could not connect to a morph server on " << socketPath << endl;
+		return false;
+	}
+	string line, rest;
+	if (!sendAll(server, request + "\n") || !receiveLine(server, line, rest)){
+		cerr << "The morph server on " << socketPath << " did not reply" << endl;
+		close(server);
+		return false;
+	}
+	if (line.compare(0, 7, "stream ") != 0){
+		out << line << endl;
+		close(server);
+		return line.compare(0, 6, "error ") != 0;
+	}
+
+	cerr << line << endl;
+	string format;
+	long frames = 0, width = 0, height = 0;
+	stringstream(line.substr(7)) >> format >> frames >> width >> height;
+	long received = rest.size();
+	fwrite(rest.data(), 1, rest.size(), stdout);
+	char chunk[65536];
+	ssize_t count;
+	while ((count = recv(server, chunk, sizeof(chunk), 0)) != 0){
+		if (count < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			break;
+		}
+		fwrite(chunk, 1, count, stdout);
+		received += count;
+	}
+	fflush(stdout);
+	close(server);
+	if (format == "rgba" && received != frames * width * height * 4){ // y4m has headers of any length
+		cerr << "The stream ended after " << received << " bytes" << endl;
+		return false;
+	}
+	return received > 0;
+}
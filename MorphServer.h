@@ -0,0 +1,154 @@
+// MorphServer.h
+//
+// Class MorphServer is a long running morpher that takes morph requests over a Unix domain
+// socket, so that small interactive morphs do not pay for starting a process, loading the
+// image plugins and decoding their images every time. Between requests it keeps, in memory:
+//  - the decoded images, by path, checked against the size and modification time of the file
+//    on every request and dropped, least recently used first, beyond cacheBytes
+//  - the prepared morphs: the FrameGenerator of a chain of images and a segment file, with its
+//    segments paired by id (the compiled segment tables) and its tiled images, so a request
+//    that only changes the frame times or the output starts rendering at once
+//
+// A client connects, sends one request as a line of text and reads the reply, then the server
+// closes the connection. Requests:
+//
+//     morph [-times list | -ease curve] [-format f] [-fps n] imgA imgB [imgC ...] segmentfile nframes output
+//         the words of a manifest line (see JobScheduler.h). The frames are written to output
+//         as in batch mode and the reply is "ok <frames> <milliseconds>", or "error <reason>".
+//         With output "-" the frames are streamed back: the reply is the line
+//         "stream <format> <frames> <width> <height>" followed by the video (y4m by default),
+//         and the end of the connection ends the stream.
+//     stats
+//         one line of JSON: requests queued and running, completed and failed, percentiles of
+//         the latency (from the request arriving to its reply) and of the time spent queued,
+//         and the entries, size, hits and misses of both caches
+//     shutdown
+//         reply "ok", finish the queued requests and stop
+//
+// Connections are accepted on the thread that calls serve(), which polls them all for their
+// request line, answers stats at once and queues morphs for a worker thread; morphs run one at a
+// time, each using the whole pool. A client that does not send its request within
+// SERVER_REQUEST_TIMEOUT seconds is dropped, and a reply that makes no progress for
+// SERVER_SEND_TIMEOUT seconds (a client that stopped reading its stream) fails the request.
+// Paths in requests are opened by the server, relative ones from its working directory.
+//
+// Members of class MorphServer include:
+//  string socketPath - path of the socket
+//  int listener - listening socket, -1 before start()
+//  ThreadPool* pool - threads the frames are rendered on
+//  function<bool(string, Pixmap&)> reader - decodes an image file
+//  function<bool(Pixmap&, string)> writer - writes one frame to one image file
+//  long cacheBytes - size limit of the decoded images kept
+//  deque<Request> queue - morph requests waiting for the worker
+//  map<string, CachedImage> images - decoded images by path
+//  map<string, CachedMorph> morphs - prepared morphs by their images and segment file
+//  ServerStats stats - counters and recent latencies, read by the stats request
+//
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include "Pixmap.h"
+#include "ThreadPool.h"
+#include "FrameGenerator.h"
+#include "JobScheduler.h"
+using namespace std;
+
+#ifndef MORPHSERVER
+#define MORPHSERVER
+
+#define SERVER_MAX_MORPHS 8 // prepared morphs kept
+#define SERVER_LATENCY_SAMPLES 1024 // latencies kept for the percentiles, the most recent
+#define SERVER_REQUEST_TIMEOUT 5 // seconds a client has to send its request line
+#define SERVER_SEND_TIMEOUT 10 // seconds a reply may wait on a client that does not read
+
+class MorphServer{
+	private:
+		struct Request{
+			int client; // connection, closed once answered
+			string text; // the request line, or what has arrived of it
+			chrono::steady_clock::time_point arrived;
+		};
+		struct CachedImage{
+			shared_ptr<Pixmap> image; // shared with the prepared morphs that use it
+			long bytes;
+			long fileSize; // size and modification time of the file when it was decoded
+			long fileSeconds;
+			long fileNanoseconds;
+			long lastUsed; // request number, for the eviction order
+		};
+		struct CachedMorph{
+			shared_ptr<FrameGenerator> generator;
+			vector< shared_ptr<Pixmap> > images; // keep the images of the generator alive
+			vector<string> paths;
+			long lastUsed;
+		};
+		struct ServerStats{
+			long completed;
+			long failed;
+			long imageHits, imageMisses;
+			long morphHits, morphMisses;
+			int running;
+			vector<double> latencies; // milliseconds, a ring of SERVER_LATENCY_SAMPLES
+			vector<double> waits; // milliseconds spent queued, likewise
+			long samples; // latencies recorded, the next goes at samples % SERVER_LATENCY_SAMPLES
+			long cachedImages, cachedImageBytes; // size of the caches after the last request
+			long cachedMorphs;
+		};
+
+		string socketPath;
+		int listener;
+		ThreadPool* pool;
+		function<bool(string, Pixmap&)> reader;
+		function<bool(Pixmap&, string)> writer;
+		long cacheBytes;
+
+		mutex queueLock;
+		condition_variable queueReady;
+		deque<Request> queue;
+		bool stopping;
+		thread worker;
+
+		map<string, CachedImage> images; // the caches are used by the worker only
+		long imageBytes;
+		map<string, CachedMorph> morphs;
+		long requestCount;
+
+		mutex statsLock; // guards stats, and the cache sizes it reports
+		ServerStats stats;
+
+		bool answerRequest(Request& request);
+		void workerLoop(void);
+		void handleMorph(Request& request);
+		bool runMorph(MorphJob& job, int client, bool& streamed, int& frames, string& error);
+		CachedMorph* prepareMorph(MorphJob& job, string& error);
+		shared_ptr<Pixmap> getImage(string path, string& error);
+		void dropImage(string path);
+		void evictImages(vector<string>& keep);
+		string statsJson(void);
+	public:
+		// constructor -- cacheBytes limits the decoded images kept between requests
+		MorphServer(string socketPath, ThreadPool* pool, function<bool(string, Pixmap&)> reader,
+				function<bool(Pixmap&, string)> writer, long cacheBytes);
+		~MorphServer(void);
+
+		// create and listen on the socket (replacing a stale one). Returns false with the reason
+		// in error if it cannot, or another server is listening there.
+		bool start(string& error);
+		// accept requests until a shutdown request, then finish the queued ones and return
+		void serve(void);
+};
+
+// send one request line to the server at socketPath and copy its reply to standard output (a
+// streamed video) or out (reply lines). Returns false if the server cannot be reached or the
+// reply is an error.
+bool sendRequest(string socketPath, string request, ostream& out);
+
+#endif
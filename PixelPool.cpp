@@ -0,0 +1,158 @@
+// PixelPool.cpp
+//
+// Recycling pool of the pixel arrays behind every Pixmap. See PixelPool.h.
+//
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include "PixelPool.h"
+#include "Pixel.h"
+using namespace std;
+
+// returned arrays by pixel count, every member is guarded by poolLock
+static mutex poolLock;
+static map<int, vector<Pixel*> > freeArrays;
+static PoolReport poolReport = {0, 0, 0, 0, 0};
+static long bytesAllocated = 0;
+
+//================================================
+/*
+freeReturnedArrays(long bytesNeeded)
+
+* PURPOSE: free returned arrays, largest first, until bytesNeeded more bytes fit under the high
+*          water mark (or none are left), the caller holds poolLock
+* INPUTS: param -- long bytesNeeded -- size of the array about to be allocated
+* OUTPUTS: none
+*/
+//================================================
+static void freeReturnedArrays(long bytesNeeded){
+	while (!freeArrays.empty() &&
+	       poolReport.bytesInUse + poolReport.bytesFree + bytesNeeded > poolReport.highWater){
+		map<int, vector<Pixel*> >::iterator largest = --freeArrays.end();
+		delete [] largest->second.back();
+		largest->second.pop_back();
+		poolReport.bytesFree -= long(largest->first) * sizeof(Pixel);
+		if (largest->second.empty()){
+			freeArrays.erase(largest);
+		}
+	}
+}
+
+//================================================
+/*
+acquirePixels(int count)
+
+* PURPOSE: hand out an array of count pixels, reusing a returned array of that size if there is
+*          one. A reused array holds the pixels of its previous image; a new one is black and
+*          opaque (the Pixel default).
+* INPUTS: param -- int count -- number of pixels
+* OUTPUTS: Pixel*, the array, NULL if count is 0
+*/
+//================================================
+Pixel* acquirePixels(int count){
+	if (count <= 0){
+		return NULL;
+	}
+	long bytes = long(count) * sizeof(Pixel);
+	lock_guard<mutex> guard(poolLock);
+	poolReport.bytesInUse += bytes;
+	poolReport.highWater = max(poolReport.highWater, poolReport.bytesInUse);
+
+	map<int, vector<Pixel*> >::iterator match = freeArrays.find(count);
+	if (match != freeArrays.end()){
+		Pixel* pixels = match->second.back();
+		match->second.pop_back();
+		if (match->second.empty()){
+			freeArrays.erase(match);
+		}
+		poolReport.bytesFree -= bytes;
+		poolReport.reuses += 1;
+		return pixels;
+	}
+
+	freeReturnedArrays(0); // bytes already counted in bytesInUse
+	poolReport.allocations += 1;
+	bytesAllocated += bytes;
+	return new Pixel[count];
+}
+
+//================================================
+/*
+releasePixels(Pixel* pixels, int count)
+
+* PURPOSE: return an array to the pool for reuse
+* INPUTS: param -- Pixel* pixels -- array from acquirePixels, or NULL
+*         param -- int count -- number of pixels it was acquired with
+* OUTPUTS: none
+*/
+//================================================
+void releasePixels(Pixel* pixels, int count){
+	if (pixels == NULL){
+		return;
+	}
+	long bytes = long(count) * sizeof(Pixel);
+	lock_guard<mutex> guard(poolLock);
+	freeArrays[count].push_back(pixels);
+	poolReport.bytesInUse -= bytes;
+	poolReport.bytesFree += bytes;
+}
+
+//================================================
+/*
+trimPixelPool()
+
+* PURPOSE: free every returned array, ex. when a long session moves on to images of another size
+* INPUTS: none
+* OUTPUTS: none
+*/
+//================================================
+void trimPixelPool(void){
+	lock_guard<mutex> guard(poolLock);
+	for (map<int, vector<Pixel*> >::iterator it = freeArrays.begin(); it != freeArrays.end(); it++){
+		for (int i = 0; i < it->second.size(); i++){
+			delete [] it->second[i];
+		}
+	}
+	freeArrays.clear();
+	poolReport.bytesFree = 0;
+}
+
+//================================================
+/*
+resetPoolReport(), getPoolReport()
+
+* PURPOSE: restart / read the statistics of the pool. A reset sets the high water mark to the
+*          bytes in use, so returned arrays beyond it are freed as new sizes are needed.
+* INPUTS: none
+* OUTPUTS: getPoolReport returns bytes in use, bytes waiting for reuse, the high water mark and
+*          the number of arrays allocated and reused
+*/
+//================================================
+void resetPoolReport(void){
+	lock_guard<mutex> guard(poolLock);
+	poolReport.highWater = poolReport.bytesInUse;
+	poolReport.allocations = 0;
+	poolReport.reuses = 0;
+}
+
+PoolReport getPoolReport(void){
+	lock_guard<mutex> guard(poolLock);
+	return poolReport;
+}
+
+//================================================
+/*
+getBytesAllocated()
+
+* PURPOSE: total size of the arrays the pool has allocated (not reused), unaffected by
+*          resetPoolReport
+* INPUTS: none
+* OUTPUTS: long, bytes
+*/
+//================================================
+long getBytesAllocated(void){
+	lock_guard<mutex> guard(poolLock);
+	return bytesAllocated;
+}
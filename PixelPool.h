@@ -0,0 +1,50 @@
+// PixelPool.h
+//
+// Recycling pool of the pixel arrays behind every Pixmap. A Pixmap takes its array from the pool
+// when it is created and gives it back when it is destroyed; the next Pixmap of the same size
+// reuses it instead of allocating (and first touching) a new frame. A sequence of frames of one
+// size therefore allocates memory only until the first frames are returned.
+//
+// Reused arrays keep the pixels of the image that last used them: a Pixmap that must start
+// black still has to be filled, one that is about to be written completely (a rendered frame,
+// a decoded image) does not.
+//
+// The pool never holds more memory than the high-water mark of the bytes in use: when an array
+// of a new size is needed and returned arrays would push the total over that mark, returned
+// arrays are freed first.
+//
+// All functions may be called from any thread.
+//
+#include <iostream>
+#include "Pixel.h"
+using namespace std;
+
+#ifndef PIXELPOOL
+#define PIXELPOOL
+
+// what the pool holds, high water since the last reset
+struct PoolReport{
+	long bytesInUse; // bytes of arrays handed out and not yet returned
+	long bytesFree; // bytes of returned arrays waiting to be reused
+	long highWater; // largest bytesInUse seen
+	long allocations; // arrays allocated
+	long reuses; // arrays handed out again after being returned
+};
+
+// array of count pixels, a returned one of the same size if there is one
+Pixel* acquirePixels(int count);
+// give back an array from acquirePixels (NULL is ignored)
+void releasePixels(Pixel* pixels, int count);
+
+// free every returned array
+void trimPixelPool(void);
+
+// high water and counts restart from the current bytes in use
+void resetPoolReport(void);
+PoolReport getPoolReport(void);
+
+// bytes of new arrays allocated since the program started, never reset, so the difference
+// of two calls is what was allocated in between (see TraceScope)
+long getBytesAllocated(void);
+
+#endif
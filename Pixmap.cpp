@@ -18,11 +18,20 @@
 
 #include <iostream>
 #include <vector>
+#include <cstring>
+#include <sys/mman.h>
 #include "Pixmap.h"
 #include "Pixel.h"
 #include "Segment.h"
+#include "PixelPool.h"
+#include "WarpSimd.h"
 using namespace std;
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  include <immintrin.h>
+#  define MORPHER_X86_SIMD
+#endif
+
 
 //================================================
 /* 
@@ -36,16 +45,20 @@ Pixmap()
 Pixmap::Pixmap(void){
 	width = 0;
 	height = 0;
-	pmPointer = new Pixel*[height];
-	dataPointer = new Pixel[height * width];
+	pmPointer = NULL;
+	dataPointer = NULL;
+	mapping = NULL;
+	mappingBytes = 0;
 	filename = "";
+	setDataWindow(0, 0, width, height);
 }
 
 //================================================
 /* 
 Pixmap(int w, int h)
 
-* PURPOSE: variable constructor
+* PURPOSE: variable constructor, the pixels are taken from the pixel pool and may hold the
+*          pixels of an earlier image, fill them (fillSolidColor) if the image must start blank
 * INPUTS: param -- int w-- xresolution of the image
 *	  param -- int h-- yresolution of the image
 * OUTPUTS : none
@@ -55,17 +68,239 @@ Pixmap::Pixmap(int w, int h){
 	width = w;
 	height = h;
 	pmPointer = new Pixel*[height];
-	dataPointer = new Pixel[height * width];
+	dataPointer = acquirePixels(height * width);
+	mapping = NULL;
+	mappingBytes = 0;
 	filename = "";
+	setDataWindow(0, 0, w, h);
 
 
 	// construct 2D array for convenient [x][y] indexing of pixels
-	pmPointer[0] = dataPointer;
+	if (height > 0){
+		pmPointer[0] = dataPointer;
+	}
 	for (int i=1; i < height; i++){    //index begins at 1
 		pmPointer[i] = pmPointer[i-1] + width;
 	} 
 }
 
+//================================================
+/* 
+Pixmap(int w, int h, void* mapping, long mappingBytes, long offset)
+
+* PURPOSE: variable constructor over pixels already in memory mapped from a file (a cached
+*          decoded image), nothing is copied. The mapping is unmapped with the Pixmap; it should
+*          be private (MAP_PRIVATE) if the pixels may be changed.
+* INPUTS: param -- int w, h -- size of the image
+*         param -- void* mapping -- start of the mapping, from mmap
+*         param -- long mappingBytes -- length of the mapping
+*         param -- long offset -- byte offset of the first pixel in the mapping
+* OUTPUTS : none
+*/
+//================================================
+Pixmap::Pixmap(int w, int h, void* mapping, long mappingBytes, long offset){
+	width = w;
+	height = h;
+	pmPointer = new Pixel*[height];
+	dataPointer = (Pixel*)((char*)mapping + offset);
+	this->mapping = mapping;
+	this->mappingBytes = mappingBytes;
+	filename = "";
+	setDataWindow(0, 0, w, h);
+
+	for (int i = 0; i < height; i++){
+		pmPointer[i] = dataPointer + (long(i) * width);
+	}
+}
+
+//================================================
+/* 
+freePixels()
+
+* PURPOSE: return the pixels to the pixel pool, or unmap them if they are mapped from a file
+* INPUTS: none
+* OUTPUTS : none
+*/
+//================================================
+void Pixmap::freePixels(void){
+	if (mapping != NULL){
+		munmap(mapping, mappingBytes);
+	}
+	else{
+		releasePixels(dataPointer, width * height);
+	}
+	delete [] pmPointer;
+}
+
+//================================================
+/* 
+~Pixmap()
+
+* PURPOSE: destructor, give back the pixels (freePixels)
+* INPUTS: none
+* OUTPUTS : none
+*/
+//================================================
+Pixmap::~Pixmap(void){
+	freePixels();
+}
+
+//================================================
+/* 
+Pixmap(Pixmap&& other), operator=(Pixmap&& other)
+
+* PURPOSE: move constructor and assignment, take over the pixels, segments, filename and data window of
+*          other, which is left with no size. Assignment first returns the pixels this Pixmap
+*          held.
+* INPUTS: param -- Pixmap&& other -- Pixmap being moved
+* OUTPUTS : none / this Pixmap
+*/
+//================================================
+Pixmap::Pixmap(Pixmap&& other){
+	width = 0;
+	height = 0;
+	pmPointer = NULL;
+	dataPointer = NULL;
+	mapping = NULL;
+	mappingBytes = 0;
+	*this = move(other);
+}
+
+Pixmap& Pixmap::operator=(Pixmap&& other){
+	if (this != &other){
+		freePixels();
+		width = other.width;
+		height = other.height;
+		pmPointer = other.pmPointer;
+		dataPointer = other.dataPointer;
+		mapping = other.mapping;
+		mappingBytes = other.mappingBytes;
+		segmentList = move(other.segmentList);
+		filename = move(other.filename);
+		setDataWindow(other.originX, other.originY, other.fullWidth, other.fullHeight);
+		other.width = 0;
+		other.height = 0;
+		other.pmPointer = NULL;
+		other.dataPointer = NULL;
+		other.mapping = NULL;
+		other.mappingBytes = 0;
+		other.segmentList.clear();
+		other.filename = "";
+		other.setDataWindow(0, 0, 0, 0);
+	}
+	return *this;
+}
+
+//================================================
+/* 
+clone()
+
+* PURPOSE: make a copy of the image that owns its own pixels
+* INPUTS: none
+* OUTPUTS : Pixmap, same size, pixels, segments, filename and data window
+*/
+//================================================
+Pixmap Pixmap::clone(void){
+	Pixmap copy(width, height);
+	for (int i = 0; i < width * height; i++){
+		copy.dataPointer[i] = dataPointer[i];
+	}
+	copy.segmentList = segmentList;
+	copy.filename = filename;
+	copy.setDataWindow(originX, originY, fullWidth, fullHeight);
+	return copy;
+}
+
+//================================================
+/* 
+expandRowScalar(const unsigned char* channelVals, int numChannels, unsigned char* rgba, int count)
+
+* PURPOSE: turn count pixels of 1 channel (greyscale) or 3 channel (RGB) values into RGBA
+*          pixels, opaque. channelVals may lie inside rgba, at or after byte count * (4 - numChannels)
+*          (see expandChannels): each pixel is read before it is written, and a pixel never
+*          overwrites values still to be read.
+* INPUTS: param -- const unsigned char* channelVals -- numChannels values per pixel
+*         param -- int numChannels -- 1 or 3
+*         param -- unsigned char* rgba -- receives 4 values per pixel
+*         param -- int count -- number of pixels
+* OUTPUTS: none
+*/
+//================================================
+static void expandRowScalar(const unsigned char* channelVals, int numChannels, unsigned char* rgba, int count){
+	for (int i = 0; i < count; i++){
+		unsigned char r = channelVals[numChannels * i];
+		unsigned char g = (numChannels == 3) ? channelVals[(3 * i) + 1] : r; // RGB values are equal in greyscale images
+		unsigned char b = (numChannels == 3) ? channelVals[(3 * i) + 2] : r;
+		rgba[4 * i] = r;
+		rgba[(4 * i) + 1] = g;
+		rgba[(4 * i) + 2] = b;
+		rgba[(4 * i) + 3] = 255; // no alpha information, set to opaque
+	}
+}
+
+#ifdef MORPHER_X86_SIMD
+//================================================
+/* 
+expandRowAvx2(const unsigned char* channelVals, int numChannels, unsigned char* rgba, int count)
+
+* PURPOSE: same as expandRowScalar, 8 pixels at a time. RGB: the 24 bytes of 8 pixels are loaded
+*          as two 16 byte halves (4 pixels in the low 12 bytes of each 128 bit lane) and one
+*          byte shuffle spreads them to RGB0 slots that the alpha fills. Greyscale: the 8 bytes
+*          are widened to 32 bits and copied into R, G and B with shifts. Every block is loaded
+*          before it is stored, and the loop stops early enough that a store never reaches the
+*          values of a later block when channelVals lies inside rgba.
+* INPUTS: see expandRowScalar
+* OUTPUTS: int, number of pixels converted from the start (a multiple of 8), the caller
+*          converts the rest with expandRowScalar
+*/
+//================================================
+__attribute__((target("avx2")))
+static int expandRowAvx2(const unsigned char* channelVals, int numChannels, unsigned char* rgba, int count){
+	const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+	int i = 0;
+	if (numChannels == 3){
+		const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+							0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		for (; i + 10 <= count; i += 8){ // the second load reads 4 bytes past the block
+			__m128i low = _mm_loadu_si128((__m128i*)(channelVals + (3 * i)));
+			__m128i high = _mm_loadu_si128((__m128i*)(channelVals + (3 * i) + 12));
+			__m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+			pixels = _mm256_or_si256(_mm256_shuffle_epi8(pixels, spread), alpha);
+			_mm256_storeu_si256((__m256i*)(rgba + (4 * i)), pixels);
+		}
+	}
+	else{
+		for (; i + 8 <= count; i += 8){
+			__m256i grey = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i*)(channelVals + i)));
+			__m256i pixels = _mm256_or_si256(_mm256_or_si256(grey, _mm256_slli_epi32(grey, 8)),
+							 _mm256_or_si256(_mm256_slli_epi32(grey, 16), alpha));
+			_mm256_storeu_si256((__m256i*)(rgba + (4 * i)), pixels);
+		}
+	}
+	return i;
+}
+#endif
+
+//================================================
+/* 
+expandToRGBA(const unsigned char* channelVals, int numChannels, unsigned char* rgba, int count)
+
+* PURPOSE: turn count pixels of 1 or 3 channel values into opaque RGBA pixels, with AVX2 when the
+*          processor supports it. Same in-place rule as expandRowScalar.
+* INPUTS: see expandRowScalar
+* OUTPUTS: none
+*/
+//================================================
+static void expandToRGBA(const unsigned char* channelVals, int numChannels, unsigned char* rgba, int count){
+	int done = 0;
+#ifdef MORPHER_X86_SIMD
+	if (simdWidthAvailable() >= 8){
+		done = expandRowAvx2(channelVals, numChannels, rgba, count);
+	}
+#endif
+	expandRowScalar(channelVals + (numChannels * done), numChannels, rgba + (4 * done), count - done);
+}
+
 //================================================
 /* 
 fillPixmap(unsigned char[] channelVals, int numChannels)
@@ -87,75 +322,37 @@ fillPixmap(unsigned char[] channelVals, int numChannels)
 //================================================
 
 void Pixmap::fillPixmap(unsigned char* channelVals, int numChannels){
-	int channelValsSize = width*height*numChannels;
-	//======================================
-	// 4 channel (RGBA) image
-	if (numChannels == 4){
-		int channelIndex = 0; // tells us what channel we're looking at (R0,G1,B2,A3)
-		int pixelIndex = 0; //index in dataPointer array of Pixels
-		for (int i=0; i < channelValsSize; i++){ // loop through spaces in unsigned char array
-			//++++++++++++++++++++++++++++
-			if (channelIndex == 0){ // if you've reached an alpha value
-				dataPointer[pixelIndex].setRVal(channelVals[i]);
-				channelIndex = channelIndex + 1; // tell program to expect G val next
-			}
-			//++++++++++++++++++++++++++++
-			else if (channelIndex == 1){ // if you've reached an alpha value
-				dataPointer[pixelIndex].setGVal(channelVals[i]);
-				channelIndex = channelIndex + 1; // tell program to expect B val next
-			}
-			//++++++++++++++++++++++++++++
-			else if (channelIndex == 2){ // if you've reached an alpha value
-				dataPointer[pixelIndex].setBVal(channelVals[i]);
-				channelIndex = channelIndex + 1; // tell program to expect A val next
-			}
-			//++++++++++++++++++++++++++++
-			else if (channelIndex == 3){ // if you've reached an alpha value
-				dataPointer[pixelIndex].setAVal(channelVals[i]);
-				channelIndex = 0; // tell program to expect R val next
-				pixelIndex = pixelIndex + 1; // move to the next pixel
-			}
-		}
+	unsigned char* rgba = (unsigned char*)dataPointer; // a Pixel is its four channel values
+	if (numChannels == 4){ // 4 channel (RGBA) image, already in the layout of the pixels
+		memcpy(rgba, channelVals, width * height * 4);
 	}
-        //======================================
-	// 3 channel (RGB) image
-	if (numChannels == 3){
-		int channelIndex = 0; // tells us what channel we're looking at (R0,G1,B2,A3)
-		int pixelIndex = 0; //index in dataPointer array of Pixels
-		for (int i=0; i < channelValsSize; i++){ // loop through spaces in unsigned char array
-			//++++++++++++++++++++++++++++
-			if (channelIndex == 0){ // if you've reached an R value
-				dataPointer[pixelIndex].setRVal(channelVals[i]);
-				channelIndex = channelIndex + 1; // tell program to expect G val next
-			}
-			//++++++++++++++++++++++++++++
-			else if (channelIndex == 1){ // if you've reached an G value
-				dataPointer[pixelIndex].setGVal(channelVals[i]);
-				channelIndex = channelIndex + 1; // tell program to expect B val next
-			}
-			//++++++++++++++++++++++++++++
-			else if (channelIndex == 2){ // if you've reached a B value
-				dataPointer[pixelIndex].setBVal(channelVals[i]);
-				dataPointer[pixelIndex].setAVal(255); // no alpha information, set to opaque
-				channelIndex = 0; // go back to R val
-				pixelIndex = pixelIndex + 1;
-			}		
-		}
+	else if (numChannels == 3 || numChannels == 1){ // RGB or greyscale image
+		expandToRGBA(channelVals, numChannels, rgba, width * height);
 	}
-	//======================================	
-	// 1 channel (greyscale) image
-	if (numChannels == 1){
-		int pixelIndex = 0;
-		for (int i=0; i < channelValsSize; i++){ // loop through spaces in unsigned char array
-			unsigned char greyVal = channelVals[i];
-			dataPointer[pixelIndex].setRVal(greyVal); // RGB values are equal in greyscale images
-			dataPointer[pixelIndex].setGVal(greyVal);
-			dataPointer[pixelIndex].setBVal(greyVal);
-			dataPointer[pixelIndex].setAVal(255);
-			pixelIndex = pixelIndex + 1;
-		}	
+}
+
+//================================================
+/* 
+packedChannels(int numChannels), expandChannels(int numChannels)
+
+* PURPOSE: let an image be decoded straight into the pixels of the Pixmap, without a separate
+*          buffer. The decoder writes numChannels values per pixel, packed, at the address
+*          packedChannels returns: the start of the pixels for 4 channels, else the last
+*          width * height * numChannels bytes of them. expandChannels then spreads the values
+*          into RGBA pixels in place, front to back, in a single pass.
+* INPUTS: param -- int numChannels -- 1, 3 or 4
+* OUTPUTS: packedChannels returns where to decode the numChannels values, expandChannels none
+*/
+//================================================
+unsigned char* Pixmap::packedChannels(int numChannels){
+	unsigned char* rgba = (unsigned char*)dataPointer;
+	return rgba + (width * height * (4 - numChannels));
+}
+
+void Pixmap::expandChannels(int numChannels){
+	if (numChannels == 3 || numChannels == 1){
+		expandToRGBA(packedChannels(numChannels), numChannels, (unsigned char*)dataPointer, width * height);
 	}
-	
 }
 
 //================================================
@@ -200,10 +397,37 @@ Pixel* Pixmap::getDataPointer(void){
 	return dataPointer;
 }
 
+bool Pixmap::isMapped(void){
+	return mapping != NULL;
+}
+
 void Pixmap::setFilename(string fn){
 	filename = fn;
 }
 
+void Pixmap::setDataWindow(int x, int y, int fullWidth, int fullHeight){
+	originX = x;
+	originY = y;
+	this->fullWidth = fullWidth;
+	this->fullHeight = fullHeight;
+}
+
+int Pixmap::getOriginX(void){
+	return originX;
+}
+
+int Pixmap::getOriginY(void){
+	return originY;
+}
+
+int Pixmap::getFullWidth(void){
+	return fullWidth;
+}
+
+int Pixmap::getFullHeight(void){
+	return fullHeight;
+}
+
 //================================================
 int Pixmap::getNumSegments(void){
 	return segmentList.size();
@@ -213,15 +437,25 @@ void Pixmap::addSegment(Segment seg){
 	segmentList.push_back(seg);
 }
 
+// replace the segment at index in the segment list
+void Pixmap::setSegment(int index, Segment seg){
+	segmentList[index] = seg;
+}
+
+// replace every segment
+void Pixmap::setSegmentList(vector<Segment> segments){
+	segmentList = segments;
+}
+
 
 vector<Segment> Pixmap::getSegmentList(void){
 	return segmentList;
 }
 
 // search for a segment based on it's identifying name
-// returns an index of the found segment in the segment list
+// returns an index of the found segment in the segment list, -1 if there is none
 int Pixmap::getSegmentById(string id){
-	int foundPos;
+	int foundPos = -1;
 	bool found = false;
 	int i = 0;
 	while (found == false && i < segmentList.size()){
@@ -234,9 +468,7 @@ int Pixmap::getSegmentById(string id){
 		}
 	}
 	
-	if (found == true){
-		return foundPos;
-	}
+	return foundPos;
 }
 
 
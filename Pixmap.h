@@ -5,6 +5,15 @@
 //
 // NOTE: This class depends on class Pixel
 //
+// A Pixmap owns its pixels, which come from the pixel pool (see PixelPool.h) and go back to it
+// when the Pixmap is destroyed. Pixmaps can be moved but not copied; clone() makes a copy with
+// its own pixels. The pixels of a cached image (see ImageCache.h) instead lie in a memory
+// mapping of the cache file, which the Pixmap unmaps when it is destroyed.
+//
+// A Pixmap may hold only part of a larger image, its data window: its pixel (0, 0) is pixel
+// (originX, originY) of an image of fullWidth x fullHeight (see FrameRegion.h). By default it
+// is the whole image.
+//
 // Members of the class include:
 
 //
@@ -24,15 +33,37 @@ class Pixmap{
 		Pixel** pmPointer; // 2D array pointer, points to column of pointers to rows of Pixel objects
 				   // (i.e. pmPointer[1] points to the FIRST row of Pixels that form the image
 		Pixel* dataPointer; // 1D array pointer, points to array of Pixels of length width * height
+		void* mapping; // memory mapping holding the pixels, NULL if they come from the pixel pool
+		long mappingBytes; // length of mapping
 		vector<Segment> segmentList; // vector of segment objects, identify distinct features to be morphed
 		string filename; // filename of read image
+		int originX, originY; // position of the pixels in the full image
+		int fullWidth, fullHeight; // size of the full image
+
+		void freePixels(void);
 	public:
-		// constructors -- default and variable
+		// constructors -- default and variable, the pixels of a new Pixmap are not cleared
 		Pixmap(void);
 		Pixmap(int w, int h);
+		// pixels at byte offset of a memory mapping (mmap) of mappingBytes, which the Pixmap
+		// takes over and unmaps when it is destroyed
+		Pixmap(int w, int h, void* mapping, long mappingBytes, long offset);
+		~Pixmap(void);
+
+		// move the pixels of other into this Pixmap, other is left empty (0 x 0)
+		Pixmap(Pixmap&& other);
+		Pixmap& operator=(Pixmap&& other);
+		Pixmap(const Pixmap& other) = delete;
+		Pixmap& operator=(const Pixmap& other) = delete;
+		// copy of the image, its pixels, segments and filename
+		Pixmap clone(void);
         	
 		// fill pixmap with pixel data and adjust so that the pixmap has four channels
 		void fillPixmap(unsigned char* channelVals, int numChannels);
+		// decode an image straight into the pixels: write numChannels (1, 3 or 4) values per pixel
+		// at packedChannels(numChannels), then expandChannels(numChannels) makes them RGBA
+		unsigned char* packedChannels(int numChannels);
+		void expandChannels(int numChannels);
 		void fillSolidColor(unsigned char rVal, unsigned char gVal, unsigned char bVal, unsigned char aVal);
 		
        		// getters and setters to members of the class
@@ -42,10 +73,19 @@ class Pixmap{
 		int getHeight(void);
 		Pixel** getPmPointer(void);
 		Pixel* getDataPointer(void);
+		bool isMapped(void);
+		// the pixels are the part of an image of fullWidth x fullHeight from (x, y)
+		void setDataWindow(int x, int y, int fullWidth, int fullHeight);
+		int getOriginX(void);
+		int getOriginY(void);
+		int getFullWidth(void);
+		int getFullHeight(void);
 		
 		// functions to access and modify feature segments
 		int getNumSegments(void);
 		void addSegment(Segment seg);
+		void setSegment(int index, Segment seg);
+		void setSegmentList(vector<Segment> segments);
 		int getSegmentById(string id);
 		vector<Segment> getSegmentList(void);
 
@@ -3,6 +3,9 @@
 // 
 
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
 #include "Segment.h"
 using namespace std;
 
@@ -113,3 +116,64 @@ void Segment::setEndVect (Vector2D endCoords){
 void Segment::setId(string featureID){
 	id = featureID;
 }
+
+//================================================
+/* 
+readSegmentFile(string textFilename, vector<string>& filenames, int height,
+		vector< vector<Segment> >& segments, string& error)
+
+* PURPOSE: read the segments of a set of images from a segment file, flipping y so it counts
+*          from the bottom of the image like the pixmaps do. Each block of the file goes to the
+*          first image of its filename that has no block yet, so an image repeated in a chain
+*          (ex. A -> B -> A) takes the blocks of its name in order, and a file in the order of
+*          the images gives the k-th block to the k-th image.
+* INPUTS: param -- string textFilename -- the segment file
+*         param -- vector<string>& filenames -- the images, as named in the file
+*         param -- int height -- height of the images
+*         param -- vector< vector<Segment> >& segments -- receives the segments of each image
+*         param -- string& error -- receives the reason the file could not be read
+* OUTPUTS : bool, false if the file could not be read, or has no block for some image
+*/
+//================================================
+bool readSegmentFile(string textFilename, vector<string>& filenames, int height,
+		vector< vector<Segment> >& segments, string& error){
+	ifstream textFile(textFilename.c_str());
+	if (textFile.fail()){
+		error = "Failed to open text file " + textFilename + ".";
+		return false;
+	}
+	segments.assign(filenames.size(), vector<Segment>());
+	vector<bool> assigned(filenames.size(), false);
+	for (int i = 0; i < filenames.size(); i++){ // one block of segments per image
+		string filename;
+		int numSegments = 0;
+		textFile >> filename >> numSegments;
+		if (textFile.fail()){
+			error = "Segment file " + textFilename + " does not have a block of segments for every image.";
+			return false;
+		}
+		int image = 0;
+		while (image < filenames.size() && (filenames[image] != filename || assigned[image])){
+			image++;
+		}
+		if (image == filenames.size()){
+			error = "No matching filename found in collection for " + filename + " in " + textFilename + ".";
+			return false;
+		}
+		assigned[image] = true;
+		for (int j = 0; j < numSegments; j++){
+			string id;
+			float startX, startY, endX, endY;
+			textFile >> id >> startX >> startY >> endX >> endY;
+			if (textFile.fail()){
+				error = "Segment file " + textFilename + " ends in the segments of " + filename + ".";
+				return false;
+			}
+			// mirror y about the middle row (integer, as the segments have always been read)
+			float startYCoord = (height / 2) + ((height / 2) - startY);
+			float endYCoord = (height / 2) + ((height / 2) - endY);
+			segments[image].push_back(Segment(startX, startYCoord, endX, endYCoord, id));
+		}
+	}
+	return true;
+}
@@ -7,6 +7,8 @@
 // NOTE: This class makes use of Vector2D objects defined in matrix.h
 //
 #include <iostream>
+#include <string>
+#include <vector>
 
 using namespace std;
 
@@ -43,4 +45,13 @@ class Segment{
 
 };
 
+// read a segment file: for each image its filename, its number of segments, then per segment
+// an id and the start and end x y, with y counted from the top of an image of the given height.
+// segments receives the segments of each of filenames, in order, with y counted from the
+// bottom; a block goes to the first image of its name without one, so a repeated image takes
+// the blocks of its name in order. Returns false, with the reason in error, if the file cannot
+// be read, names an image not in filenames (or once more than it appears) or misses one.
+bool readSegmentFile(string textFilename, vector<string>& filenames, int height,
+		vector< vector<Segment> >& segments, string& error);
+
 #endif
@@ -0,0 +1,497 @@
+// SegmentTable.cpp
+//
+// Compiled table of the segment pairs of one warp. See SegmentTable.h.
+//
+
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <math.h>
+#include <algorithm>
+#include "SegmentTable.h"
+#include "Segment.h"
+using namespace std;
+
+//================================================
+/*
+buildSegmentTable(SegmentTable& table, vector<Segment>& sourceSegments,
+		  vector<Segment>& destSegments, double c)
+
+* PURPOSE: fill the table with one entry per destination segment, paired with the source
+*          segment that has the same id, and compute the per-segment constants of the warp.
+*          The ids are matched through a hash map, so building the table costs one lookup
+*          per segment rather than a search of the source list for every pixel.
+* INPUTS: param -- SegmentTable& table -- table to fill, previous contents are replaced
+*         param -- vector<Segment>& sourceSegments -- segments of the source image (P'Q')
+*         param -- vector<Segment>& destSegments -- segments of the frame being rendered (PQ)
+*         param -- double c -- length exponent of the segment weights
+* OUTPUTS: int, number of destination segments with no source segment of the same id
+*/
+//================================================
+int buildSegmentTable(SegmentTable& table, vector<Segment>& sourceSegments,
+		vector<Segment>& destSegments, double c){
+	unordered_map<string, int> sourceIndex; // id -> position in sourceSegments
+	for (int s = 0; s < sourceSegments.size(); s++){
+		sourceIndex[sourceSegments[s].getId()] = s;
+	}
+
+	table = SegmentTable();
+	table.count = 0;
+	table.foldWeight = 0;
+	table.foldX0 = table.foldXx = table.foldXy = 0;
+	table.foldY0 = table.foldYx = table.foldYy = 0;
+	int unmatched = 0;
+	for (int s = 0; s < destSegments.size(); s++){
+		unordered_map<string, int>::iterator found = sourceIndex.find(destSegments[s].getId());
+		if (found == sourceIndex.end()){
+			unmatched = unmatched + 1;
+			continue;
+		}
+		Vector2D P = destSegments[s].getStartVect();
+		Vector2D Q = destSegments[s].getEndVect();
+		Vector2D Pprime = sourceSegments[found->second].getStartVect();
+		Vector2D Qprime = sourceSegments[found->second].getEndVect();
+
+		float dx = Q.x - P.x;
+		float dy = Q.y - P.y;
+		float dpx = Qprime.x - Pprime.x;
+		float dpy = Qprime.y - Pprime.y;
+		float length = sqrt((dx * dx) + (dy * dy));
+		float lengthPrime = sqrt((dpx * dpx) + (dpy * dpy));
+
+		table.id.push_back(destSegments[s].getId());
+		table.px.push_back(P.x);
+		table.py.push_back(P.y);
+		table.qx.push_back(Q.x);
+		table.qy.push_back(Q.y);
+		table.ppx.push_back(Pprime.x);
+		table.ppy.push_back(Pprime.y);
+		table.qpx.push_back(Qprime.x);
+		table.qpy.push_back(Qprime.y);
+		table.dx.push_back(dx);
+		table.dy.push_back(dy);
+		table.dpx.push_back(dpx);
+		table.dpy.push_back(dpy);
+		table.length.push_back(length);
+		table.lengthSq.push_back(length * length);
+		table.lengthPrime.push_back(lengthPrime);
+		table.lengthPow.push_back(pow(double(length), c));
+		table.count = table.count + 1;
+	}
+	return unmatched;
+}
+
+//================================================
+/*
+pointSegmentDistance(float x, float y, float px, float py, float qx, float qy)
+
+* PURPOSE: shortest distance from the point (x, y) to the segment PQ, the dist of the
+*          Beier-Neely weights (|v| beside the segment, distance to P or Q past its ends)
+* INPUTS: param -- float x, y -- the point
+*         param -- float px, py, qx, qy -- ends of the segment
+* OUTPUTS: float, the distance
+*/
+//================================================
+static float pointSegmentDistance(float x, float y, float px, float py, float qx, float qy){
+	float dx = qx - px;
+	float dy = qy - py;
+	float lengthSq = (dx * dx) + (dy * dy);
+	float u = (lengthSq > 0) ? (((x - px) * dx) + ((y - py) * dy)) / lengthSq : 0;
+	u = min(max(u, 0.0f), 1.0f);
+	float nearX = px + (u * dx) - x;
+	float nearY = py + (u * dy) - y;
+	return sqrt((nearX * nearX) + (nearY * nearY));
+}
+
+//================================================
+/*
+segmentsCross(float ax, float ay, float bx, float by, float cx, float cy, float dx, float dy)
+
+* PURPOSE: test whether the segments AB and CD intersect
+* INPUTS: param -- float ax, ay, bx, by -- ends of the first segment
+*         param -- float cx, cy, dx, dy -- ends of the second segment
+* OUTPUTS: bool, true if they share a point
+*/
+//================================================
+static bool segmentsCross(float ax, float ay, float bx, float by, float cx, float cy, float dx, float dy){
+	// sign of the turn from AB to AC, AB to AD, CD to CA and CD to CB
+	float abc = ((bx - ax) * (cy - ay)) - ((by - ay) * (cx - ax));
+	float abd = ((bx - ax) * (dy - ay)) - ((by - ay) * (dx - ax));
+	float cda = ((dx - cx) * (ay - cy)) - ((dy - cy) * (ax - cx));
+	float cdb = ((dx - cx) * (by - cy)) - ((dy - cy) * (bx - cx));
+	return ((abc <= 0 && abd >= 0) || (abc >= 0 && abd <= 0)) && ((cda <= 0 && cdb >= 0) || (cda >= 0 && cdb <= 0));
+}
+
+//================================================
+/*
+distanceRange(SegmentTable& table, int s, float x0, float y0, float x1, float y1, float& nearest,
+	      float& farthest)
+
+* PURPOSE: nearest and farthest distance from the pixels of the rectangle [x0, x1] x [y0, y1] to
+*          the destination segment s of table, which bound the weight of the segment there
+* INPUTS: param -- SegmentTable& table, int s -- the segment
+*         param -- float x0, y0, x1, y1 -- corners of the rectangle, inclusive
+*         param -- float& nearest, farthest -- set to the distances
+* OUTPUTS: none
+*/
+//================================================
+static void distanceRange(SegmentTable& table, int s, float x0, float y0, float x1, float y1, float& nearest,
+		float& farthest){
+	float cornerX[4] = {x0, x1, x0, x1};
+	float cornerY[4] = {y0, y0, y1, y1};
+
+	// nearest distance: 0 if the segment has an end inside the rectangle or crosses a side
+	nearest = 0;
+	bool inside = (table.px[s] >= x0 && table.px[s] <= x1 && table.py[s] >= y0 && table.py[s] <= y1)
+		|| (table.qx[s] >= x0 && table.qx[s] <= x1 && table.qy[s] >= y0 && table.qy[s] <= y1);
+	if (!inside){
+		int sides[4][2] = {{0, 1}, {1, 3}, {3, 2}, {2, 0}}; // corners joined by each side
+		bool crosses = false;
+		for (int k = 0; k < 4 && !crosses; k++){
+			crosses = segmentsCross(table.px[s], table.py[s], table.qx[s], table.qy[s],
+				cornerX[sides[k][0]], cornerY[sides[k][0]], cornerX[sides[k][1]], cornerY[sides[k][1]]);
+		}
+		if (!crosses){
+			// the closest points are then an end of the segment or a corner of the rectangle
+			float endX[2] = {table.px[s], table.qx[s]};
+			float endY[2] = {table.py[s], table.qy[s]};
+			nearest = -1;
+			for (int e = 0; e < 2; e++){
+				float outX = max(max(x0 - endX[e], endX[e] - x1), 0.0f);
+				float outY = max(max(y0 - endY[e], endY[e] - y1), 0.0f);
+				float d = sqrt((outX * outX) + (outY * outY));
+				nearest = (nearest < 0) ? d : min(nearest, d);
+			}
+			for (int k = 0; k < 4; k++){
+				nearest = min(nearest, pointSegmentDistance(cornerX[k], cornerY[k], table.px[s], table.py[s], table.qx[s], table.qy[s]));
+			}
+		}
+	}
+	// farthest distance: the distance to a segment is convex, so it peaks at a corner
+	farthest = 0;
+	for (int k = 0; k < 4; k++){
+		farthest = max(farthest, pointSegmentDistance(cornerX[k], cornerY[k], table.px[s], table.py[s], table.qx[s], table.qy[s]));
+	}
+}
+
+//================================================
+/*
+segmentMatrix(SegmentTable& table, int s, double& Mxx, double& Mxy, double& Myx, double& Myy)
+
+* PURPOSE: the matrix M of the affine map a segment pair gives, X' = P' + M (X - P): M takes
+*          Q - P and its perpendicular to Q' - P' and its (scaled) perpendicular, so the
+*          displacement X' - X = P' - M P + (M - I) X is affine in X too
+* INPUTS: param -- SegmentTable& table, int s -- the segment pair
+*         param -- double& Mxx, Mxy, Myx, Myy -- set to M
+* OUTPUTS: none
+*/
+//================================================
+static void segmentMatrix(SegmentTable& table, int s, double& Mxx, double& Mxy, double& Myx, double& Myy){
+	double L = table.length[s];
+	double Lp = table.lengthPrime[s];
+	Mxx = (table.dpx[s] * table.dx[s]) / (L * L) + (table.dpy[s] * table.dy[s]) / (L * Lp);
+	Mxy = (table.dpx[s] * table.dy[s]) / (L * L) - (table.dpy[s] * table.dx[s]) / (L * Lp);
+	Myx = (table.dpy[s] * table.dx[s]) / (L * L) - (table.dpx[s] * table.dy[s]) / (L * Lp);
+	Myy = (table.dpy[s] * table.dy[s]) / (L * L) + (table.dpx[s] * table.dx[s]) / (L * Lp);
+}
+
+//================================================
+/*
+cullSegmentTable(SegmentTable& table, SegmentTable& culled, float x0, float y0, float x1, float y1,
+		 double a, double b, double fraction)
+
+* PURPOSE: keep, for the pixels of the rectangle [x0, x1] x [y0, y1], only the segment pairs
+*          whose weight can matter. For each segment the nearest and farthest distance from
+*          the rectangle give the largest and smallest weight it can have at any pixel of the
+*          rectangle. The smallest weights of all segments add up to a lower bound on the total
+*          weight of every pixel, and a segment is dropped when even its largest weight is at
+*          most fraction of that bound.
+*          Dropped segments are folded into the fold term of culled rather than ignored: the
+*          displacement X' - X a segment gives is an affine function of X, so with each
+*          weight frozen at its value at the centre of the rectangle their weighted sum is one
+*          affine function, evaluated once per pixel. The error is then only the variation of
+*          those small weights across the rectangle. Segments keep their order, and with
+*          nothing dropped the fold term is zero, so the warp is the same as with the table.
+* INPUTS: param -- SegmentTable& table -- segment pairs of the whole frame
+*         param -- SegmentTable& culled -- filled with the pairs kept, previous contents replaced
+*         param -- float x0, y0, x1, y1 -- corners of the rectangle, inclusive
+*         param -- double a, b -- weight constants, weight = (length^c / (a + dist))^b
+*         param -- double fraction -- weight cutoff, as a fraction of the total weight
+* OUTPUTS: int, number of segment pairs kept
+*/
+//================================================
+int cullSegmentTable(SegmentTable& table, SegmentTable& culled, float x0, float y0, float x1, float y1,
+		double a, double b, double fraction){
+	vector<double> maxWeight(table.count);
+	vector<double> centreWeight(table.count);
+	float centreX = (x0 + x1) / 2;
+	float centreY = (y0 + y1) / 2;
+	double minWeightSum = 0;
+	int strongest = 0; // segment with the largest maximum weight, always kept
+
+	for (int s = 0; s < table.count; s++){
+		float nearest, farthest;
+		distanceRange(table, s, x0, y0, x1, y1, nearest, farthest);
+		maxWeight[s] = pow(table.lengthPow[s] / (a + nearest), b);
+		minWeightSum += pow(table.lengthPow[s] / (a + farthest), b);
+		float centre = pointSegmentDistance(centreX, centreY, table.px[s], table.py[s], table.qx[s], table.qy[s]);
+		centreWeight[s] = pow(table.lengthPow[s] / (a + centre), b);
+		if (maxWeight[s] > maxWeight[strongest]){
+			strongest = s;
+		}
+	}
+
+	culled = SegmentTable();
+	culled.count = 0;
+	double foldWeight = 0;
+	double foldX0 = 0, foldXx = 0, foldXy = 0, foldY0 = 0, foldYx = 0, foldYy = 0;
+	for (int s = 0; s < table.count; s++){
+		if (maxWeight[s] <= fraction * minWeightSum && s != strongest){
+			double Mxx, Mxy, Myx, Myy;
+			segmentMatrix(table, s, Mxx, Mxy, Myx, Myy);
+			double w = centreWeight[s];
+			foldWeight += w;
+			foldX0 += w * (table.ppx[s] - (Mxx * table.px[s]) - (Mxy * table.py[s]));
+			foldXx += w * (Mxx - 1);
+			foldXy += w * Mxy;
+			foldY0 += w * (table.ppy[s] - (Myx * table.px[s]) - (Myy * table.py[s]));
+			foldYx += w * Myx;
+			foldYy += w * (Myy - 1);
+		}
+		else{
+			culled.id.push_back(table.id[s]);
+			culled.px.push_back(table.px[s]);
+			culled.py.push_back(table.py[s]);
+			culled.qx.push_back(table.qx[s]);
+			culled.qy.push_back(table.qy[s]);
+			culled.ppx.push_back(table.ppx[s]);
+			culled.ppy.push_back(table.ppy[s]);
+			culled.qpx.push_back(table.qpx[s]);
+			culled.qpy.push_back(table.qpy[s]);
+			culled.dx.push_back(table.dx[s]);
+			culled.dy.push_back(table.dy[s]);
+			culled.dpx.push_back(table.dpx[s]);
+			culled.dpy.push_back(table.dpy[s]);
+			culled.length.push_back(table.length[s]);
+			culled.lengthSq.push_back(table.lengthSq[s]);
+			culled.lengthPrime.push_back(table.lengthPrime[s]);
+			culled.lengthPow.push_back(table.lengthPow[s]);
+			culled.count = culled.count + 1;
+		}
+	}
+	culled.foldWeight = foldWeight;
+	culled.foldX0 = foldX0;
+	culled.foldXx = foldXx;
+	culled.foldXy = foldXy;
+	culled.foldY0 = foldY0;
+	culled.foldYx = foldYx;
+	culled.foldYy = foldYy;
+	return culled.count;
+}
+
+//================================================
+/*
+maxDisplacement(SegmentTable& table, int s, float x0, float y0, float x1, float y1)
+
+* PURPOSE: largest length of the displacement X' - X a segment pair gives over the rectangle
+*          [x0, x1] x [y0, y1]. The displacement is affine in X and its length convex, so the
+*          largest is at a corner.
+* INPUTS: param -- SegmentTable& table, int s -- the segment pair
+*         param -- float x0, y0, x1, y1 -- corners of the rectangle, inclusive
+* OUTPUTS: double, the length in pixels
+*/
+//================================================
+static double maxDisplacement(SegmentTable& table, int s, float x0, float y0, float x1, float y1){
+	double Mxx, Mxy, Myx, Myy;
+	segmentMatrix(table, s, Mxx, Mxy, Myx, Myy);
+	float cornerX[4] = {x0, x1, x0, x1};
+	float cornerY[4] = {y0, y0, y1, y1};
+	double largest = 0;
+	for (int k = 0; k < 4; k++){
+		double relX = cornerX[k] - table.px[s];
+		double relY = cornerY[k] - table.py[s];
+		double dispX = table.ppx[s] + (Mxx * relX) + (Mxy * relY) - cornerX[k];
+		double dispY = table.ppy[s] + (Myx * relX) + (Myy * relY) - cornerY[k];
+		largest = max(largest, sqrt((dispX * dispX) + (dispY * dispY)));
+	}
+	return largest;
+}
+
+//================================================
+/*
+samePair(SegmentTable& tableA, int a, SegmentTable& tableB, int b)
+
+* PURPOSE: test whether two entries have the same destination and source segments
+* INPUTS: param -- SegmentTable& tableA, int a -- the first entry
+*         param -- SegmentTable& tableB, int b -- the second entry
+* OUTPUTS: bool, true if every end matches
+*/
+//================================================
+static bool samePair(SegmentTable& tableA, int a, SegmentTable& tableB, int b){
+	return tableA.px[a] == tableB.px[b] && tableA.py[a] == tableB.py[b] && tableA.qx[a] == tableB.qx[b]
+		&& tableA.qy[a] == tableB.qy[b] && tableA.ppx[a] == tableB.ppx[b] && tableA.ppy[a] == tableB.ppy[b]
+		&& tableA.qpx[a] == tableB.qpx[b] && tableA.qpy[a] == tableB.qpy[b];
+}
+
+//================================================
+/*
+maxDisplacementChange(SegmentTable& before, int s, SegmentTable& after, int t, float x0, float y0,
+		      float x1, float y1)
+
+* PURPOSE: largest length over the rectangle [x0, x1] x [y0, y1] of the change in the
+*          displacement of a segment pair that moved, from entry s of before to entry t of
+*          after. The change is affine in X too, so the largest is at a corner.
+* INPUTS: param -- SegmentTable& before, int s -- the pair before
+*         param -- SegmentTable& after, int t -- the pair after
+*         param -- float x0, y0, x1, y1 -- corners of the rectangle, inclusive
+* OUTPUTS: double, the length in pixels
+*/
+//================================================
+static double maxDisplacementChange(SegmentTable& before, int s, SegmentTable& after, int t, float x0, float y0,
+		float x1, float y1){
+	double Mxx, Mxy, Myx, Myy, Nxx, Nxy, Nyx, Nyy;
+	segmentMatrix(before, s, Mxx, Mxy, Myx, Myy);
+	segmentMatrix(after, t, Nxx, Nxy, Nyx, Nyy);
+	float cornerX[4] = {x0, x1, x0, x1};
+	float cornerY[4] = {y0, y0, y1, y1};
+	double largest = 0;
+	for (int k = 0; k < 4; k++){
+		double beforeX = before.ppx[s] + (Mxx * (cornerX[k] - before.px[s])) + (Mxy * (cornerY[k] - before.py[s]));
+		double beforeY = before.ppy[s] + (Myx * (cornerX[k] - before.px[s])) + (Myy * (cornerY[k] - before.py[s]));
+		double afterX = after.ppx[t] + (Nxx * (cornerX[k] - after.px[t])) + (Nxy * (cornerY[k] - after.py[t]));
+		double afterY = after.ppy[t] + (Nyx * (cornerX[k] - after.px[t])) + (Nyy * (cornerY[k] - after.py[t]));
+		largest = max(largest, sqrt(((afterX - beforeX) * (afterX - beforeX)) + ((afterY - beforeY) * (afterY - beforeY))));
+	}
+	return largest;
+}
+
+//================================================
+/*
+segmentChangeBound(SegmentTable& before, SegmentTable& after, float x0, float y0, float x1,
+		   float y1, double a, double b)
+
+* PURPOSE: bound how far the source position X' of any pixel of the rectangle [x0, x1] x
+*          [y0, y1] can move when the segment pairs of a warp change from before to after
+*          (a segment moved, added or removed). X' - X is the weighted average of the
+*          displacements d of the segments. With S the segments found unchanged in both, W
+*          their total weight and D_S their average, a segment c added or removed moves the
+*          average by at most (w_c / (W + w_c)) |d_c - D_S|. A segment that moved, from
+*          (w, d) to (w', d'), moves it by at most (w' / (W + w')) |d' - d| plus
+*          |d - D_S| |w' - w| / W, which is far smaller when the move is small; the smaller
+*          of the two bounds is taken. Over the rectangle each weight is at most its value at
+*          the nearest distance, W at least the sum of the weights at the farthest distances,
+*          |d - D_S| at most |d| plus the weighted bound of the largest |d_s|, and |w' - w|
+*          at most w times the change of its distance, which moves no more than the ends of
+*          the segment. An edit far from the rectangle, outweighed by the unchanged segments
+*          there, gives a bound of a small fraction of a pixel.
+* INPUTS: param -- SegmentTable& before, after -- segment pairs of the warp before and after
+*         param -- float x0, y0, x1, y1 -- corners of the rectangle, inclusive
+*         param -- double a, b -- weight constants, weight = (length^c / (a + dist))^b
+* OUTPUTS: double, the bound in pixels: 0 if no segment changed, HUGE_VAL if every one did
+*/
+//================================================
+double segmentChangeBound(SegmentTable& before, SegmentTable& after, float x0, float y0, float x1, float y1,
+		double a, double b){
+	unordered_map<string, int> beforeIndex; // id -> position in before and in after
+	unordered_map<string, int> afterIndex;
+	for (int s = 0; s < before.count; s++){
+		beforeIndex[before.id[s]] = s;
+	}
+	for (int s = 0; s < after.count; s++){
+		afterIndex[after.id[s]] = s;
+	}
+	vector<bool> changedBefore(before.count, true);
+	vector<bool> changedAfter(after.count, true);
+	for (int s = 0; s < before.count; s++){
+		unordered_map<string, int>::iterator found = afterIndex.find(before.id[s]);
+		if (found != afterIndex.end() && samePair(before, s, after, found->second)){
+			changedBefore[s] = false;
+			changedAfter[found->second] = false;
+		}
+	}
+
+	double unchangedWeight = 0; // W, at least
+	double largestDisplacement = 0; // largest |d_s|
+	double weightedDisplacement = 0; // sum of the largest w_s |d_s|
+	bool anyChanged = false;
+	for (int s = 0; s < before.count; s++){
+		if (changedBefore[s]){
+			anyChanged = true;
+			continue;
+		}
+		float nearest, farthest;
+		distanceRange(before, s, x0, y0, x1, y1, nearest, farthest);
+		double displacement = maxDisplacement(before, s, x0, y0, x1, y1);
+		unchangedWeight += pow(before.lengthPow[s] / (a + farthest), b);
+		largestDisplacement = max(largestDisplacement, displacement);
+		weightedDisplacement += pow(before.lengthPow[s] / (a + nearest), b) * displacement;
+	}
+	for (int s = 0; s < after.count && !anyChanged; s++){
+		anyChanged = changedAfter[s];
+	}
+	if (!anyChanged){
+		return 0;
+	}
+	if (unchangedWeight <= 0){
+		return HUGE_VAL;
+	}
+	double averageDisplacement = min(largestDisplacement, weightedDisplacement / unchangedWeight); // |D_S|, at most
+
+	// for each changed segment of before and of after: its largest weight and |d - D_S|
+	vector<double> weightBefore(before.count, 0), spreadBefore(before.count, 0);
+	vector<double> weightAfter(after.count, 0), spreadAfter(after.count, 0);
+	vector<float> nearestBefore(before.count, 0);
+	for (int s = 0; s < before.count; s++){
+		if (changedBefore[s]){
+			float farthest;
+			distanceRange(before, s, x0, y0, x1, y1, nearestBefore[s], farthest);
+			weightBefore[s] = pow(before.lengthPow[s] / (a + nearestBefore[s]), b);
+			spreadBefore[s] = maxDisplacement(before, s, x0, y0, x1, y1) + averageDisplacement;
+		}
+	}
+	for (int s = 0; s < after.count; s++){
+		if (changedAfter[s]){
+			float nearest, farthest;
+			distanceRange(after, s, x0, y0, x1, y1, nearest, farthest);
+			weightAfter[s] = pow(after.lengthPow[s] / (a + nearest), b);
+			spreadAfter[s] = maxDisplacement(after, s, x0, y0, x1, y1) + averageDisplacement;
+		}
+	}
+
+	double bound = 0;
+	for (int s = 0; s < after.count; s++){ // added or moved
+		if (!changedAfter[s]){
+			continue;
+		}
+		double share = weightAfter[s] / (unchangedWeight + weightAfter[s]);
+		double segmentBound = share * spreadAfter[s];
+		unordered_map<string, int>::iterator found = beforeIndex.find(after.id[s]);
+		if (found != beforeIndex.end()){ // moved, also removed from before
+			int r = found->second;
+			double removed = (weightBefore[r] / (unchangedWeight + weightBefore[r])) * spreadBefore[r];
+			// |w' - w| <= w ((L'^c / L^c)^b ((a + dist) / (a + dist - delta))^b - 1), with delta the
+			// largest move of an end of the destination segment and dist at least the nearest
+			float delta = max(hypot(after.px[s] - before.px[r], after.py[s] - before.py[r]),
+				hypot(after.qx[s] - before.qx[r], after.qy[s] - before.qy[r]));
+			double near = a + nearestBefore[r];
+			double moved = HUGE_VAL;
+			if (near - delta > 0){
+				double lengthRatio = pow(after.lengthPow[s] / before.lengthPow[r], b);
+				double rise = lengthRatio * pow(near / (near - delta), b) - 1;
+				double fall = 1 - lengthRatio * pow(near / (near + delta), b);
+				double weightChange = weightBefore[r] * max(rise, fall);
+				moved = (share * maxDisplacementChange(before, r, after, s, x0, y0, x1, y1))
+					+ (spreadBefore[r] * weightChange / unchangedWeight);
+			}
+			segmentBound = min(segmentBound + removed, moved);
+			changedBefore[r] = false; // counted
+		}
+		bound += segmentBound;
+	}
+	for (int s = 0; s < before.count; s++){ // removed
+		if (changedBefore[s]){
+			bound += (weightBefore[s] / (unchangedWeight + weightBefore[s])) * spreadBefore[s];
+		}
+	}
+	return bound;
+}
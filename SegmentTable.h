@@ -0,0 +1,62 @@
+// SegmentTable.h
+//
+// SegmentTable is the compiled form of the segment pairs that drive one warp, stored as a
+// structure of arrays. Each destination segment PQ is matched by id with its source segment
+// P'Q' once, when the table is built, and everything about a pair that does not depend on
+// the pixel (Q - P, the lengths, their inverses, the weight numerator ||Q - P||^c) is
+// computed then too. The pixel loops read only these flat arrays, and the vectorized warp
+// kernels load the values of a segment with a single broadcast.
+//
+// Members of the struct include:
+//  int count - number of segment pairs
+//  vector<string> id - feature id of each pair
+//  vector<float> px, py, qx, qy - start (P) and end (Q) of each destination segment
+//  vector<float> ppx, ppy, qpx, qpy - start (P') and end (Q') of each source segment
+//  vector<float> dx, dy, dpx, dpy - Q - P and Q' - P'
+//  vector<float> length, lengthSq, lengthPrime - ||Q - P||, ||Q - P||^2, ||Q' - P'||
+//  vector<double> lengthPow - ||Q - P||^c, numerator of the segment weight
+//  float foldWeight, foldX0, foldXx, foldXy, foldY0, foldYx, foldYy - segments culled from a
+//      tile, folded into one term: they add foldWeight to the sum of weights and
+//      (foldX0 + foldXx x + foldXy y, foldY0 + foldYx x + foldYy y) to the sum of weighted
+//      displacements at pixel (x, y). All zero in a table from buildSegmentTable.
+//
+#include <iostream>
+#include <vector>
+#include "Segment.h"
+using namespace std;
+
+#ifndef SEGMENTTABLE
+#define SEGMENTTABLE
+
+struct SegmentTable{
+	int count;
+	vector<string> id;
+	vector<float> px, py, qx, qy;
+	vector<float> ppx, ppy, qpx, qpy;
+	vector<float> dx, dy, dpx, dpy;
+	vector<float> length, lengthSq, lengthPrime;
+	vector<double> lengthPow;
+	float foldWeight;
+	float foldX0, foldXx, foldXy;
+	float foldY0, foldYx, foldYy;
+};
+
+// pair every destination segment with the source segment of the same id and fill the table,
+// c is the length exponent of the weights. Returns the number of destination segments that
+// had no match (they are left out of the table).
+int buildSegmentTable(SegmentTable& table, vector<Segment>& sourceSegments,
+		vector<Segment>& destSegments, double c);
+
+// fill culled with the pairs of table whose weight, (length^c / (a + dist))^b, can exceed
+// fraction of the total weight at some pixel of the rectangle [x0, x1] x [y0, y1], and fold
+// the other pairs into its fold term. Returns the number of pairs kept.
+int cullSegmentTable(SegmentTable& table, SegmentTable& culled, float x0, float y0, float x1, float y1,
+		double a, double b, double fraction);
+
+// bound in pixels how far the source position of any pixel of the rectangle [x0, x1] x [y0, y1]
+// can move when the segment pairs of a warp change from before to after (pairs matched by id).
+// 0 if no pair changed.
+double segmentChangeBound(SegmentTable& before, SegmentTable& after, float x0, float y0, float x1, float y1,
+		double a, double b);
+
+#endif
@@ -0,0 +1,239 @@
+// ThreadPool.cpp
+//
+// Class ThreadPool runs small tasks on a fixed set of worker threads, balancing the load by
+// letting idle workers steal queued tasks from busy ones. See ThreadPool.h.
+//
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include "ThreadPool.h"
+using namespace std;
+
+// pool and queue index of the current thread, set for the pool's own worker threads only
+static thread_local ThreadPool* ownerPool = NULL;
+static thread_local int ownerIndex = 0;
+
+//================================================
+/*
+ThreadPool(int numThreads)
+
+* PURPOSE: variable constructor, start the worker threads
+* INPUTS: param -- int numThreads -- total threads running tasks, including the thread that
+*                  calls parallelFor(). Values <= 0 use the number of cores on the machine.
+* OUTPUTS : none
+*/
+//================================================
+ThreadPool::ThreadPool(int numThreads){
+	if (numThreads <= 0){
+		numThreads = thread::hardware_concurrency();
+	}
+	if (numThreads <= 0){ // hardware_concurrency() may not know
+		numThreads = 1;
+	}
+	pendingTasks = 0;
+	nextQueue = 0;
+	stopping = false;
+
+	for (int i = 0; i < numThreads; i++){
+		queues.push_back(new WorkQueue);
+	}
+	// queue 0 belongs to outside threads, workers own queues 1 ... numThreads - 1
+	for (int i = 1; i < numThreads; i++){
+		workers.push_back(thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+//================================================
+/*
+~ThreadPool()
+
+* PURPOSE: destructor, let the workers finish queued tasks then join them
+* INPUTS: none
+* OUTPUTS : none
+*/
+//================================================
+ThreadPool::~ThreadPool(void){
+	{
+		lock_guard<mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (int i = 0; i < workers.size(); i++){
+		workers[i].join();
+	}
+	for (int i = 0; i < queues.size(); i++){
+		delete queues[i];
+	}
+}
+
+//================================================
+int ThreadPool::getNumThreads(void){
+	return queues.size();
+}
+
+//================================================
+/*
+currentQueue()
+
+* PURPOSE: find the queue the calling thread should push to and pop from
+* INPUTS: none
+* OUTPUTS: int, the worker's own queue, or 0 for threads outside of this pool
+*/
+//================================================
+int ThreadPool::currentQueue(void){
+	if (ownerPool == this){
+		return ownerIndex;
+	}
+	return 0;
+}
+
+//================================================
+/*
+pushTask(int queueIndex, function<void()> task), popTask(int queueIndex, function<void()>& task)
+
+* PURPOSE: add a task to the back of a queue / take a task for the thread owning queueIndex.
+*          The owner takes the newest task of its own queue (its data is most likely still in
+*          cache), otherwise it steals the oldest task of the next non-empty queue.
+* INPUTS: param -- int queueIndex -- queue of the calling thread
+*         param -- task -- task to push, or set to the popped task
+* OUTPUTS: popTask returns false if every queue was empty
+*/
+//================================================
+void ThreadPool::pushTask(int queueIndex, function<void()> task){
+	WorkQueue* queue = queues[queueIndex];
+	{
+		lock_guard<mutex> guard(queue->lock);
+		queue->tasks.push_back(task);
+	}
+	pendingTasks++;
+}
+
+bool ThreadPool::popTask(int queueIndex, function<void()>& task){
+	int numQueues = queues.size();
+	for (int i = 0; i < numQueues; i++){
+		WorkQueue* queue = queues[(queueIndex + i) % numQueues];
+		lock_guard<mutex> guard(queue->lock);
+		if (!queue->tasks.empty()){
+			if (i == 0){ // own queue
+				task = queue->tasks.back();
+				queue->tasks.pop_back();
+			}
+			else{ // steal
+				task = queue->tasks.front();
+				queue->tasks.pop_front();
+			}
+			pendingTasks--;
+			return true;
+		}
+	}
+	return false;
+}
+
+//================================================
+/*
+wakeWorkers()
+
+* PURPOSE: wake sleeping workers after tasks were pushed. Taking sleepLock first means a
+*          worker is either already waiting (and gets the notify) or has not yet checked
+*          pendingTasks (and will see the new tasks), so no wake up is lost.
+* INPUTS: none
+* OUTPUTS: none
+*/
+//================================================
+void ThreadPool::wakeWorkers(void){
+	{
+		lock_guard<mutex> guard(sleepLock);
+	}
+	wakeUp.notify_all();
+}
+
+//================================================
+/*
+workerLoop(int index)
+
+* PURPOSE: body of each worker thread, run tasks until the pool is destroyed
+* INPUTS: param -- int index -- queue owned by this worker
+* OUTPUTS: none
+*/
+//================================================
+void ThreadPool::workerLoop(int index){
+	ownerPool = this;
+	ownerIndex = index;
+	while (true){
+		function<void()> task;
+		if (popTask(index, task)){
+			task();
+			continue;
+		}
+		unique_lock<mutex> guard(sleepLock);
+		wakeUp.wait(guard, [this]{ return stopping || pendingTasks > 0; });
+		if (stopping && pendingTasks == 0){
+			return;
+		}
+	}
+}
+
+//================================================
+/*
+submit(function<void()> task)
+
+* PURPOSE: queue one task to run on some thread of the pool, does not wait for it
+* INPUTS: param -- function<void()> task -- the work to run
+* OUTPUTS: none
+*/
+//================================================
+void ThreadPool::submit(function<void()> task){
+	int queueIndex = currentQueue();
+	if (queueIndex == 0){ // spread outside work over the workers
+		queueIndex = nextQueue++ % queues.size();
+	}
+	pushTask(queueIndex, task);
+	wakeWorkers();
+}
+
+//================================================
+/*
+parallelFor(int numTasks, function<void(int)> task)
+
+* PURPOSE: run task(i) for every i in [0, numTasks) and wait until all of them are done.
+*          Tasks are dealt round-robin over the queues so every worker starts with a share,
+*          and the calling thread runs tasks (its own or stolen) while it waits.
+* INPUTS: param -- int numTasks -- number of tasks
+*         param -- function<void(int)> task -- work for one task index
+* OUTPUTS: none
+*/
+//================================================
+void ThreadPool::parallelFor(int numTasks, function<void(int)> task){
+	if (numTasks <= 0){
+		return;
+	}
+	if (queues.size() == 1){ // nothing to share the work with
+		for (int i = 0; i < numTasks; i++){
+			task(i);
+		}
+		return;
+	}
+
+	atomic<int> remaining(numTasks);
+	int numQueues = queues.size();
+	int firstQueue = currentQueue();
+	for (int i = 0; i < numTasks; i++){
+		pushTask((firstQueue + i) % numQueues, [&task, &remaining, i]{
+			task(i);
+			remaining--;
+		});
+	}
+	wakeWorkers();
+
+	int myQueue = currentQueue();
+	while (remaining > 0){
+		function<void()> next;
+		if (popTask(myQueue, next)){
+			next();
+		}
+		else{ // the last tasks are running on other threads
+			this_thread::yield();
+		}
+	}
+}
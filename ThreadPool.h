@@ -0,0 +1,63 @@
+// ThreadPool.h
+//
+// Class ThreadPool runs small tasks on a fixed set of worker threads. Every worker owns a
+// queue of tasks: it takes work from the back of its own queue and, when that is empty,
+// steals from the front of the other workers' queues, so that uneven tasks (tiles near
+// many segments, frames of different cost) still keep all cores busy.
+//
+// A thread that waits in parallelFor() keeps running queued tasks until its own tasks are
+// done, so a task may itself call parallelFor() without deadlocking the pool.
+//
+// Members of the class include:
+//  vector<thread> workers - the worker threads, one fewer than the thread count since the
+//                           calling thread also runs tasks while it waits
+//  vector<WorkQueue*> queues - one task queue per thread, queue 0 is shared by threads that
+//                              are not part of the pool (i.e. the main thread)
+//  atomic<int> pendingTasks - number of tasks queued but not yet started
+//
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+using namespace std;
+
+#ifndef THREADPOOL
+#define THREADPOOL
+
+class ThreadPool{
+	private:
+		struct WorkQueue{
+			mutex lock;
+			deque< function<void()> > tasks;
+		};
+		vector<thread> workers;
+		vector<WorkQueue*> queues;
+		mutex sleepLock; // guards sleeping workers, see submit()
+		condition_variable wakeUp;
+		atomic<int> pendingTasks;
+		atomic<unsigned int> nextQueue; // round-robin queue for tasks submitted from outside the pool
+		bool stopping;
+
+		void workerLoop(int index);
+		int currentQueue(void);
+		void pushTask(int queueIndex, function<void()> task);
+		bool popTask(int queueIndex, function<void()>& task);
+		void wakeWorkers(void);
+	public:
+		// constructor -- numThreads <= 0 uses one thread per core
+		ThreadPool(int numThreads);
+		~ThreadPool(void);
+
+		int getNumThreads(void);
+
+		// queue a single task, returns immediately
+		void submit(function<void()> task);
+		// run task(0) ... task(numTasks - 1) across the pool and return once all have finished
+		void parallelFor(int numTasks, function<void(int)> task);
+};
+
+#endif
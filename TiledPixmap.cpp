@@ -0,0 +1,97 @@
+// TiledPixmap.cpp
+//
+// Tiled copy of a Pixmap for the gathers of the warp. See TiledPixmap.h.
+//
+
+#include <iostream>
+#include <cstring>
+#include "TiledPixmap.h"
+#include "Pixel.h"
+#include "Pixmap.h"
+#include "PixelPool.h"
+using namespace std;
+
+//================================================
+/*
+TiledPixmap()
+
+* PURPOSE: default constructor, an empty image
+* INPUTS: none
+* OUTPUTS: none
+*/
+//================================================
+TiledPixmap::TiledPixmap(void){
+	width = 0;
+	height = 0;
+	tilesAcross = 0;
+	paddedPixels = 0;
+	dataPointer = NULL;
+}
+
+//================================================
+/*
+TiledPixmap(Pixmap& image)
+
+* PURPOSE: copy the pixels of image into tiles, a row of a tile at a time. The pixels of the
+*          tiles that stick out past the right and bottom edges are left as they are (the warp
+*          only reads positions inside the image).
+* INPUTS: param -- Pixmap& image -- image to copy
+* OUTPUTS: none
+*/
+//================================================
+TiledPixmap::TiledPixmap(Pixmap& image){
+	width = image.getWidth();
+	height = image.getHeight();
+	tilesAcross = (width + SOURCE_TILE_SIZE - 1) / SOURCE_TILE_SIZE;
+	int tilesDown = (height + SOURCE_TILE_SIZE - 1) / SOURCE_TILE_SIZE;
+	paddedPixels = tilesAcross * tilesDown * SOURCE_TILE_SIZE * SOURCE_TILE_SIZE;
+	dataPointer = acquirePixels(paddedPixels);
+
+	Pixel** rows = image.getPmPointer();
+	for (int y = 0; y < height; y++){
+		for (int x = 0; x < width; x += SOURCE_TILE_SIZE){
+			int count = min(SOURCE_TILE_SIZE, width - x);
+			memcpy(&at(x, y), &rows[y][x], count * sizeof(Pixel));
+		}
+	}
+}
+
+TiledPixmap::~TiledPixmap(void){
+	releasePixels(dataPointer, paddedPixels);
+}
+
+//================================================
+/*
+TiledPixmap(TiledPixmap&& other), operator=(TiledPixmap&& other)
+
+* PURPOSE: move constructor and assignment, take over the tiles of other, which is left with no
+*          size. Assignment first returns the tiles this TiledPixmap held.
+* INPUTS: param -- TiledPixmap&& other -- TiledPixmap being moved
+* OUTPUTS: none / this TiledPixmap
+*/
+//================================================
+TiledPixmap::TiledPixmap(TiledPixmap&& other){
+	width = 0;
+	height = 0;
+	tilesAcross = 0;
+	paddedPixels = 0;
+	dataPointer = NULL;
+	*this = move(other);
+}
+
+TiledPixmap& TiledPixmap::operator=(TiledPixmap&& other){
+	if (this != &other){
+		releasePixels(dataPointer, paddedPixels);
+		width = other.width;
+		height = other.height;
+		tilesAcross = other.tilesAcross;
+		paddedPixels = other.paddedPixels;
+		dataPointer = other.dataPointer;
+		other.width = 0;
+		other.height = 0;
+		other.tilesAcross = 0;
+		other.paddedPixels = 0;
+		other.dataPointer = NULL;
+	}
+	return *this;
+}
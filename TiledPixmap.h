@@ -0,0 +1,66 @@
+// TiledPixmap.h
+//
+// Class TiledPixmap is a read-only copy of a Pixmap laid out in square tiles of
+// SOURCE_TILE_SIZE x SOURCE_TILE_SIZE pixels, each stored contiguously (row-major within the
+// tile, tiles row-major across the image). A 32 x 32 tile of RGBA pixels is 4 KB, one memory
+// page.
+//
+// The warp reads its source at scattered positions X' (see Warp.h). In a Pixmap, where every
+// row is a separate stretch of memory, the X' of one output tile that cross many source rows
+// (near strongly rotated segments, a column of the output maps to a row of the source) touch a
+// different cache line and page for each row; at 4K a row is 15 KB, so every step down is a
+// new page. In a TiledPixmap the same positions fall in a few pages, so the gathers stay in the
+// cache and the TLB. Used by the warp when warpSettings.tiledSources is set.
+//
+// Members of the class include:
+//  int width, height - size of the image
+//  int tilesAcross - tiles in a row of tiles (the width rounded up to whole tiles)
+//  int paddedPixels - pixels allocated, whole tiles
+//  Pixel* dataPointer - the tiles, from the pixel pool
+//
+#include <iostream>
+#include "Pixel.h"
+#include "Pixmap.h"
+using namespace std;
+
+#ifndef TILEDPIXMAP
+#define TILEDPIXMAP
+
+#define SOURCE_TILE_SHIFT 5
+#define SOURCE_TILE_SIZE (1 << SOURCE_TILE_SHIFT) // 32 pixels
+
+class TiledPixmap{
+	private:
+		int width;
+		int height;
+		int tilesAcross;
+		int paddedPixels;
+		Pixel* dataPointer;
+	public:
+		// constructors -- empty, and a tiled copy of the pixels of image
+		TiledPixmap(void);
+		TiledPixmap(Pixmap& image);
+		~TiledPixmap(void);
+
+		// move the tiles of other into this TiledPixmap, other is left empty (0 x 0)
+		TiledPixmap(TiledPixmap&& other);
+		TiledPixmap& operator=(TiledPixmap&& other);
+		TiledPixmap(const TiledPixmap& other) = delete;
+		TiledPixmap& operator=(const TiledPixmap& other) = delete;
+
+		int getWidth(void){
+			return width;
+		}
+		int getHeight(void){
+			return height;
+		}
+		// pixel in column x, row y (inside the image), inline since the warp reads one per
+		// output pixel
+		Pixel& at(int x, int y){
+			int tile = (y >> SOURCE_TILE_SHIFT) * tilesAcross + (x >> SOURCE_TILE_SHIFT);
+			int inTile = ((y & (SOURCE_TILE_SIZE - 1)) << SOURCE_TILE_SHIFT) + (x & (SOURCE_TILE_SIZE - 1));
+			return dataPointer[(tile << (2 * SOURCE_TILE_SHIFT)) + inTile];
+		}
+};
+
+#endif
@@ -0,0 +1,234 @@
+// Trace.cpp
+//
+// Timing of the stages of the program, written as Chrome trace-event JSON. See Trace.h.
+//
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "Trace.h"
+#include "PixelPool.h"
+using namespace std;
+
+#ifndef MORPHER_NO_TRACE
+bool tracingEnabled = false;
+#endif
+
+// one finished scope
+struct TraceEvent{
+	const char* name;
+	int thread; // small number of the thread, in the order threads first record a scope
+	double start; // microseconds since tracing started
+	double duration; // microseconds
+	long pixels;
+	long segments;
+	long bytes; // pixel memory allocated during the scope
+	long bytesInUse; // pixel memory in use when the scope ended
+};
+
+// every member is guarded by traceLock
+static mutex traceLock;
+static vector<TraceEvent> traceEvents;
+static string traceFilename;
+static chrono::steady_clock::time_point traceStart;
+
+static atomic<int> nextThread(0);
+
+//================================================
+/*
+threadNumber()
+
+* PURPOSE: small number identifying the calling thread in the trace, 0 for the first thread that
+*          records a scope (the main thread), 1, 2 ... for the workers in the order they start
+* INPUTS: none
+* OUTPUTS: int, the number
+*/
+//================================================
+static int threadNumber(void){
+	thread_local int number = nextThread++;
+	return number;
+}
+
+//================================================
+/*
+microseconds()
+
+* PURPOSE: time since tracing started
+* INPUTS: none
+* OUTPUTS: double, microseconds
+*/
+//================================================
+static double microseconds(void){
+	return chrono::duration<double, micro>(chrono::steady_clock::now() - traceStart).count();
+}
+
+//================================================
+/*
+begin(), end()
+
+* PURPOSE: start the scope, record it when it ends. Only called while tracing is on (begin) and
+*          for scopes that began (end), so a disabled trace never gets here.
+* INPUTS: none
+* OUTPUTS: none
+*/
+//================================================
+void TraceScope::begin(void){
+	active = true;
+	startBytes = getBytesAllocated();
+	start = microseconds();
+}
+
+void TraceScope::end(void){
+	TraceEvent event;
+	event.name = name;
+	event.thread = threadNumber();
+	event.start = start;
+	event.duration = microseconds() - start;
+	event.pixels = pixels;
+	event.segments = segments;
+	event.bytes = getBytesAllocated() - startBytes;
+	event.bytesInUse = getPoolReport().bytesInUse;
+	lock_guard<mutex> guard(traceLock);
+	if (tracingEnabled){
+		traceEvents.push_back(event);
+	}
+}
+
+//================================================
+/*
+writeTraceFile(string filename)
+
+* PURPOSE: write the events as Chrome trace JSON: a complete ("X") event per scope with its work
+*          in args, and a counter ("C") event of the pixel memory in use when it ended. The
+*          caller holds traceLock.
+* INPUTS: param -- string filename -- file to write
+* OUTPUTS: bool, false if the file could not be written
+*/
+//================================================
+static bool writeTraceFile(string filename){
+	FILE* file = fopen(filename.c_str(), "w");
+	if (file == NULL){
+		return false;
+	}
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"morpher\"}}");
+	for (int i = 0; i < traceEvents.size(); i++){
+		TraceEvent& e = traceEvents[i];
+		fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, "
+			"\"args\": {\"pixels\": %ld, \"segments\": %ld, \"bytes_allocated\": %ld}}",
+			e.name, e.thread, e.start, e.duration, e.pixels, e.segments, e.bytes);
+		fprintf(file, ",\n{\"name\": \"pixel memory\", \"ph\": \"C\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, "
+			"\"args\": {\"bytes_in_use\": %ld}}", e.thread, e.start + e.duration, e.bytesInUse);
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
+
+//================================================
+/*
+printTraceTable(ostream& out)
+
+* PURPOSE: print the scopes summed by name, in the order each name first ended: count, total,
+*          mean and longest time, the work done and the rate. The caller holds traceLock.
+* INPUTS: param -- ostream& out -- where to print
+* OUTPUTS: none
+*/
+//================================================
+static void printTraceTable(ostream& out){
+	struct Total{
+		long count, pixels, segments, bytes;
+		double duration, longest;
+	};
+	vector<const char*> names;
+	map<string, Total> totals;
+	for (int i = 0; i < traceEvents.size(); i++){
+		TraceEvent& e = traceEvents[i];
+		if (totals.count(e.name) == 0){
+			Total zero = {0, 0, 0, 0, 0, 0};
+			totals[e.name] = zero;
+			names.push_back(e.name);
+		}
+		Total& t = totals[e.name];
+		t.count += 1;
+		t.pixels += e.pixels;
+		t.segments += e.segments;
+		t.bytes += e.bytes;
+		t.duration += e.duration;
+		t.longest = max(t.longest, e.duration);
+	}
+	char line[256];
+	snprintf(line, sizeof(line), "%-20s %6s %11s %10s %10s %12s %9s %10s %10s", "stage", "count", "total ms",
+		"mean ms", "max ms", "pixels", "segments", "alloc MB", "Mpixel/s");
+	out << line << endl;
+	for (int i = 0; i < names.size(); i++){
+		Total& t = totals[names[i]];
+		double rate = (t.duration > 0) ? t.pixels / t.duration : 0; // pixels per microsecond
+		snprintf(line, sizeof(line), "%-20s %6ld %11.2f %10.3f %10.3f %12ld %9ld %10.1f %10.1f", names[i], t.count,
+			t.duration / 1000, t.duration / 1000 / t.count, t.longest / 1000, t.pixels, t.segments,
+			t.bytes / (1024.0 * 1024.0), rate);
+		out << line << endl;
+	}
+}
+
+//================================================
+/*
+startTracing(string filename)
+
+* PURPOSE: turn tracing on, the trace is written to filename when the program exits
+* INPUTS: param -- string filename -- file the Chrome trace JSON is written to
+* OUTPUTS: bool, false if the file cannot be created or tracing is compiled out
+*/
+//================================================
+bool startTracing(string filename){
+#ifdef MORPHER_NO_TRACE
+	cerr << "Tracing was left out of this build (MORPHER_NO_TRACE)." << endl;
+	return false;
+#else
+	FILE* file = fopen(filename.c_str(), "w"); // fail now rather than after the render
+	if (file == NULL){
+		return false;
+	}
+	fclose(file);
+	lock_guard<mutex> guard(traceLock);
+	if (traceFilename == ""){
+		atexit(finishTracing);
+	}
+	traceFilename = filename;
+	traceEvents.clear();
+	traceStart = chrono::steady_clock::now();
+	tracingEnabled = true;
+	return true;
+#endif
+}
+
+//================================================
+/*
+finishTracing()
+
+* PURPOSE: stop tracing, write the trace file and print the table on standard error (standard
+*          output may be carrying a video stream). Does nothing if tracing is off.
+* INPUTS: none
+* OUTPUTS: none
+*/
+//================================================
+void finishTracing(void){
+#ifndef MORPHER_NO_TRACE
+	lock_guard<mutex> guard(traceLock);
+	if (!tracingEnabled){
+		return;
+	}
+	tracingEnabled = false;
+	if (!writeTraceFile(traceFilename)){
+		cerr << "Could not write trace " << traceFilename << endl;
+	}
+	cerr << "Trace of " << traceEvents.size() << " scopes written to " << traceFilename << endl;
+	printTraceTable(cerr);
+#endif
+}
@@ -0,0 +1,77 @@
+// Trace.h
+//
+// Timing of the stages of the program (decode, segment parsing, interpolation, warp, encode ...)
+// for finding where the time of a slow render goes. A TraceScope declared at the top of a block
+// records when the block starts and ends, on which thread, the pixels and segments it processed
+// and the pixel memory allocated while it ran (see getBytesAllocated). The recorded scopes are
+// written as Chrome trace-event JSON (load it in chrome://tracing or ui.perfetto.dev), each scope
+// a bar on the line of its thread, with a counter of the pixel memory in use, and summed by
+// name in a table on standard error.
+//
+// Tracing is off unless startTracing() is called ("-trace file.json"); a scope then costs one
+// test of tracingEnabled. Built with -DMORPHER_NO_TRACE, tracingEnabled is the constant false
+// and the scopes compile to nothing.
+//
+// Members of class TraceScope include:
+//  const char* name - name of the stage, a string literal
+//  long pixels, segments - work done by the scope, shown in the trace and the table
+//  long startBytes - getBytesAllocated() when the scope started
+//  double start - microseconds since tracing started when the scope started
+//  bool active - tracing was on when the scope started
+//
+#include <iostream>
+#include <string>
+using namespace std;
+
+#ifndef TRACE
+#define TRACE
+
+#ifdef MORPHER_NO_TRACE
+const bool tracingEnabled = false;
+#else
+extern bool tracingEnabled; // set by startTracing
+#endif
+
+class TraceScope{
+	private:
+		const char* name;
+		long pixels;
+		long segments;
+		long startBytes;
+		double start;
+		bool active;
+
+		void begin(void);
+		void end(void);
+	public:
+		// constructor -- starts timing name (a string literal), the work may be given now or
+		// added as it is done
+		TraceScope(const char* name, long pixels = 0, long segments = 0) :
+			name(name), pixels(pixels), segments(segments), active(false){
+			if (tracingEnabled){
+				begin();
+			}
+		}
+		// destructor -- records the scope
+		~TraceScope(void){
+			if (active){
+				end();
+			}
+		}
+
+		void addPixels(long count){
+			pixels += count;
+		}
+		void addSegments(long count){
+			segments += count;
+		}
+};
+
+// start recording scopes, written to filename (Chrome trace JSON) with the table on standard
+// error when the program exits. Returns false if the file cannot be written.
+bool startTracing(string filename);
+
+// write the trace and the table now (called at exit by startTracing), recording stops
+void finishTracing(void);
+
+#endif
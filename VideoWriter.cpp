@@ -0,0 +1,404 @@
+// VideoWriter.cpp
+//
+// Streams frames as YUV4MPEG2 or raw RGBA video. See VideoWriter.h.
+//
+
+#include <iostream>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include "VideoWriter.h"
+#include "Pixmap.h"
+#include "Pixel.h"
+#include "WarpSimd.h"
+using namespace std;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  include <immintrin.h>
+#  define MORPHER_X86_SIMD
+#endif
+
+// BT.601 studio range conversion in 8.8 fixed point, from the unscaled sums
+//   Y  = 16  + (( 66 R + 129 G +  25 B + 128) >> 8)
+//   Cb = 128 + ((-38 R -  74 G + 112 B + 128) >> 8)
+//   Cr = 128 + ((112 R -  94 G -  18 B + 128) >> 8)
+// A 4:2:0 chroma sample adds the unscaled sums of its 2x2 pixels and shifts by 10 instead.
+
+//================================================
+/*
+convertRowScalar(unsigned char* rgba0, unsigned char* rgba1, int colStart, int width,
+		 unsigned char* y0, unsigned char* y1, unsigned char* cb, unsigned char* cr)
+
+* PURPOSE: convert pixels colStart ... width - 1 of one row (rgba1 == NULL, 4:4:4) or of two
+*          rows (4:2:0) of RGBA pixels to YCbCr. For 4:2:0, colStart is even and each chroma
+*          sample covers 2x2 pixels; a last odd column is paired with itself.
+* INPUTS: param -- unsigned char* rgba0, rgba1 -- RGBA pixels of the row(s), rgba1 may be NULL
+*         param -- int colStart, width -- first pixel to convert, pixels in a row
+*         param -- unsigned char* y0, y1 -- luma of the row(s)
+*         param -- unsigned char* cb, cr -- chroma, one value per pixel (4:4:4) or per pair
+*                  of columns (4:2:0)
+* OUTPUTS: none
+*/
+//================================================
+static void convertRowScalar(unsigned char* rgba0, unsigned char* rgba1, int colStart, int width,
+		unsigned char* y0, unsigned char* y1, unsigned char* cb, unsigned char* cr){
+	if (rgba1 == NULL){
+		for (int x = colStart; x < width; x++){
+			int r = rgba0[4 * x];
+			int g = rgba0[4 * x + 1];
+			int b = rgba0[4 * x + 2];
+			y0[x] = 16 + (((66 * r) + (129 * g) + (25 * b) + 128) >> 8);
+			cb[x] = 128 + ((((-38) * r) - (74 * g) + (112 * b) + 128) >> 8);
+			cr[x] = 128 + (((112 * r) - (94 * g) - (18 * b) + 128) >> 8);
+		}
+		return;
+	}
+
+	for (int x = colStart; x < width; x += 2){
+		int sumCb = 0;
+		int sumCr = 0;
+		for (int k = 0; k < 4; k++){
+			unsigned char* rgba = (k < 2) ? rgba0 : rgba1;
+			unsigned char* luma = (k < 2) ? y0 : y1;
+			int col = (x + (k % 2) < width) ? x + (k % 2) : x; // repeat a last odd column
+			int r = rgba[4 * col];
+			int g = rgba[4 * col + 1];
+			int b = rgba[4 * col + 2];
+			luma[col] = 16 + (((66 * r) + (129 * g) + (25 * b) + 128) >> 8);
+			sumCb += ((-38) * r) - (74 * g) + (112 * b);
+			sumCr += (112 * r) - (94 * g) - (18 * b);
+		}
+		cb[x / 2] = 128 + ((sumCb + 512) >> 10);
+		cr[x / 2] = 128 + ((sumCr + 512) >> 10);
+	}
+}
+
+#ifdef MORPHER_X86_SIMD
+
+// 32 bit constant holding the 16 bit coefficients of a (low, high) pair, for _mm256_madd_epi16
+static inline int coefficientPair(int low, int high){
+	return int(((unsigned int)(high & 0xFFFF) << 16) | (unsigned int)(low & 0xFFFF));
+}
+
+//================================================
+/*
+unscaledAvx2(__m256i pixels, __m256i& luma, __m256i& blue, __m256i& red)
+
+* PURPOSE: unscaled Y, Cb and Cr sums (before the rounding and the shift) of 8 RGBA pixels.
+*          Masking the pixels gives the 16 bit pairs (R, B) and (G, A), and one multiply-add
+*          per pair and per output does the three products of a sum.
+* INPUTS: param -- __m256i pixels -- 8 RGBA pixels
+*         param -- __m256i& luma, blue, red -- set to the 8 sums, 32 bit each
+* OUTPUTS: none
+*/
+//================================================
+__attribute__((target("avx2")))
+static inline void unscaledAvx2(__m256i pixels, __m256i& luma, __m256i& blue, __m256i& red){
+	const __m256i lowBytes = _mm256_set1_epi32(0x00FF00FF);
+	__m256i rb = _mm256_and_si256(pixels, lowBytes); // R in the low 16 bits, B in the high
+	__m256i ga = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), lowBytes); // G low, A high
+	luma = _mm256_add_epi32(_mm256_madd_epi16(rb, _mm256_set1_epi32(coefficientPair(66, 25))),
+			_mm256_madd_epi16(ga, _mm256_set1_epi32(coefficientPair(129, 0))));
+	blue = _mm256_add_epi32(_mm256_madd_epi16(rb, _mm256_set1_epi32(coefficientPair(-38, 112))),
+			_mm256_madd_epi16(ga, _mm256_set1_epi32(coefficientPair(-74, 0))));
+	red = _mm256_add_epi32(_mm256_madd_epi16(rb, _mm256_set1_epi32(coefficientPair(112, -18))),
+			_mm256_madd_epi16(ga, _mm256_set1_epi32(coefficientPair(-94, 0))));
+}
+
+//================================================
+/*
+packBytesAvx2(__m256i low, __m256i high)
+
+* PURPOSE: pack two vectors of 8 values in 0 - 255 (32 bit each) into 16 bytes, in order
+* INPUTS: param -- __m256i low, high -- values 0 - 7 and 8 - 15
+* OUTPUTS: __m128i, the 16 bytes
+*/
+//================================================
+__attribute__((target("avx2")))
+static inline __m128i packBytesAvx2(__m256i low, __m256i high){
+	__m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+	__m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0xD8);
+	return _mm256_castsi256_si128(bytes);
+}
+
+//================================================
+/*
+convertRowAvx2(unsigned char* rgba0, unsigned char* rgba1, int width,
+	       unsigned char* y0, unsigned char* y1, unsigned char* cb, unsigned char* cr)
+
+* PURPOSE: same as convertRowScalar, 16 pixels of each row at a time
+* INPUTS: see convertRowScalar
+* OUTPUTS: int, number of pixels converted from the start of the row (a multiple of 16), the
+*          caller converts the rest with convertRowScalar
+*/
+//================================================
+__attribute__((target("avx2")))
+static int convertRowAvx2(unsigned char* rgba0, unsigned char* rgba1, int width,
+		unsigned char* y0, unsigned char* y1, unsigned char* cb, unsigned char* cr){
+	const __m256i lumaRound = _mm256_set1_epi32(128);
+	const __m256i lumaOffset = _mm256_set1_epi32(16);
+	const __m256i chromaOffset = _mm256_set1_epi32(128);
+	const __m256i chromaRound420 = _mm256_set1_epi32(512);
+	// hadd leaves the pairs of two vectors interleaved by 128 bit lane, this puts them in order
+	const __m256i pairOrder = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+	int x = 0;
+	for (; x + 16 <= width; x += 16){
+		__m256i luma[2][2], blue[2][2], red[2][2]; // [row][first or second 8 pixels]
+		int rows = (rgba1 == NULL) ? 1 : 2;
+		for (int r = 0; r < rows; r++){
+			unsigned char* rgba = (r == 0) ? rgba0 : rgba1;
+			unsigned char* lumaOut = (r == 0) ? y0 : y1;
+			for (int h = 0; h < 2; h++){
+				__m256i pixels = _mm256_loadu_si256((__m256i*)(rgba + 4 * (x + 8 * h)));
+				unscaledAvx2(pixels, luma[r][h], blue[r][h], red[r][h]);
+			}
+			__m256i lumaLow = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(luma[r][0], lumaRound), 8), lumaOffset);
+			__m256i lumaHigh = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(luma[r][1], lumaRound), 8), lumaOffset);
+			_mm_storeu_si128((__m128i*)(lumaOut + x), packBytesAvx2(lumaLow, lumaHigh));
+		}
+
+		if (rgba1 == NULL){ // 4:4:4, one chroma sample per pixel
+			__m256i chroma[2][2];
+			for (int h = 0; h < 2; h++){
+				chroma[0][h] = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(blue[0][h], lumaRound), 8), chromaOffset);
+				chroma[1][h] = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(red[0][h], lumaRound), 8), chromaOffset);
+			}
+			_mm_storeu_si128((__m128i*)(cb + x), packBytesAvx2(chroma[0][0], chroma[0][1]));
+			_mm_storeu_si128((__m128i*)(cr + x), packBytesAvx2(chroma[1][0], chroma[1][1]));
+		}
+		else{ // 4:2:0, add the two rows then neighbouring columns, 8 samples for 16 pixels
+			__m256i sumBlue = _mm256_hadd_epi32(_mm256_add_epi32(blue[0][0], blue[1][0]), _mm256_add_epi32(blue[0][1], blue[1][1]));
+			__m256i sumRed = _mm256_hadd_epi32(_mm256_add_epi32(red[0][0], red[1][0]), _mm256_add_epi32(red[0][1], red[1][1]));
+			sumBlue = _mm256_permutevar8x32_epi32(sumBlue, pairOrder);
+			sumRed = _mm256_permutevar8x32_epi32(sumRed, pairOrder);
+			__m256i chromaBlue = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(sumBlue, chromaRound420), 10), chromaOffset);
+			__m256i chromaRed = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(sumRed, chromaRound420), 10), chromaOffset);
+			__m128i bytes = packBytesAvx2(chromaBlue, chromaRed); // 8 Cb then 8 Cr
+			_mm_storel_epi64((__m128i*)(cb + x / 2), bytes);
+			_mm_storel_epi64((__m128i*)(cr + x / 2), _mm_srli_si128(bytes, 8));
+		}
+	}
+	return x;
+}
+
+#endif
+
+//================================================
+/*
+convertRow(unsigned char* rgba0, unsigned char* rgba1, int width,
+	   unsigned char* y0, unsigned char* y1, unsigned char* cb, unsigned char* cr)
+
+* PURPOSE: convert one row (4:4:4) or two rows (4:2:0) of RGBA pixels to YCbCr, with the AVX2
+*          conversion where the processor supports it and the scalar one for the rest
+* INPUTS: see convertRowScalar
+* OUTPUTS: none
+*/
+//================================================
+static void convertRow(unsigned char* rgba0, unsigned char* rgba1, int width,
+		unsigned char* y0, unsigned char* y1, unsigned char* cb, unsigned char* cr){
+	int done = 0;
+#ifdef MORPHER_X86_SIMD
+	if (simdWidthAvailable() >= 8){
+		done = convertRowAvx2(rgba0, rgba1, width, y0, y1, cb, cr);
+	}
+#endif
+	convertRowScalar(rgba0, rgba1, done, width, y0, y1, cb, cr);
+}
+
+//================================================
+/*
+VideoWriter(), ~VideoWriter()
+
+* PURPOSE: default constructor, nothing open; destructor, closes the stream if still open
+* INPUTS: none
+* OUTPUTS: none
+*/
+//================================================
+VideoWriter::VideoWriter(void){
+	file = NULL;
+	ownsFile = false;
+	format = VIDEO_Y4M_420;
+	fps = 30;
+	width = 0;
+	height = 0;
+}
+
+VideoWriter::~VideoWriter(void){
+	close();
+}
+
+//================================================
+/*
+open(string filename, int format, int fps)
+
+* PURPOSE: start a video stream. The YUV4MPEG2 header is written with the first frame, once
+*          the size of the frames is known.
+* INPUTS: param -- string filename -- file to write, "-" for standard output
+*         param -- int format -- VIDEO_Y4M_420, VIDEO_Y4M_444 or VIDEO_RGBA
+*         param -- int fps -- frames per second, stored in the YUV4MPEG2 header
+* OUTPUTS: bool, false if the file could not be opened
+*/
+//================================================
+bool VideoWriter::open(string filename, int format, int fps){
+	close();
+	if (filename == "-"){
+		file = stdout;
+		ownsFile = false;
+	}
+	else{
+		file = fopen(filename.c_str(), "wb");
+		ownsFile = true;
+		if (file == NULL){
+			cerr << "Could not open " << filename << " for writing" << endl;
+			return false;
+		}
+	}
+	this->format = format;
+	this->fps = fps;
+	width = 0;
+	height = 0;
+	return true;
+}
+
+//================================================
+/*
+open(FILE* stream, int format, int fps)
+
+* PURPOSE: start a video stream on a file the caller opened and closes (the morph server streams
+*          frames to its clients this way)
+* INPUTS: param -- FILE* stream -- open for writing
+*         see open(string, int, int) for the others
+* OUTPUTS: bool, false if stream is NULL
+*/
+//================================================
+bool VideoWriter::open(FILE* stream, int format, int fps){
+	close();
+	file = stream;
+	ownsFile = false;
+	this->format = format;
+	this->fps = fps;
+	width = 0;
+	height = 0;
+	return file != NULL;
+}
+
+//================================================
+/*
+writeFrame(Pixmap& frame)
+
+* PURPOSE: convert a frame to the format of the stream and append it
+* INPUTS: param -- Pixmap& frame -- the frame, the same size as the first frame of the stream
+* OUTPUTS: bool, false if the stream is not open, the size differs or the write failed
+*/
+//================================================
+bool VideoWriter::writeFrame(Pixmap& frame){
+	if (file == NULL){
+		return false;
+	}
+	if (width == 0){ // first frame, the size of the stream is now known
+		width = frame.getWidth();
+		height = frame.getHeight();
+		if (format != VIDEO_RGBA){
+			fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 %s\n", width, height, fps,
+				(format == VIDEO_Y4M_420) ? "C420jpeg XYSCSS=420JPEG" : "C444");
+		}
+	}
+	if (frame.getWidth() != width || frame.getHeight() != height){
+		cerr << "Frame size " << frame.getWidth() << "x" << frame.getHeight() << " does not match the video size "
+		     << width << "x" << height << endl;
+		return false;
+	}
+
+	unsigned char* rgba = (unsigned char*)frame.getDataPointer(); // pixels are 4 bytes, R G B A
+	if (format == VIDEO_RGBA){
+		return fwrite(rgba, 4, width * height, file) == width * height;
+	}
+
+	int chromaWidth = (format == VIDEO_Y4M_420) ? (width + 1) / 2 : width;
+	int chromaHeight = (format == VIDEO_Y4M_420) ? (height + 1) / 2 : height;
+	buffer.resize((width * height) + (2 * chromaWidth * chromaHeight));
+	unsigned char* luma = &buffer[0];
+	unsigned char* blue = luma + (width * height);
+	unsigned char* red = blue + (chromaWidth * chromaHeight);
+	if (format == VIDEO_Y4M_444){
+		for (int row = 0; row < height; row++){
+			convertRow(rgba + (4 * row * width), NULL, width, luma + (row * width), NULL,
+				blue + (row * width), red + (row * width));
+		}
+	}
+	else{
+		for (int row = 0; row < height; row += 2){
+			int nextRow = (row + 1 < height) ? row + 1 : row; // repeat a last odd row
+			convertRow(rgba + (4 * row * width), rgba + (4 * nextRow * width), width,
+				luma + (row * width), luma + (nextRow * width),
+				blue + ((row / 2) * chromaWidth), red + ((row / 2) * chromaWidth));
+		}
+	}
+
+	fputs("FRAME\n", file);
+	return fwrite(&buffer[0], 1, buffer.size(), file) == buffer.size();
+}
+
+//================================================
+/*
+close()
+
+* PURPOSE: flush the stream and close the file (standard output is only flushed)
+* INPUTS: none
+* OUTPUTS: bool, false if the data could not be written out
+*/
+//================================================
+bool VideoWriter::close(void){
+	if (file == NULL){
+		return true;
+	}
+	bool ok = (fflush(file) == 0);
+	if (ownsFile){
+		ok = (fclose(file) == 0) && ok;
+	}
+	file = NULL;
+	return ok;
+}
+
+//================================================
+/*
+videoFormatByName(string name)
+
+* PURPOSE: look up a video format by the name given on the command line
+* INPUTS: param -- string name -- "y4m", "y4m444" or "rgba"
+* OUTPUTS: int, VIDEO_Y4M_420, VIDEO_Y4M_444 or VIDEO_RGBA, -1 if the name is unknown
+*/
+//================================================
+int videoFormatByName(string name){
+	if (name == "y4m"){
+		return VIDEO_Y4M_420;
+	}
+	if (name == "y4m444"){
+		return VIDEO_Y4M_444;
+	}
+	if (name == "rgba"){
+		return VIDEO_RGBA;
+	}
+	return -1;
+}
+
+//================================================
+/*
+formatForOutput(string outpattern)
+
+* PURPOSE: pick the format of an output from its name when none is given
+* INPUTS: param -- string outpattern -- output file, pattern or "-"
+* OUTPUTS: string, "y4m", "rgba" or "png"
+*/
+//================================================
+string formatForOutput(string outpattern){
+	string::size_type dot = outpattern.rfind('.');
+	string extension = (dot == string::npos) ? "" : outpattern.substr(dot);
+	if (outpattern == "-" || extension == ".y4m"){
+		return "y4m";
+	}
+	if (extension == ".rgba" || extension == ".raw"){
+		return "rgba";
+	}
+	return "png";
+}
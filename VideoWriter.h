@@ -0,0 +1,67 @@
+// VideoWriter.h
+//
+// Class VideoWriter streams rendered frames into a single uncompressed video stream, written
+// to a file or to standard output as the frames arrive, so that the morph can be piped
+// straight into a video encoder (ex. "morpher -b ... - | ffmpeg -i - out.mp4") without an
+// image file per frame. Supported formats:
+//  VIDEO_Y4M_420 - YUV4MPEG2, BT.601 studio range YCbCr with chroma averaged over 2x2 pixels
+//  VIDEO_Y4M_444 - YUV4MPEG2, BT.601 studio range YCbCr at full resolution
+//  VIDEO_RGBA - the RGBA pixels of each frame back to back, no header
+// The color conversion is done in fixed point, with AVX2 when the processor supports it; the
+// scalar and vector conversions give the same bytes.
+//
+// Members of the class include:
+//  FILE* file - stream being written, NULL when closed
+//  bool ownsFile - false when writing to standard output or a file the caller opened, which is
+//                  flushed but not closed
+//  int format - one of the formats above
+//  int fps - frame rate stored in the YUV4MPEG2 header
+//  int width, height - size of the frames, set by the first frame
+//  vector<unsigned char> buffer - one converted frame
+//
+#include <iostream>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include "Pixmap.h"
+using namespace std;
+
+#ifndef VIDEOWRITER
+#define VIDEOWRITER
+
+#define VIDEO_Y4M_420 0
+#define VIDEO_Y4M_444 1
+#define VIDEO_RGBA 2
+
+class VideoWriter{
+	private:
+		FILE* file;
+		bool ownsFile;
+		int format;
+		int fps;
+		int width;
+		int height;
+		vector<unsigned char> buffer;
+	public:
+		// constructor -- default, nothing open
+		VideoWriter(void);
+		~VideoWriter(void);
+
+		// start a stream, filename "-" writes to standard output. Returns false on error.
+		bool open(string filename, int format, int fps);
+		// start a stream on an open file (ex. a socket), which close() flushes but leaves open
+		bool open(FILE* stream, int format, int fps);
+		// append a frame, every frame must have the size of the first. Returns false on error.
+		bool writeFrame(Pixmap& frame);
+		// finish the stream. Returns false on error.
+		bool close(void);
+};
+
+// format with the given name, "y4m" (4:2:0), "y4m444" or "rgba", -1 if the name is unknown
+int videoFormatByName(string name);
+
+// format chosen from the name of an output: "y4m" for "-" (standard output) and .y4m names,
+// "rgba" for .rgba and .raw names, "png" (one image file per frame) for anything else
+string formatForOutput(string outpattern);
+
+#endif
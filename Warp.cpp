@@ -0,0 +1,687 @@
+// Warp.cpp
+//
+// Pixel-level stages of the Beier-Neely morph, the warp of a source image onto a set of
+// segments and the cross dissolve of two warped images. See Warp.h.
+//
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <mutex>
+#include "Warp.h"
+#include "Pixel.h"
+#include "Pixmap.h"
+#include "TiledPixmap.h"
+#include "Segment.h"
+#include "SegmentTable.h"
+#include "WarpSimd.h"
+#include "Dissolve.h"
+using namespace std;
+
+WarpSettings warpSettings = {1, 2, 0, -1, 0, 8, 0, false};
+
+// statistics of the approximate warp, tiles add their counts under reportLock
+static mutex reportLock;
+static ApproxReport approxReport = {0, 0, 0};
+
+// statistics of the segment culling, also under reportLock
+static CullReport cullReport = {0, 0, 0};
+
+//================================================
+/*
+sourcePixel(Pixmap& source, int x, int y), sourcePixel(TiledPixmap& source, int x, int y)
+
+* PURPOSE: pixel in column x, row y of a source image, in either layout
+* INPUTS: param -- Pixmap& / TiledPixmap& source -- the image
+*         param -- int x, y -- position inside the image
+* OUTPUTS: Pixel&, the pixel
+*/
+//================================================
+static inline Pixel& sourcePixel(Pixmap& source, int x, int y){
+	return source.getPmPointer()[y][x];
+}
+
+static inline Pixel& sourcePixel(TiledPixmap& source, int x, int y){
+	return source.at(x, y);
+}
+
+//================================================
+/*
+copySourcePixel(Source& source, Pixel& destPixel, float xPrime, float yPrime)
+
+* PURPOSE: copy the RGB values of the source pixel at (xPrime, yPrime) into destPixel, if that
+*          position lies inside the source image
+* INPUTS: param -- Source& source -- image the color is taken from, a Pixmap or a TiledPixmap
+*         param -- Pixel& destPixel -- pixel being rendered
+*         param -- float xPrime, yPrime -- position in the source image
+* OUTPUTS: none
+*/
+//================================================
+template<class Source>
+static inline void copySourcePixel(Source& source, Pixel& destPixel, float xPrime, float yPrime){
+	if (xPrime >= 0 && xPrime < source.getWidth() && yPrime >= 0 && yPrime < source.getHeight()){
+		Pixel& sourcePixel = ::sourcePixel(source, int(xPrime), int(yPrime));
+		destPixel.setRVal(sourcePixel.getRVal());
+		destPixel.setGVal(sourcePixel.getGVal());
+		destPixel.setBVal(sourcePixel.getBVal());
+	}
+}
+
+//================================================
+/*
+displacePoint(SegmentTable& table, SegmentTable* second, double a, double b, float pixelX,
+	      float pixelY, float& xPrime, float& yPrime, float* secondXPrime, float* secondYPrime)
+
+* PURPOSE: Use the Beier-Neely algorithm to find the position X' in the source image of the pixel
+*          X = (pixelX, pixelY). Only the flat arrays of the segment table are read, the
+*          per-segment constants (Q - P, lengths, ||Q - P||^c) come precomputed.
+*          A second table with the same destination segments (the other image of the morph
+*          warped to the same frame) shares u, v and the weights, only its P'Q' differ, so its
+*          X' is found in the same pass for the cost of the local X' of each segment.
+* INPUTS: param -- SegmentTable& table -- segment pairs of the warp
+*         param -- SegmentTable* second -- NULL, or a table with the same destination segments
+*         param -- double a, b -- weight constants, weight = (length^c / (a + dist))^b
+*         param -- float pixelX, pixelY -- the pixel X
+*         param -- float& xPrime, yPrime -- set to X'
+*         param -- float* secondXPrime, secondYPrime -- set to X' of second, unused if NULL
+* OUTPUTS: none
+*/
+//================================================
+static inline void displacePoint(SegmentTable& table, SegmentTable* second, double a, double b,
+		float pixelX, float pixelY, float& xPrime, float& yPrime, float* secondXPrime, float* secondYPrime){
+	// sum of displacements between source and destination pixels across segments, starting
+	// from the segments folded out of the table (zero unless the table was culled)
+	float dsumX = table.foldX0 + (table.foldXx * pixelX) + (table.foldXy * pixelY);
+	float dsumY = table.foldY0 + (table.foldYx * pixelX) + (table.foldYy * pixelY);
+	float weightsum = table.foldWeight;
+	float dsumX2 = 0;
+	float dsumY2 = 0;
+	float weightsum2 = 0;
+	if (second){
+		dsumX2 = second->foldX0 + (second->foldXx * pixelX) + (second->foldXy * pixelY);
+		dsumY2 = second->foldY0 + (second->foldYx * pixelX) + (second->foldYy * pixelY);
+		weightsum2 = second->foldWeight;
+	}
+
+	// for each segment
+	for (int s = 0; s < table.count; s++){
+		//**************************
+		//calculate u,v based on PQ
+		float XminusPx = pixelX - table.px[s]; // (X - P)
+		float XminusPy = pixelY - table.py[s];
+		float u = ((XminusPx * table.dx[s]) + (XminusPy * table.dy[s])) / table.lengthSq[s]; // (X-P) dot (Q-P) / ||Q - P||^2
+		float perpQPx = (-1) * table.dy[s]; //Perpendicular(Q-P) (x, y) -> (-y,x)
+		float v = ((XminusPx * perpQPx) + (XminusPy * table.dx[s])) / table.length[s]; // (X - P) dot Perpendicular(Q - P) / ||Q - P||
+
+		//**************************
+		// calculate X' Based on u,v and P'Q'
+		float perpQPprimeX = (-1) * table.dpy[s]; // Perpendicular (Q' - P')
+		float localXprimeX = table.ppx[s] + (table.dpx[s] * u) + ((perpQPprimeX * v) / table.lengthPrime[s]);
+		float localXprimeY = table.ppy[s] + (table.dpy[s] * u) + ((table.dpx[s] * v) / table.lengthPrime[s]);
+
+		// displacement between X' and X on the current segment
+		float dx = localXprimeX - pixelX;
+		float dy = localXprimeY - pixelY;
+
+		//**************************
+		// calculate shortest distance from X to line segment PQ
+		float dist;
+		// if 0 > u > 1, shortest distance is abs(v)
+		if (u >= 0 && u <= 1){
+			dist = fabs(v);
+		}
+		// if u < 0, shortest is distance between P and X
+		else if (u < 0){
+			dist = sqrt(((table.px[s] - pixelX) * (table.px[s] - pixelX)) + ((table.py[s] - pixelY) * (table.py[s] - pixelY)));
+		}
+		// if u > 1, shortest is distance between Q and X
+		else {
+			dist = sqrt(((table.qx[s] - pixelX) * (table.qx[s] - pixelX)) + ((table.qy[s] - pixelY) * (table.qy[s] - pixelY)));
+		}
+
+		//**************************
+		// calculate weight, length ^c / (a + dist) raised to b
+		double weightBase = table.lengthPow[s] / (a + dist);
+		double weight = (b == 2) ? weightBase * weightBase : pow(weightBase, b);
+		weight = float(weight);
+
+		// update sums
+		dsumX += (dx * weight);
+		dsumY += (dy * weight);
+		weightsum += weight;
+
+		if (second){ // X' of the source segment of the second table, same u, v and weight
+			float perpQPprimeX2 = (-1) * second->dpy[s];
+			float localXprimeX2 = second->ppx[s] + (second->dpx[s] * u) + ((perpQPprimeX2 * v) / second->lengthPrime[s]);
+			float localXprimeY2 = second->ppy[s] + (second->dpy[s] * u) + ((second->dpx[s] * v) / second->lengthPrime[s]);
+			dsumX2 += ((localXprimeX2 - pixelX) * weight);
+			dsumY2 += ((localXprimeY2 - pixelY) * weight);
+			weightsum2 += weight;
+		}
+	} // close loop through segments
+
+	xPrime = float(pixelX + (dsumX / weightsum));
+	yPrime = float(pixelY + (dsumY / weightsum));
+	if (second){
+		*secondXPrime = float(pixelX + (dsumX2 / weightsum2));
+		*secondYPrime = float(pixelY + (dsumY2 / weightsum2));
+	}
+}
+
+//================================================
+/*
+displaceRegionScalar(SegmentTable& table, SegmentTable* second, double a, double b, int rowStart,
+		     int rowEnd, int colStart, int colEnd, float* sourceX, float* sourceY,
+		     float* secondX, float* secondY)
+
+* PURPOSE: find, one pixel at a time, the position X' in the source image of every pixel X of
+*          a region
+* INPUTS: param -- SegmentTable& table -- segment pairs of the warp
+*         param -- SegmentTable* second -- NULL, or a table with the same destination segments
+*         param -- double a, b -- weight constants, weight = (length^c / (a + dist))^b
+*         param -- int rowStart, rowEnd, colStart, colEnd -- region, end values exclusive
+*         param -- float* sourceX, sourceY -- output, one value per pixel, row by row
+*         param -- float* secondX, secondY -- output for second, unused if NULL
+* OUTPUTS: none
+*/
+//================================================
+static void displaceRegionScalar(SegmentTable& table, SegmentTable* second, double a, double b,
+		int rowStart, int rowEnd, int colStart, int colEnd, float* sourceX, float* sourceY,
+		float* secondX, float* secondY){
+	int regionWidth = colEnd - colStart;
+
+	// for each pixel in the region
+	for (int row = rowStart; row < rowEnd; row++){
+		for (int col = colStart; col < colEnd; col++){
+			int i = (row - rowStart) * regionWidth + (col - colStart);
+			displacePoint(table, second, a, b, col, row, sourceX[i], sourceY[i],
+					second ? &secondX[i] : NULL, second ? &secondY[i] : NULL);
+		}
+	}
+}
+
+// state shared by the recursive refinement of one region in the approximate warp
+struct ApproxRegion{
+	SegmentTable* table;
+	double a, b;
+	float tolerance;
+	int rowStart, colStart, regionWidth;
+	float* sourceX;
+	float* sourceY;
+	vector<char> exact; // 1 where X' was computed exactly, 0 where it is interpolated or unknown
+	long exactCount;
+	float maxError;
+};
+
+//================================================
+/*
+exactAt(ApproxRegion& region, int row, int col)
+
+* PURPOSE: make sure X' of pixel (col, row) is the exact Beier-Neely value, computing it if it is
+*          not yet known
+* INPUTS: param -- ApproxRegion& region -- region being approximated
+*         param -- int row, col -- the pixel, inside the region
+* OUTPUTS: none
+*/
+//================================================
+static inline void exactAt(ApproxRegion& region, int row, int col){
+	int i = (row - region.rowStart) * region.regionWidth + (col - region.colStart);
+	if (!region.exact[i]){
+		displacePoint(*region.table, NULL, region.a, region.b, col, row, region.sourceX[i], region.sourceY[i], NULL, NULL);
+		region.exact[i] = 1;
+		region.exactCount = region.exactCount + 1;
+	}
+}
+
+//================================================
+/*
+refineCell(ApproxRegion& region, int row0, int col0, int row1, int col1)
+
+* PURPOSE: fill the cell with corners (col0, row0) and (col1, row1), whose corner values are exact.
+*          The exact displacement (X' - X) is computed at the centre and the midpoints of the
+*          sides of the cell and compared with the bilinear interpolation of the corner values.
+*          If they agree to within the tolerance the rest of the cell is interpolated, otherwise
+*          the cell is split in four at its centre (the new points become the corners of the
+*          parts, so no exact value is wasted) and each part refined, down to cells whose pixels
+*          are all corners.
+* INPUTS: param -- ApproxRegion& region -- region being approximated
+*         param -- int row0, col0, row1, col1 -- corners of the cell, inclusive
+* OUTPUTS: none
+*/
+//================================================
+static void refineCell(ApproxRegion& region, int row0, int col0, int row1, int col1){
+	if (row1 - row0 <= 1 && col1 - col0 <= 1){ // every pixel is a corner
+		return;
+	}
+	int corners[4][2] = {{row0, col0}, {row0, col1}, {row1, col0}, {row1, col1}};
+	float cornerDx[4];
+	float cornerDy[4];
+	for (int k = 0; k < 4; k++){
+		int i = (corners[k][0] - region.rowStart) * region.regionWidth + (corners[k][1] - region.colStart);
+		cornerDx[k] = region.sourceX[i] - corners[k][1];
+		cornerDy[k] = region.sourceY[i] - corners[k][0];
+	}
+
+	// split points of the cell, only along the sides that are long enough to split
+	vector<int> rows;
+	vector<int> cols;
+	rows.push_back(row0);
+	if (row1 - row0 >= 2){
+		rows.push_back((row0 + row1) / 2);
+	}
+	rows.push_back(row1);
+	cols.push_back(col0);
+	if (col1 - col0 >= 2){
+		cols.push_back((col0 + col1) / 2);
+	}
+	cols.push_back(col1);
+
+	// largest difference between the exact and the interpolated displacement at the split points
+	float error = 0;
+	for (int r = 0; r < rows.size(); r++){
+		for (int c = 0; c < cols.size(); c++){
+			exactAt(region, rows[r], cols[c]);
+			float fy = (row1 > row0) ? float(rows[r] - row0) / (row1 - row0) : 0;
+			float fx = (col1 > col0) ? float(cols[c] - col0) / (col1 - col0) : 0;
+			float interpDx = ((1 - fy) * (((1 - fx) * cornerDx[0]) + (fx * cornerDx[1]))) + (fy * (((1 - fx) * cornerDx[2]) + (fx * cornerDx[3])));
+			float interpDy = ((1 - fy) * (((1 - fx) * cornerDy[0]) + (fx * cornerDy[1]))) + (fy * (((1 - fx) * cornerDy[2]) + (fx * cornerDy[3])));
+			int i = (rows[r] - region.rowStart) * region.regionWidth + (cols[c] - region.colStart);
+			float errorX = (region.sourceX[i] - cols[c]) - interpDx;
+			float errorY = (region.sourceY[i] - rows[r]) - interpDy;
+			error = max(error, float(sqrt((errorX * errorX) + (errorY * errorY))));
+		}
+	}
+
+	if (error <= region.tolerance){
+		for (int row = row0; row <= row1; row++){
+			float fy = (row1 > row0) ? float(row - row0) / (row1 - row0) : 0;
+			for (int col = col0; col <= col1; col++){
+				int i = (row - region.rowStart) * region.regionWidth + (col - region.colStart);
+				if (region.exact[i]){
+					continue;
+				}
+				float fx = (col1 > col0) ? float(col - col0) / (col1 - col0) : 0;
+				float dx = ((1 - fy) * (((1 - fx) * cornerDx[0]) + (fx * cornerDx[1]))) + (fy * (((1 - fx) * cornerDx[2]) + (fx * cornerDx[3])));
+				float dy = ((1 - fy) * (((1 - fx) * cornerDy[0]) + (fx * cornerDy[1]))) + (fy * (((1 - fx) * cornerDy[2]) + (fx * cornerDy[3])));
+				region.sourceX[i] = col + dx;
+				region.sourceY[i] = row + dy;
+			}
+		}
+		region.maxError = max(region.maxError, error);
+		return;
+	}
+
+	for (int r = 0; r + 1 < rows.size(); r++){
+		for (int c = 0; c + 1 < cols.size(); c++){
+			refineCell(region, rows[r], cols[c], rows[r + 1], cols[c + 1]);
+		}
+	}
+}
+
+//================================================
+/*
+displaceRegionApprox(SegmentTable& table, double a, double b, int rowStart, int rowEnd,
+		     int colStart, int colEnd, float* sourceX, float* sourceY)
+
+* PURPOSE: approximate X' for every pixel of a region. The Beier-Neely field is smooth almost
+*          everywhere, so it is computed exactly only on a lattice of every
+*          warpSettings.approxStep'th pixel (plus the last row and column of the region), and
+*          each lattice cell is filled by refineCell(), which interpolates where the field is
+*          smooth to within warpSettings.approxTolerance pixels and subdivides where it is not.
+*          The number of exact evaluations and the largest error measured in an interpolated
+*          cell are added to the approximation report.
+* INPUTS: same as displaceRegionScalar
+* OUTPUTS: none
+*/
+//================================================
+static void displaceRegionApprox(SegmentTable& table, double a, double b, int rowStart, int rowEnd,
+		int colStart, int colEnd, float* sourceX, float* sourceY){
+	ApproxRegion region;
+	region.table = &table;
+	region.a = a;
+	region.b = b;
+	region.tolerance = warpSettings.approxTolerance;
+	region.rowStart = rowStart;
+	region.colStart = colStart;
+	region.regionWidth = colEnd - colStart;
+	region.sourceX = sourceX;
+	region.sourceY = sourceY;
+	region.exact.assign(region.regionWidth * (rowEnd - rowStart), 0);
+	region.exactCount = 0;
+	region.maxError = 0;
+
+	int step = max(warpSettings.approxStep, 1);
+	vector<int> rows;
+	vector<int> cols;
+	for (int row = rowStart; row < rowEnd - 1; row += step){
+		rows.push_back(row);
+	}
+	rows.push_back(rowEnd - 1);
+	for (int col = colStart; col < colEnd - 1; col += step){
+		cols.push_back(col);
+	}
+	cols.push_back(colEnd - 1);
+
+	for (int r = 0; r < rows.size(); r++){
+		for (int c = 0; c < cols.size(); c++){
+			exactAt(region, rows[r], cols[c]);
+		}
+	}
+	for (int r = 0; r + 1 < rows.size(); r++){
+		for (int c = 0; c + 1 < cols.size(); c++){
+			refineCell(region, rows[r], cols[c], rows[r + 1], cols[c + 1]);
+		}
+	}
+	if (rows.size() == 1 || cols.size() == 1){ // a single row or column of pixels, no cells
+		for (int row = rowStart; row < rowEnd; row++){
+			for (int col = colStart; col < colEnd; col++){
+				exactAt(region, row, col);
+			}
+		}
+	}
+
+	lock_guard<mutex> guard(reportLock);
+	approxReport.pixels += region.exact.size();
+	approxReport.exactPixels += region.exactCount;
+	approxReport.maxError = max(approxReport.maxError, region.maxError);
+}
+
+//================================================
+/*
+resetApproxReport(), getApproxReport()
+
+* PURPOSE: clear / read the statistics of the approximate warp
+* INPUTS: none
+* OUTPUTS: getApproxReport returns pixels warped, pixels evaluated exactly and the largest
+*          error (in pixels) measured in an interpolated cell
+*/
+//================================================
+void resetApproxReport(void){
+	lock_guard<mutex> guard(reportLock);
+	approxReport.pixels = 0;
+	approxReport.exactPixels = 0;
+	approxReport.maxError = 0;
+}
+
+ApproxReport getApproxReport(void){
+	lock_guard<mutex> guard(reportLock);
+	return approxReport;
+}
+
+//================================================
+/*
+resetCullReport(), getCullReport()
+
+* PURPOSE: clear / read the statistics of the segment culling
+* INPUTS: none
+* OUTPUTS: getCullReport returns regions warped, segment pairs before and after culling
+*/
+//================================================
+void resetCullReport(void){
+	lock_guard<mutex> guard(reportLock);
+	cullReport.tiles = 0;
+	cullReport.segments = 0;
+	cullReport.keptSegments = 0;
+}
+
+CullReport getCullReport(void){
+	lock_guard<mutex> guard(reportLock);
+	return cullReport;
+}
+
+//================================================
+/*
+displaceRegion(SegmentTable& table, SegmentTable* second, int rowStart, int rowEnd,
+	       int colStart, int colEnd, int step, float* sourceX, float* sourceY, float* secondX,
+	       float* secondY)
+
+* PURPOSE: find, for each pixel X of the region, the position X' in the source image that maps
+*          to it given the destination segments (PQ) and the matching source segments (P'Q'),
+*          with the method chosen by warpSettings.
+*          When warpSettings.cullFraction is set, the segments whose weight stays below that
+*          fraction of the total over the whole region are left out (see cullSegmentTable).
+*          When warpSettings.approxTolerance is set the positions are interpolated from a
+*          coarse lattice (see displaceRegionApprox). Otherwise, when the processor supports it
+*          (see warpSettings.simdWidth, rounded down to 16 or 8) they are computed by a vector
+*          kernel, else one pixel at a time. The positions of second, if given, come from the
+*          same weights, except in the approximate warp whose refinement depends on the field,
+*          so each table is approximated on its own there.
+*          With a step above 1 only the top left pixel of every step x step block is found (a
+*          preview), exactly, with the segments culled once for the whole region.
+* INPUTS: param -- SegmentTable& table -- segment pairs of the warp, built with warpSettings.c
+*         param -- SegmentTable* second -- NULL, or a table with the same destination segments
+*         param -- int rowStart, rowEnd, colStart, colEnd -- region, end values exclusive
+*         param -- int step -- 1 for every pixel, else the block size of the samples
+*         param -- float* sourceX, sourceY -- output, one value per pixel (or sample), row by row
+*         param -- float* secondX, secondY -- output for second, unused if NULL
+* OUTPUTS: none
+*/
+//================================================
+static void displaceRegion(SegmentTable& table, SegmentTable* second, int rowStart, int rowEnd,
+		int colStart, int colEnd, int step, float* sourceX, float* sourceY, float* secondX, float* secondY){
+	SegmentTable culled;
+	SegmentTable culledSecond;
+	SegmentTable* segments = &table;
+	if (warpSettings.cullFraction > 0 && table.count > 0){
+		cullSegmentTable(table, culled, colStart, rowStart, colEnd - 1, rowEnd - 1,
+				warpSettings.a, warpSettings.b, warpSettings.cullFraction);
+		segments = &culled;
+		if (second){ // same destination segments, so the same segments are kept
+			cullSegmentTable(*second, culledSecond, colStart, rowStart, colEnd - 1, rowEnd - 1,
+					warpSettings.a, warpSettings.b, warpSettings.cullFraction);
+			second = &culledSecond;
+		}
+
+		lock_guard<mutex> guard(reportLock);
+		cullReport.tiles += 1;
+		cullReport.segments += table.count;
+		cullReport.keptSegments += culled.count;
+	}
+
+	int lanes = simdWidthAvailable();
+	if (warpSettings.simdWidth >= 0 && warpSettings.simdWidth < lanes){
+		lanes = (warpSettings.simdWidth >= 8) ? 8 : 0; // round down to a kernel there is
+	}
+	bool useSimd = lanes > 0 && simdSupportsExponent(warpSettings.b);
+	if (step > 1){ // one pixel per block, the samples are too sparse for the approximate warp
+		int sample = 0;
+		for (int row = rowStart; row < rowEnd; row += step){
+			for (int col = colStart; col < colEnd; col += step){
+				float* sampleSecondX = second ? &secondX[sample] : NULL;
+				float* sampleSecondY = second ? &secondY[sample] : NULL;
+				if (useSimd){
+					displaceRegionSimd(lanes, *segments, second, warpSettings.a, warpSettings.b, row, row + 1, col, col + 1,
+							&sourceX[sample], &sourceY[sample], sampleSecondX, sampleSecondY);
+				}
+				else{
+					displaceRegionScalar(*segments, second, warpSettings.a, warpSettings.b, row, row + 1, col, col + 1,
+							&sourceX[sample], &sourceY[sample], sampleSecondX, sampleSecondY);
+				}
+				sample++;
+			}
+		}
+	}
+	else if (warpSettings.approxTolerance > 0){
+		displaceRegionApprox(*segments, warpSettings.a, warpSettings.b, rowStart, rowEnd, colStart, colEnd, sourceX, sourceY);
+		if (second){
+			displaceRegionApprox(*second, warpSettings.a, warpSettings.b, rowStart, rowEnd, colStart, colEnd, secondX, secondY);
+		}
+	}
+	else if (useSimd){
+		displaceRegionSimd(lanes, *segments, second, warpSettings.a, warpSettings.b, rowStart, rowEnd, colStart, colEnd,
+				sourceX, sourceY, secondX, secondY);
+	}
+	else{
+		displaceRegionScalar(*segments, second, warpSettings.a, warpSettings.b, rowStart, rowEnd, colStart, colEnd,
+				sourceX, sourceY, secondX, secondY);
+	}
+}
+
+//================================================
+/*
+warpRegion(Pixmap& / TiledPixmap& source, SegmentTable& table, Pixmap& out, int rowStart,
+	   int rowEnd, int colStart, int colEnd), both by warpRegionFrom
+
+* PURPOSE: Use the Beier-Neely algorithm to find, for each pixel X of the region, the position X'
+*          in the source image that maps to it (see displaceRegion) and copy the color found
+*          there. Pixels whose X' falls outside the source image are left unchanged.
+* INPUTS: param -- Pixmap& / TiledPixmap& source -- image the colors are taken from
+*         param -- SegmentTable& table -- segment pairs of the warp, built with warpSettings.c
+*         param -- Pixmap& out -- frame being rendered
+*         param -- int rowStart, rowEnd, colStart, colEnd -- region of out to render,
+*                  the end values are exclusive
+* OUTPUTS: none, writes the RGB values of the region of out
+*/
+//================================================
+template<class Source>
+static void warpRegionFrom(Source& source, SegmentTable& table, Pixmap& out, int rowStart, int rowEnd,
+		int colStart, int colEnd){
+
+	Pixel** destPointer = out.getPmPointer();
+	int regionWidth = colEnd - colStart;
+	vector<float> sourceX(regionWidth * (rowEnd - rowStart));
+	vector<float> sourceY(regionWidth * (rowEnd - rowStart));
+	displaceRegion(table, NULL, rowStart, rowEnd, colStart, colEnd, 1, &sourceX[0], &sourceY[0], NULL, NULL);
+
+	for (int row = rowStart; row < rowEnd; row++){
+		for (int col = colStart; col < colEnd; col++){
+			int i = (row - rowStart) * regionWidth + (col - colStart);
+			copySourcePixel(source, destPointer[row][col], sourceX[i], sourceY[i]);
+		}
+	}
+}
+
+void warpRegion(Pixmap& source, SegmentTable& table, Pixmap& out, int rowStart, int rowEnd,
+		int colStart, int colEnd){
+	warpRegionFrom(source, table, out, rowStart, rowEnd, colStart, colEnd);
+}
+
+void warpRegion(TiledPixmap& source, SegmentTable& table, Pixmap& out, int rowStart, int rowEnd,
+		int colStart, int colEnd){
+	warpRegionFrom(source, table, out, rowStart, rowEnd, colStart, colEnd);
+}
+
+//================================================
+/*
+morphRegion(Pixmap& / TiledPixmap& sourceA, SegmentTable& tableA, sourceB, SegmentTable& tableB,
+	    Pixmap& out, float alpha, int rowStart, int rowEnd, int colStart, int colEnd),
+previewRegion(... as morphRegion ..., int step), all by morphRegionFrom
+
+* PURPOSE: render a region of one morph frame in a single pass: warp imageA and imageB to the
+*          segments of the frame and cross dissolve them straight into out. Both warps use the
+*          destination segments of the frame, so when the two tables pair the same segments
+*          u, v, the distances and the weights are computed once for both source positions.
+*          The warped colors of a row are kept in two small row buffers, blended by dissolveRow,
+*          rather than in two warped frames that a second pass would read back. The result is
+*          the same as warpRegion of each image onto a black frame followed by dissolveRegion.
+*          previewRegion renders only the top left pixel of every step x step block and copies
+*          it over the block, in the same pass over the whole region.
+* INPUTS: param -- Pixmap& / TiledPixmap& sourceA, sourceB -- the two images of the morph, in
+*                  the same layout
+*         param -- SegmentTable& tableA, tableB -- segment pairs of the warp of each image onto
+*                  the segments of the frame, built with warpSettings.c
+*         param -- Pixmap& out -- frame being rendered, or the part of it in its data window
+*         param -- float alpha -- visibility of the warped imageB, the time of the frame
+*         param -- int rowStart, rowEnd, colStart, colEnd -- region of the frame to render,
+*                  the end values are exclusive, inside the data window of out
+*         param -- int step -- previewRegion only, block size of the samples
+* OUTPUTS: none, writes every pixel of the region of out (opaque), so out need not be cleared
+*/
+//================================================
+template<class Source>
+static void morphRegionFrom(Source& sourceA, SegmentTable& tableA, Source& sourceB, SegmentTable& tableB,
+		Pixmap& out, float alpha, int rowStart, int rowEnd, int colStart, int colEnd, int step){
+
+	int regionWidth = (colEnd - colStart + step - 1) / step; // in samples, pixels for a step of 1
+	int regionHeight = (rowEnd - rowStart + step - 1) / step;
+	vector<float> sourceAX(regionWidth * regionHeight);
+	vector<float> sourceAY(regionWidth * regionHeight);
+	vector<float> sourceBX(regionWidth * regionHeight);
+	vector<float> sourceBY(regionWidth * regionHeight);
+	if (tableA.count == tableB.count && tableA.id == tableB.id){ // same destination segments
+		displaceRegion(tableA, &tableB, rowStart, rowEnd, colStart, colEnd, step,
+				&sourceAX[0], &sourceAY[0], &sourceBX[0], &sourceBY[0]);
+	}
+	else{ // an id is missing from one of the images, the weights differ
+		displaceRegion(tableA, NULL, rowStart, rowEnd, colStart, colEnd, step, &sourceAX[0], &sourceAY[0], NULL, NULL);
+		displaceRegion(tableB, NULL, rowStart, rowEnd, colStart, colEnd, step, &sourceBX[0], &sourceBY[0], NULL, NULL);
+	}
+
+	Pixel** newPointer = out.getPmPointer();
+	int originX = out.getOriginX(); // pixel (0, 0) of out in the frame, see Pixmap::setDataWindow
+	int originY = out.getOriginY();
+	vector<Pixel> rowA(regionWidth); // the warped colors of one row, blended by dissolveRow
+	vector<Pixel> rowB(regionWidth);
+	vector<Pixel> samples(step > 1 ? regionWidth : 0); // the blended samples of a preview row
+	int weight = dissolveWeight(alpha);
+	for (int sampleRow = 0; sampleRow < regionHeight; sampleRow++){
+		for (int sample = 0; sample < regionWidth; sample++){
+			int i = sampleRow * regionWidth + sample;
+			rowA[sample] = Pixel(0, 0, 0, 255); // black where X' falls outside the image, like an unwritten warp
+			rowB[sample] = Pixel(0, 0, 0, 255);
+			copySourcePixel(sourceA, rowA[sample], sourceAX[i], sourceAY[i]);
+			copySourcePixel(sourceB, rowB[sample], sourceBX[i], sourceBY[i]);
+		}
+		int row = rowStart + (sampleRow * step);
+		if (step == 1){
+			dissolveRow(&rowA[0], &rowB[0], &newPointer[row - originY][colStart - originX], regionWidth, weight, false);
+			continue;
+		}
+		dissolveRow(&rowA[0], &rowB[0], &samples[0], regionWidth, weight, false);
+		for (int blockRow = row; blockRow < min(row + step, rowEnd); blockRow++){ // copy each sample over its block
+			Pixel* pixels = &newPointer[blockRow - originY][colStart - originX];
+			for (int col = 0; col < colEnd - colStart; col++){
+				pixels[col] = samples[col / step];
+			}
+		}
+	}
+}
+
+void morphRegion(Pixmap& sourceA, SegmentTable& tableA, Pixmap& sourceB, SegmentTable& tableB,
+		Pixmap& out, float alpha, int rowStart, int rowEnd, int colStart, int colEnd){
+	morphRegionFrom(sourceA, tableA, sourceB, tableB, out, alpha, rowStart, rowEnd, colStart, colEnd, 1);
+}
+
+void morphRegion(TiledPixmap& sourceA, SegmentTable& tableA, TiledPixmap& sourceB, SegmentTable& tableB,
+		Pixmap& out, float alpha, int rowStart, int rowEnd, int colStart, int colEnd){
+	morphRegionFrom(sourceA, tableA, sourceB, tableB, out, alpha, rowStart, rowEnd, colStart, colEnd, 1);
+}
+
+void previewRegion(Pixmap& sourceA, SegmentTable& tableA, Pixmap& sourceB, SegmentTable& tableB,
+		Pixmap& out, float alpha, int rowStart, int rowEnd, int colStart, int colEnd, int step){
+	morphRegionFrom(sourceA, tableA, sourceB, tableB, out, alpha, rowStart, rowEnd, colStart, colEnd, step);
+}
+
+void previewRegion(TiledPixmap& sourceA, SegmentTable& tableA, TiledPixmap& sourceB, SegmentTable& tableB,
+		Pixmap& out, float alpha, int rowStart, int rowEnd, int colStart, int colEnd, int step){
+	morphRegionFrom(sourceA, tableA, sourceB, tableB, out, alpha, rowStart, rowEnd, colStart, colEnd, step);
+}
+
+//================================================
+/*
+dissolveRegion(Pixmap& imageX, Pixmap& imageY, Pixmap& out, float alpha,
+	       int rowStart, int rowEnd, int colStart, int colEnd)
+
+* PURPOSE: cross dissolve two images warped to the same segments. The alpha of imageX is
+*          1 - alpha of imageY (ex. if imageX is at 0.25 visibility, imageY is at 0.75 visibility).
+*          The rows are blended in fixed point and rounded by dissolveRow.
+* INPUTS: param -- Pixmap& imageX, imageY -- the two warped images
+*         param -- Pixmap& out -- frame being rendered
+*         param -- float alpha -- visibility of imageY, the time of the frame in the morph
+*         param -- int rowStart, rowEnd, colStart, colEnd -- region of out to render,
+*                  the end values are exclusive
+* OUTPUTS: none, writes the pixels of the region of out (opaque)
+*/
+//================================================
+void dissolveRegion(Pixmap& imageX, Pixmap& imageY, Pixmap& out, float alpha,
+		int rowStart, int rowEnd, int colStart, int colEnd){
+	Pixel** XPointer = imageX.getPmPointer();
+	Pixel** YPointer = imageY.getPmPointer();
+	Pixel** newPointer = out.getPmPointer();
+	int weight = dissolveWeight(alpha);
+	for (int ro = rowStart; ro < rowEnd; ro++){ // blend a row of the region at a time
+		dissolveRow(&XPointer[ro][colStart], &YPointer[ro][colStart], &newPointer[ro][colStart],
+			colEnd - colStart, weight, false);
+	}
+}
@@ -0,0 +1,90 @@
+// Warp.h
+//
+// Pixel-level stages of the Beier-Neely morph: warping a source image to a set of
+// destination segments and cross-dissolving two warped images. Each function works on a
+// rectangular region of the output so that morph() can split a frame into tiles and render
+// the tiles on different threads. Every output pixel depends only on the inputs, never on
+// other output pixels, so the result is the same for any tiling or thread count.
+// The warps read their sources either from a Pixmap or from a TiledPixmap, a copy in page-sized
+// tiles that keeps the scattered reads of a tile in few pages; both give the same pixels.
+//
+#include <iostream>
+#include <vector>
+#include "Pixel.h"
+#include "Pixmap.h"
+#include "TiledPixmap.h"
+#include "Segment.h"
+#include "SegmentTable.h"
+using namespace std;
+
+#ifndef WARP
+#define WARP
+
+// width and height in pixels of the tiles a frame is split into for rendering
+#define TILE_SIZE 64
+
+struct WarpSettings{
+	// constants to determine weights in warp, weight = (length^c / (a + dist))^b
+	double a; // val barely greater than 0 gives precise control of warp, greater vals have smoother warp but less control
+	double b; // ideally in range 0.5 - 2
+	double c; // if 0, all segments have same weight; if 1, longer segments have more weight
+	int simdWidth; // pixels per vector kernel call: 16, 8, 0 for the scalar warp, -1 for the widest available
+	float approxTolerance; // if > 0, interpolate the displacement where it is smooth to within this many pixels
+	int approxStep; // spacing in pixels of the lattice the approximate warp evaluates exactly
+	double cullFraction; // if > 0, skip in each tile the segments whose weight stays below this fraction of the total
+	bool tiledSources; // if true, the frame generator warps tiled copies of its images (see TiledPixmap.h)
+};
+
+// settings used by every warp, defaults a = 1, b = 2, c = 0, widest vector kernel, exact warp,
+// every segment evaluated at every pixel, row-major sources
+extern WarpSettings warpSettings;
+
+// what the approximate warp did since the last reset
+struct ApproxReport{
+	long pixels; // pixels warped
+	long exactPixels; // pixels whose displacement was computed exactly
+	float maxError; // largest difference (in pixels) between exact and interpolated displacement
+			// measured at the centre and side midpoints of an interpolated cell, the
+			// estimated error bound
+};
+
+void resetApproxReport(void);
+ApproxReport getApproxReport(void);
+
+// what the segment culling did since the last reset
+struct CullReport{
+	long tiles; // regions warped
+	long segments; // segment pairs of those regions before culling
+	long keptSegments; // segment pairs evaluated after culling
+};
+
+void resetCullReport(void);
+CullReport getCullReport(void);
+
+// warp source onto the segment pairs of table (built with warpSettings.c), for rows
+// [rowStart, rowEnd) and columns [colStart, colEnd) of out
+void warpRegion(Pixmap& source, SegmentTable& table, Pixmap& out, int rowStart, int rowEnd,
+		int colStart, int colEnd);
+void warpRegion(TiledPixmap& source, SegmentTable& table, Pixmap& out, int rowStart, int rowEnd,
+		int colStart, int colEnd);
+
+// warp sourceA and sourceB onto the segments of one frame (tableA, tableB) and blend them into
+// out in one pass, alpha is the visibility of sourceB. Same result as warpRegion of each
+// image followed by dissolveRegion, without the two warped frames. The region is in pixels of
+// the frame; out may hold only part of it, its data window (see Pixmap::setDataWindow).
+void morphRegion(Pixmap& sourceA, SegmentTable& tableA, Pixmap& sourceB, SegmentTable& tableB,
+		Pixmap& out, float alpha, int rowStart, int rowEnd, int colStart, int colEnd);
+void morphRegion(TiledPixmap& sourceA, SegmentTable& tableA, TiledPixmap& sourceB, SegmentTable& tableB,
+		Pixmap& out, float alpha, int rowStart, int rowEnd, int colStart, int colEnd);
+// preview of morphRegion: only the top left pixel of every step x step block of the region is
+// rendered, and copied over its block
+void previewRegion(Pixmap& sourceA, SegmentTable& tableA, Pixmap& sourceB, SegmentTable& tableB,
+		Pixmap& out, float alpha, int rowStart, int rowEnd, int colStart, int colEnd, int step);
+void previewRegion(TiledPixmap& sourceA, SegmentTable& tableA, TiledPixmap& sourceB, SegmentTable& tableB,
+		Pixmap& out, float alpha, int rowStart, int rowEnd, int colStart, int colEnd, int step);
+
+// blend imageX and imageY into out, alpha is the visibility of imageY
+void dissolveRegion(Pixmap& imageX, Pixmap& imageY, Pixmap& out, float alpha,
+		int rowStart, int rowEnd, int colStart, int colEnd);
+
+#endif
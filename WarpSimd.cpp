@@ -0,0 +1,336 @@
+// WarpSimd.cpp
+//
+// Vectorized Beier-Neely displacement kernels for AVX2 (8 pixels) and AVX-512 (16 pixels).
+// The kernels are compiled with per-function target attributes and selected at run time,
+// so the rest of the program does not need to be built for these instruction sets.
+// See WarpSimd.h.
+//
+
+#include <iostream>
+#include <vector>
+#include <math.h>
+#include "WarpSimd.h"
+#include "SegmentTable.h"
+using namespace std;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  include <immintrin.h>
+#  define MORPHER_X86_SIMD
+#endif
+
+// keep the compiler from fusing the kernels' multiplies and adds (see displaceRegionAvx2)
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC optimize ("fp-contract=off")
+#endif
+
+//================================================
+/*
+simdWidthAvailable()
+
+* PURPOSE: find the widest displacement kernel the processor (and operating system) supports
+* INPUTS: none
+* OUTPUTS: int, 16 for AVX-512, 8 for AVX2, 0 if neither is available
+*/
+//================================================
+int simdWidthAvailable(void){
+#ifdef MORPHER_X86_SIMD
+	static int width = -1;
+	if (width < 0){
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")){
+			width = 16;
+		}
+		else if (__builtin_cpu_supports("avx2")){
+			width = 8;
+		}
+		else{
+			width = 0;
+		}
+	}
+	return width;
+#else
+	return 0;
+#endif
+}
+
+//================================================
+/*
+simdSupportsExponent(double b)
+
+* PURPOSE: the kernels raise the weight base to the power b with multiplies and one square root,
+*          which works for b = 0, 0.5, 1, 1.5, ... 8. This covers the useful range of b
+*          (0.5 - 2); other values must use the scalar warp.
+* INPUTS: param -- double b -- exponent of the segment weights
+* OUTPUTS: bool, true if the kernels can be used
+*/
+//================================================
+bool simdSupportsExponent(double b){
+	return b >= 0 && b <= 8 && (b * 2) == floor(b * 2);
+}
+
+#ifdef MORPHER_X86_SIMD
+
+__attribute__((target("avx2")))
+static inline __m256 powAvx2(__m256 base, int powInt, bool powHalf){
+	__m256 result = powHalf ? _mm256_sqrt_ps(base) : _mm256_set1_ps(1.0f);
+	for (int i = 0; i < powInt; i++){
+		result = _mm256_mul_ps(result, base);
+	}
+	return result;
+}
+
+//================================================
+/*
+displaceRegionAvx2(...), displaceRegionAvx512(...)
+
+* PURPOSE: evaluate the Beier-Neely displacement for 8 / 16 pixels of a row at a time. For each
+*          segment: u = (X-P).(Q-P) / ||Q-P||^2, v = (X-P).Perp(Q-P) / ||Q-P||,
+*          X' = P' + u (Q'-P') + v Perp(Q'-P') / ||Q'-P'||, the distance to PQ is |v|, ||X-P||
+*          or ||X-Q|| depending on u, and the weight is (||Q-P||^c / (a + dist))^b. The
+*          source position is X + (sum of weighted displacements) / (sum of weights).
+*          u, v and X' are computed with the same operations, in the same order, as the scalar
+*          warp (divisions rather than reciprocals, no fused multiply-add), so they round the
+*          same way; in particular a pixel whose segments are unchanged maps exactly onto itself
+*          instead of landing a hair short and truncating to the neighbouring pixel.
+*          With a second table only P'Q' differ, so u, v and the weight are reused for its X'.
+* INPUTS: see displaceRegionSimd
+* OUTPUTS: none, fills sourceX and sourceY (and secondX and secondY)
+*/
+//================================================
+__attribute__((target("avx2")))
+static void displaceRegionAvx2(SegmentTable& table, SegmentTable* second, float a, int powInt, bool powHalf,
+		int rowStart, int rowEnd, int colStart, int colEnd, float* sourceX, float* sourceY,
+		float* secondX, float* secondY){
+	int regionWidth = colEnd - colStart;
+	int numSegments = table.count;
+	const __m256 laneOffsets = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 aVec = _mm256_set1_ps(a);
+	float bufferX[8];
+	float bufferY[8];
+
+	for (int row = rowStart; row < rowEnd; row++){
+		__m256 Y = _mm256_set1_ps(row);
+		float* rowX = sourceX + (row - rowStart) * regionWidth;
+		float* rowY = sourceY + (row - rowStart) * regionWidth;
+		float* rowX2 = second ? secondX + (row - rowStart) * regionWidth : NULL;
+		float* rowY2 = second ? secondY + (row - rowStart) * regionWidth : NULL;
+		for (int col = colStart; col < colEnd; col += 8){
+			__m256 X = _mm256_add_ps(_mm256_set1_ps(col), laneOffsets);
+			// start from the segments folded out of the table, zero unless it was culled
+			__m256 dsumX = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(table.foldX0), _mm256_mul_ps(_mm256_set1_ps(table.foldXx), X)), _mm256_mul_ps(_mm256_set1_ps(table.foldXy), Y));
+			__m256 dsumY = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(table.foldY0), _mm256_mul_ps(_mm256_set1_ps(table.foldYx), X)), _mm256_mul_ps(_mm256_set1_ps(table.foldYy), Y));
+			__m256 weightsum = _mm256_set1_ps(table.foldWeight);
+			__m256 dsumX2 = zero;
+			__m256 dsumY2 = zero;
+			__m256 weightsum2 = zero;
+			if (second){
+				dsumX2 = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(second->foldX0), _mm256_mul_ps(_mm256_set1_ps(second->foldXx), X)), _mm256_mul_ps(_mm256_set1_ps(second->foldXy), Y));
+				dsumY2 = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(second->foldY0), _mm256_mul_ps(_mm256_set1_ps(second->foldYx), X)), _mm256_mul_ps(_mm256_set1_ps(second->foldYy), Y));
+				weightsum2 = _mm256_set1_ps(second->foldWeight);
+			}
+
+			for (int s = 0; s < numSegments; s++){
+				__m256 dx = _mm256_set1_ps(table.dx[s]);
+				__m256 dy = _mm256_set1_ps(table.dy[s]);
+				__m256 XminusPx = _mm256_sub_ps(X, _mm256_set1_ps(table.px[s]));
+				__m256 XminusPy = _mm256_sub_ps(Y, _mm256_set1_ps(table.py[s]));
+
+				__m256 u = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(XminusPx, dx), _mm256_mul_ps(XminusPy, dy)), _mm256_set1_ps(table.lengthSq[s]));
+				__m256 v = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(XminusPy, dx), _mm256_mul_ps(XminusPx, dy)), _mm256_set1_ps(table.length[s]));
+
+				__m256 dpx = _mm256_set1_ps(table.dpx[s]);
+				__m256 dpy = _mm256_set1_ps(table.dpy[s]);
+				__m256 lengthPrime = _mm256_set1_ps(table.lengthPrime[s]);
+				__m256 localXprimeX = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(table.ppx[s]), _mm256_mul_ps(dpx, u)), _mm256_div_ps(_mm256_mul_ps(dpy, v), lengthPrime));
+				__m256 localXprimeY = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(table.ppy[s]), _mm256_mul_ps(dpy, u)), _mm256_div_ps(_mm256_mul_ps(dpx, v), lengthPrime));
+
+				__m256 XminusQx = _mm256_sub_ps(X, _mm256_set1_ps(table.qx[s]));
+				__m256 XminusQy = _mm256_sub_ps(Y, _mm256_set1_ps(table.qy[s]));
+				__m256 distP = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(XminusPx, XminusPx), _mm256_mul_ps(XminusPy, XminusPy)));
+				__m256 distQ = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(XminusQx, XminusQx), _mm256_mul_ps(XminusQy, XminusQy)));
+				__m256 dist = _mm256_and_ps(v, absMask);
+				dist = _mm256_blendv_ps(dist, distP, _mm256_cmp_ps(u, zero, _CMP_LT_OQ));
+				dist = _mm256_blendv_ps(dist, distQ, _mm256_cmp_ps(u, one, _CMP_GT_OQ));
+
+				__m256 weight = powAvx2(_mm256_div_ps(_mm256_set1_ps(float(table.lengthPow[s])), _mm256_add_ps(aVec, dist)), powInt, powHalf);
+				dsumX = _mm256_add_ps(dsumX, _mm256_mul_ps(_mm256_sub_ps(localXprimeX, X), weight));
+				dsumY = _mm256_add_ps(dsumY, _mm256_mul_ps(_mm256_sub_ps(localXprimeY, Y), weight));
+				weightsum = _mm256_add_ps(weightsum, weight);
+
+				if (second){ // same u, v and weight, the source segment of the second table
+					__m256 dpx2 = _mm256_set1_ps(second->dpx[s]);
+					__m256 dpy2 = _mm256_set1_ps(second->dpy[s]);
+					__m256 lengthPrime2 = _mm256_set1_ps(second->lengthPrime[s]);
+					__m256 localXprimeX2 = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(second->ppx[s]), _mm256_mul_ps(dpx2, u)), _mm256_div_ps(_mm256_mul_ps(dpy2, v), lengthPrime2));
+					__m256 localXprimeY2 = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(second->ppy[s]), _mm256_mul_ps(dpy2, u)), _mm256_div_ps(_mm256_mul_ps(dpx2, v), lengthPrime2));
+					dsumX2 = _mm256_add_ps(dsumX2, _mm256_mul_ps(_mm256_sub_ps(localXprimeX2, X), weight));
+					dsumY2 = _mm256_add_ps(dsumY2, _mm256_mul_ps(_mm256_sub_ps(localXprimeY2, Y), weight));
+					weightsum2 = _mm256_add_ps(weightsum2, weight);
+				}
+			}
+
+			__m256 resultX = _mm256_add_ps(X, _mm256_div_ps(dsumX, weightsum));
+			__m256 resultY = _mm256_add_ps(Y, _mm256_div_ps(dsumY, weightsum));
+			if (col + 8 <= colEnd){
+				_mm256_storeu_ps(rowX + (col - colStart), resultX);
+				_mm256_storeu_ps(rowY + (col - colStart), resultY);
+			}
+			else{ // last, partial vector of the row
+				_mm256_storeu_ps(bufferX, resultX);
+				_mm256_storeu_ps(bufferY, resultY);
+				for (int k = 0; col + k < colEnd; k++){
+					rowX[col - colStart + k] = bufferX[k];
+					rowY[col - colStart + k] = bufferY[k];
+				}
+			}
+			if (second){
+				__m256 resultX2 = _mm256_add_ps(X, _mm256_div_ps(dsumX2, weightsum2));
+				__m256 resultY2 = _mm256_add_ps(Y, _mm256_div_ps(dsumY2, weightsum2));
+				_mm256_storeu_ps(bufferX, resultX2);
+				_mm256_storeu_ps(bufferY, resultY2);
+				for (int k = 0; k < 8 && col + k < colEnd; k++){
+					rowX2[col - colStart + k] = bufferX[k];
+					rowY2[col - colStart + k] = bufferY[k];
+				}
+			}
+		}
+	}
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 powAvx512(__m512 base, int powInt, bool powHalf){
+	__m512 result = powHalf ? _mm512_sqrt_ps(base) : _mm512_set1_ps(1.0f);
+	for (int i = 0; i < powInt; i++){
+		result = _mm512_mul_ps(result, base);
+	}
+	return result;
+}
+
+__attribute__((target("avx512f")))
+static void displaceRegionAvx512(SegmentTable& table, SegmentTable* second, float a, int powInt, bool powHalf,
+		int rowStart, int rowEnd, int colStart, int colEnd, float* sourceX, float* sourceY,
+		float* secondX, float* secondY){
+	int regionWidth = colEnd - colStart;
+	int numSegments = table.count;
+	static const float offsets[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+	const __m512 laneOffsets = _mm512_loadu_ps(offsets);
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512 aVec = _mm512_set1_ps(a);
+
+	for (int row = rowStart; row < rowEnd; row++){
+		__m512 Y = _mm512_set1_ps(row);
+		float* rowX = sourceX + (row - rowStart) * regionWidth;
+		float* rowY = sourceY + (row - rowStart) * regionWidth;
+		float* rowX2 = second ? secondX + (row - rowStart) * regionWidth : NULL;
+		float* rowY2 = second ? secondY + (row - rowStart) * regionWidth : NULL;
+		for (int col = colStart; col < colEnd; col += 16){
+			__m512 X = _mm512_add_ps(_mm512_set1_ps(col), laneOffsets);
+			// start from the segments folded out of the table, zero unless it was culled
+			__m512 dsumX = _mm512_add_ps(_mm512_add_ps(_mm512_set1_ps(table.foldX0), _mm512_mul_ps(_mm512_set1_ps(table.foldXx), X)), _mm512_mul_ps(_mm512_set1_ps(table.foldXy), Y));
+			__m512 dsumY = _mm512_add_ps(_mm512_add_ps(_mm512_set1_ps(table.foldY0), _mm512_mul_ps(_mm512_set1_ps(table.foldYx), X)), _mm512_mul_ps(_mm512_set1_ps(table.foldYy), Y));
+			__m512 weightsum = _mm512_set1_ps(table.foldWeight);
+			__m512 dsumX2 = zero;
+			__m512 dsumY2 = zero;
+			__m512 weightsum2 = zero;
+			if (second){
+				dsumX2 = _mm512_add_ps(_mm512_add_ps(_mm512_set1_ps(second->foldX0), _mm512_mul_ps(_mm512_set1_ps(second->foldXx), X)), _mm512_mul_ps(_mm512_set1_ps(second->foldXy), Y));
+				dsumY2 = _mm512_add_ps(_mm512_add_ps(_mm512_set1_ps(second->foldY0), _mm512_mul_ps(_mm512_set1_ps(second->foldYx), X)), _mm512_mul_ps(_mm512_set1_ps(second->foldYy), Y));
+				weightsum2 = _mm512_set1_ps(second->foldWeight);
+			}
+
+			for (int s = 0; s < numSegments; s++){
+				__m512 dx = _mm512_set1_ps(table.dx[s]);
+				__m512 dy = _mm512_set1_ps(table.dy[s]);
+				__m512 XminusPx = _mm512_sub_ps(X, _mm512_set1_ps(table.px[s]));
+				__m512 XminusPy = _mm512_sub_ps(Y, _mm512_set1_ps(table.py[s]));
+
+				__m512 u = _mm512_div_ps(_mm512_add_ps(_mm512_mul_ps(XminusPx, dx), _mm512_mul_ps(XminusPy, dy)), _mm512_set1_ps(table.lengthSq[s]));
+				__m512 v = _mm512_div_ps(_mm512_sub_ps(_mm512_mul_ps(XminusPy, dx), _mm512_mul_ps(XminusPx, dy)), _mm512_set1_ps(table.length[s]));
+
+				__m512 dpx = _mm512_set1_ps(table.dpx[s]);
+				__m512 dpy = _mm512_set1_ps(table.dpy[s]);
+				__m512 lengthPrime = _mm512_set1_ps(table.lengthPrime[s]);
+				__m512 localXprimeX = _mm512_sub_ps(_mm512_add_ps(_mm512_set1_ps(table.ppx[s]), _mm512_mul_ps(dpx, u)), _mm512_div_ps(_mm512_mul_ps(dpy, v), lengthPrime));
+				__m512 localXprimeY = _mm512_add_ps(_mm512_add_ps(_mm512_set1_ps(table.ppy[s]), _mm512_mul_ps(dpy, u)), _mm512_div_ps(_mm512_mul_ps(dpx, v), lengthPrime));
+
+				__m512 XminusQx = _mm512_sub_ps(X, _mm512_set1_ps(table.qx[s]));
+				__m512 XminusQy = _mm512_sub_ps(Y, _mm512_set1_ps(table.qy[s]));
+				__m512 distP = _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(XminusPx, XminusPx), _mm512_mul_ps(XminusPy, XminusPy)));
+				__m512 distQ = _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(XminusQx, XminusQx), _mm512_mul_ps(XminusQy, XminusQy)));
+				__m512 dist = _mm512_abs_ps(v);
+				dist = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(u, zero, _CMP_LT_OQ), dist, distP);
+				dist = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(u, one, _CMP_GT_OQ), dist, distQ);
+
+				__m512 weight = powAvx512(_mm512_div_ps(_mm512_set1_ps(float(table.lengthPow[s])), _mm512_add_ps(aVec, dist)), powInt, powHalf);
+				dsumX = _mm512_add_ps(dsumX, _mm512_mul_ps(_mm512_sub_ps(localXprimeX, X), weight));
+				dsumY = _mm512_add_ps(dsumY, _mm512_mul_ps(_mm512_sub_ps(localXprimeY, Y), weight));
+				weightsum = _mm512_add_ps(weightsum, weight);
+
+				if (second){ // same u, v and weight, the source segment of the second table
+					__m512 dpx2 = _mm512_set1_ps(second->dpx[s]);
+					__m512 dpy2 = _mm512_set1_ps(second->dpy[s]);
+					__m512 lengthPrime2 = _mm512_set1_ps(second->lengthPrime[s]);
+					__m512 localXprimeX2 = _mm512_sub_ps(_mm512_add_ps(_mm512_set1_ps(second->ppx[s]), _mm512_mul_ps(dpx2, u)), _mm512_div_ps(_mm512_mul_ps(dpy2, v), lengthPrime2));
+					__m512 localXprimeY2 = _mm512_add_ps(_mm512_add_ps(_mm512_set1_ps(second->ppy[s]), _mm512_mul_ps(dpy2, u)), _mm512_div_ps(_mm512_mul_ps(dpx2, v), lengthPrime2));
+					dsumX2 = _mm512_add_ps(dsumX2, _mm512_mul_ps(_mm512_sub_ps(localXprimeX2, X), weight));
+					dsumY2 = _mm512_add_ps(dsumY2, _mm512_mul_ps(_mm512_sub_ps(localXprimeY2, Y), weight));
+					weightsum2 = _mm512_add_ps(weightsum2, weight);
+				}
+			}
+
+			__m512 resultX = _mm512_add_ps(X, _mm512_div_ps(dsumX, weightsum));
+			__m512 resultY = _mm512_add_ps(Y, _mm512_div_ps(dsumY, weightsum));
+			int valid = colEnd - col; // lanes inside the region, the last vector of a row may be partial
+			__mmask16 storeMask = (valid >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1 << valid) - 1);
+			_mm512_mask_storeu_ps(rowX + (col - colStart), storeMask, resultX);
+			_mm512_mask_storeu_ps(rowY + (col - colStart), storeMask, resultY);
+			if (second){
+				_mm512_mask_storeu_ps(rowX2 + (col - colStart), storeMask, _mm512_add_ps(X, _mm512_div_ps(dsumX2, weightsum2)));
+				_mm512_mask_storeu_ps(rowY2 + (col - colStart), storeMask, _mm512_add_ps(Y, _mm512_div_ps(dsumY2, weightsum2)));
+			}
+		}
+	}
+}
+
+#endif
+
+//================================================
+/*
+displaceRegionSimd(int lanes, SegmentTable& table, SegmentTable* second, double a, double b,
+		   int rowStart, int rowEnd, int colStart, int colEnd, float* sourceX, float* sourceY,
+		   float* secondX, float* secondY)
+
+* PURPOSE: compute, with the vector kernel of the given width, the position X' in the source image
+*          of every pixel X of a region. Callers must check simdWidthAvailable() and
+*          simdSupportsExponent(b) first.
+* INPUTS: param -- int lanes -- 8 for the AVX2 kernel, 16 for the AVX-512 kernel
+*         param -- SegmentTable& table -- segment pairs of the warp, with their constants
+*         param -- SegmentTable* second -- NULL, or a table with the same destination segments
+*                  and other source segments, whose X' is computed with the same weights
+*         param -- double a, b -- weight constants, weight = (length^c / (a + dist))^b
+*         param -- int rowStart, rowEnd, colStart, colEnd -- region, end values exclusive
+*         param -- float* sourceX, sourceY -- output, (rowEnd - rowStart) * (colEnd - colStart)
+*                  values each, row by row
+*         param -- float* secondX, secondY -- output for second, same layout, unused if NULL
+* OUTPUTS: none
+*/
+//================================================
+void displaceRegionSimd(int lanes, SegmentTable& table, SegmentTable* second, double a, double b,
+		int rowStart, int rowEnd, int colStart, int colEnd, float* sourceX, float* sourceY,
+		float* secondX, float* secondY){
+	int powInt = int(floor(b));
+	bool powHalf = (b - powInt) > 0;
+
+#ifdef MORPHER_X86_SIMD
+	if (lanes == 16){
+		displaceRegionAvx512(table, second, a, powInt, powHalf, rowStart, rowEnd, colStart, colEnd, sourceX, sourceY, secondX, secondY);
+	}
+	else if (lanes == 8){
+		displaceRegionAvx2(table, second, a, powInt, powHalf, rowStart, rowEnd, colStart, colEnd, sourceX, sourceY, secondX, secondY);
+	}
+#endif
+}
@@ -0,0 +1,34 @@
+// WarpSimd.h
+//
+// Vectorized Beier-Neely displacement kernels. Instead of one pixel at a time, the kernels
+// evaluate 8 (AVX2) or 16 (AVX-512) pixels of a row against each segment of a SegmentTable,
+// computing u, v, the distance, the weight and the weighted displacement in vector registers.
+// The kernel is chosen at run time from what the processor supports, so the program still
+// runs (with the scalar warp) on machines without these instruction sets.
+//
+// The kernels compute in single precision, the scalar warp computes the weights in double
+// precision, so a few pixels whose source position lies right on a pixel boundary may take
+// their color from the neighbouring source pixel.
+//
+#include <iostream>
+#include "SegmentTable.h"
+using namespace std;
+
+#ifndef WARPSIMD
+#define WARPSIMD
+
+// pixels per vector of the widest kernel this machine can run: 16, 8, or 0 if none
+int simdWidthAvailable(void);
+
+// true if the kernels can raise weights to the power b (multiples of 0.5 from 0 to 8)
+bool simdSupportsExponent(double b);
+
+// compute the source position X' of every pixel in rows [rowStart, rowEnd) and columns
+// [colStart, colEnd), stored row by row in sourceX/sourceY. lanes is 8 or 16. If second is
+// not NULL (a table with the same destination segments), its X' is computed too, from the
+// same weights, into secondX/secondY.
+void displaceRegionSimd(int lanes, SegmentTable& table, SegmentTable* second, double a, double b,
+		int rowStart, int rowEnd, int colStart, int colEnd, float* sourceX, float* sourceY,
+		float* secondX, float* secondY);
+
+#endif
@@ -0,0 +1,583 @@
+// bench.cpp
+//
+// Headless benchmark of the stages of the morph, built and run by "make bench". Each benchmark
+// times one stage and reports it per pixel:
+//  fill/...     Pixmap::fillPixmap, 1 and 3 channel images expanded to RGBA (one thread)
+//  warp/...     warpRegion of a whole frame onto a set of segments (thread pool)
+//  dissolve/... dissolveRegion of two whole frames (one thread)
+//  read/...     readMultiImages of a bundled pair, decode included
+//  morph/...    FrameGenerator::renderFrame of the middle frame of a bundled pair (thread pool)
+//  write/...    writeMultiImages of the frames of a bundled pair as png files
+//  layout/...   warpRegion of a whole frame rotated by 90 degrees (each row of a tile reads a
+//               column of the source) from a Pixmap (rows) and a TiledPixmap (tiled), on one
+//               thread, with the cache and TLB misses per pixel where the processor counters
+//               can be read (perf_event_open)
+// on synthetic images of 512x512, 2K (2048x1080) and 4K (3840x2160) with 10 to 500 random
+// segments, and on the bundled freud/khalo and han/leia pairs with their segment files.
+//
+// The results are printed to standard output as JSON (ns per pixel, pixels per second,
+// segment-pixels per second for the warps, peak resident memory), a table goes to standard
+// error. Given a baseline (the JSON of an earlier run) every benchmark slower than the baseline
+// by more than the tolerance is flagged and the exit status is 1.
+//
+// usage: morpher_bench [morpher options, ex. -t 4 -simd 0 -cull 0.01] [-quick]
+//                      [-baseline file.json] [-tolerance fraction]
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "Pixel.h"
+#include "Pixmap.h"
+#include "Segment.h"
+#include "SegmentTable.h"
+#include "ThreadPool.h"
+#include "Warp.h"
+#include "WarpSimd.h"
+#include "FrameGenerator.h"
+#include "FrameEncoder.h"
+#include "TiledPixmap.h"
+#include "Trace.h"
+using namespace std;
+
+// from morpher.cpp, built without its main (morpher_nomain.o)
+extern Pixmap* pmArray;
+extern int numPixmaps;
+extern bool headless;
+extern int numThreads;
+extern ThreadPool* pool;
+extern string traceFilename;
+void parseOptions(int& argc, char* argv[]);
+void readMultiImages(int argc, char* argv[]);
+void readTextFile(string textFilename);
+void writeMultiImages(string outfilename);
+
+// one timed benchmark
+struct BenchResult{
+	string name;
+	long pixels; // pixels processed by one run
+	long segments; // segments each pixel is warped by, 0 for the other stages
+	int threads; // threads the stage ran on
+	double seconds; // fastest run
+	double peakRssMb; // peak resident memory of the process after the benchmark
+	double cacheMisses; // last level cache misses per pixel of one run, -1 if not measured
+	double tlbMisses; // data TLB misses per pixel of one run, -1 if not measured
+};
+
+// discards what is written to it, so the messages of writeImage stay out of the JSON.
+// Keeps no state, so the encoder threads can write to it at once
+class NullBuffer : public streambuf{
+	protected:
+		int overflow(int c){
+			return c;
+		}
+};
+
+//================================================
+/*
+peakRssMb()
+
+* PURPOSE: peak resident memory of the process so far
+* INPUTS: none
+* OUTPUTS: double, megabytes
+*/
+//================================================
+static double peakRssMb(void){
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0; // kilobytes on Linux
+}
+
+//================================================
+/*
+timeRuns(function<void()> run, double minSeconds)
+
+* PURPOSE: run a benchmark at least 3 times and until minSeconds have passed (a slow benchmark
+*          stops after one run past minSeconds), and time the fastest run, the one least
+*          disturbed by the rest of the machine
+* INPUTS: param -- function<void()> run -- one run of the benchmark
+*         param -- double minSeconds -- least total time to spend
+* OUTPUTS: double, seconds of the fastest run
+*/
+//================================================
+static double timeRuns(function<void()> run, double minSeconds){
+	double best = 1e30;
+	double total = 0;
+	for (int runs = 0; runs < 3 || total < minSeconds; runs++){
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		run();
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		best = min(best, seconds);
+		total = total + seconds;
+		if (total >= minSeconds && seconds >= minSeconds){
+			break;
+		}
+	}
+	return best;
+}
+
+//================================================
+/*
+addResult(vector<BenchResult>& results, string name, long pixels, long segments, int threads,
+	  double seconds, double cacheMisses, double tlbMisses)
+
+* PURPOSE: record a result and print it to the table on standard error
+* INPUTS: param -- vector<BenchResult>& results -- results so far
+*         param -- string name, long pixels, long segments, int threads, double seconds,
+*                  cacheMisses, tlbMisses -- see BenchResult
+* OUTPUTS: none
+*/
+//================================================
+static void addResult(vector<BenchResult>& results, string name, long pixels, long segments, int threads,
+		double seconds, double cacheMisses = -1, double tlbMisses = -1){
+	BenchResult result = {name, pixels, segments, threads, seconds, peakRssMb(), cacheMisses, tlbMisses};
+	results.push_back(result);
+	fprintf(stderr, "%-28s %10.3f ms %9.3f ns/pixel %8.1f Mpixel/s", name.c_str(), seconds * 1000,
+		(seconds * 1e9) / pixels, pixels / seconds / 1e6);
+	if (segments > 0){
+		fprintf(stderr, " %8.1f Gsegpixel/s", (double(segments) * pixels) / seconds / 1e9);
+	}
+	if (cacheMisses >= 0){
+		fprintf(stderr, " %7.3f cache misses/pixel %7.3f TLB misses/pixel", cacheMisses, tlbMisses);
+	}
+	fprintf(stderr, "\n");
+}
+
+//================================================
+/*
+syntheticImage(int width, int height, unsigned int seed)
+
+* PURPOSE: make a test image with smooth gradients, edges and noise, so warps and encoders see
+*          something like a photograph rather than a flat color
+* INPUTS: param -- int width, height -- size
+*         param -- unsigned int seed -- noise seed
+* OUTPUTS: Pixmap, the image
+*/
+//================================================
+static Pixmap syntheticImage(int width, int height, unsigned int seed){
+	Pixmap image(width, height);
+	Pixel** pixels = image.getPmPointer();
+	srand(seed);
+	for (int row = 0; row < height; row++){
+		for (int col = 0; col < width; col++){
+			int noise = rand() % 32;
+			unsigned char r = (255 * col) / width;
+			unsigned char g = (255 * row) / height;
+			unsigned char b = (((col / 64) + (row / 64)) % 2 == 0) ? 200 : 40;
+			pixels[row][col].setAllVals(r ^ noise, g ^ noise, b ^ noise, 255);
+		}
+	}
+	return image;
+}
+
+//================================================
+/*
+syntheticSegments(int count, int width, int height, unsigned int seed, vector<Segment>& source,
+		  vector<Segment>& dest)
+
+* PURPOSE: make count random segment pairs inside an image, each destination segment moved a
+*          little from its source segment, like the features of two faces
+* INPUTS: param -- int count -- number of pairs
+*         param -- int width, height -- size of the image
+*         param -- unsigned int seed -- random seed
+*         param -- vector<Segment>& source, dest -- filled with the pairs, matching ids
+* OUTPUTS: none
+*/
+//================================================
+static void syntheticSegments(int count, int width, int height, unsigned int seed, vector<Segment>& source,
+		vector<Segment>& dest){
+	srand(seed);
+	source.clear();
+	dest.clear();
+	for (int i = 0; i < count; i++){
+		float x = rand() % width;
+		float y = rand() % height;
+		float dx = (rand() % 81) - 40; // segments 5 to 60 pixels long
+		float dy = (rand() % 81) - 40;
+		if (abs(dx) + abs(dy) < 5){
+			dx = 5;
+		}
+		float shiftX = (rand() % 21) - 10;
+		float shiftY = (rand() % 21) - 10;
+		stringstream id;
+		id << "s" << i;
+		source.push_back(Segment(x, y, x + dx, y + dy, id.str()));
+		dest.push_back(Segment(x + shiftX, y + shiftY, x + dx + shiftX, y + dy + shiftY, id.str()));
+	}
+}
+
+//================================================
+/*
+benchSynthetic(vector<BenchResult>& results, string sizeName, int width, int height,
+	       vector<int>& segmentCounts, double minSeconds)
+
+* PURPOSE: fill, warp and dissolve benchmarks on synthetic images of one size
+* INPUTS: param -- vector<BenchResult>& results -- results so far
+*         param -- string sizeName -- name of the size in the results (ex. "4K")
+*         param -- int width, height -- size of the images
+*         param -- vector<int>& segmentCounts -- segment counts of the warp benchmarks
+*         param -- double minSeconds -- least time to spend on each benchmark
+* OUTPUTS: none
+*/
+//================================================
+static void benchSynthetic(vector<BenchResult>& results, string sizeName, int width, int height,
+		vector<int>& segmentCounts, double minSeconds){
+	long pixels = long(width) * height;
+	Pixmap imageX = syntheticImage(width, height, 1);
+	Pixmap imageY = syntheticImage(width, height, 2);
+	Pixmap out(width, height);
+
+	// decoded images as OIIO leaves them, 1 and 3 channels per pixel
+	vector<unsigned char> channels(pixels * 3);
+	for (long i = 0; i < channels.size(); i++){
+		channels[i] = (i * 7) & 255;
+	}
+	for (int numChannels = 1; numChannels <= 3; numChannels += 2){
+		double seconds = timeRuns([&](){ out.fillPixmap(&channels[0], numChannels); }, minSeconds);
+		addResult(results, "fill/" + string(numChannels == 1 ? "grey/" : "rgb/") + sizeName, pixels, 0, 1, seconds);
+	}
+
+	int tilesAcross = (width + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesDown = (height + TILE_SIZE - 1) / TILE_SIZE;
+	for (int s = 0; s < segmentCounts.size(); s++){
+		vector<Segment> source, dest;
+		syntheticSegments(segmentCounts[s], width, height, 3 + s, source, dest);
+		SegmentTable table;
+		buildSegmentTable(table, source, dest, warpSettings.c);
+		double seconds = timeRuns([&](){
+			pool->parallelFor(tilesAcross * tilesDown, [&](int tile){
+				int rowStart = (tile / tilesAcross) * TILE_SIZE;
+				int colStart = (tile % tilesAcross) * TILE_SIZE;
+				warpRegion(imageX, table, out, rowStart, min(rowStart + TILE_SIZE, height),
+					colStart, min(colStart + TILE_SIZE, width));
+			});
+		}, minSeconds);
+		stringstream name;
+		name << "warp/" << sizeName << "/" << segmentCounts[s] << "seg";
+		addResult(results, name.str(), pixels, segmentCounts[s], pool->getNumThreads(), seconds);
+	}
+
+	double seconds = timeRuns([&](){ dissolveRegion(imageX, imageY, out, 0.3, 0, height, 0, width); }, minSeconds);
+	addResult(results, "dissolve/" + sizeName, pixels, 0, 1, seconds);
+}
+
+//================================================
+/*
+openCounter(unsigned int type, unsigned long config)
+
+* PURPOSE: start counting a hardware event of the calling thread (user space only)
+* INPUTS: param -- unsigned int type, unsigned long config -- the event, see perf_event_open(2)
+* OUTPUTS: int, file descriptor of the counter, -1 if the processor or the system does not
+*          allow it (ex. in most virtual machines)
+*/
+//================================================
+static int openCounter(unsigned int type, unsigned long config){
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+//================================================
+/*
+countMisses(function<void()> run, long pixels, double& cacheMisses, double& tlbMisses)
+
+* PURPOSE: count the last level cache and data TLB misses of one run on the calling thread
+* INPUTS: param -- function<void()> run -- one run of the benchmark, on the calling thread only
+*         param -- long pixels -- pixels of one run
+*         param -- double& cacheMisses, tlbMisses -- set to the misses per pixel, -1 for a
+*                  counter that cannot be read
+* OUTPUTS: none
+*/
+//================================================
+static void countMisses(function<void()> run, long pixels, double& cacheMisses, double& tlbMisses){
+	int cache = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	int tlb = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		(PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	run();
+	long count = 0;
+	cacheMisses = (cache >= 0 && read(cache, &count, sizeof(count)) == sizeof(count)) ? double(count) / pixels : -1;
+	tlbMisses = (tlb >= 0 && read(tlb, &count, sizeof(count)) == sizeof(count)) ? double(count) / pixels : -1;
+	if (cache >= 0){
+		close(cache);
+	}
+	if (tlb >= 0){
+		close(tlb);
+	}
+}
+
+//================================================
+/*
+benchLayouts(vector<BenchResult>& results, string sizeName, int width, int height,
+	     double minSeconds)
+
+* PURPOSE: compare the source layouts of the warp where the gathers are least local: the
+*          destination segments are the source segments turned by 90 degrees about the centre
+*          of the image, so a row of an output tile reads a column of the source. Runs on one
+*          thread so the misses of the whole warp are counted, and checks that both layouts
+*          give the same pixels.
+* INPUTS: param -- vector<BenchResult>& results -- results so far
+*         param -- string sizeName -- name of the size in the results (ex. "4K")
+*         param -- int width, height -- size of the image
+*         param -- double minSeconds -- least time to spend on each benchmark
+* OUTPUTS: none
+*/
+//================================================
+static void benchLayouts(vector<BenchResult>& results, string sizeName, int width, int height, double minSeconds){
+	long pixels = long(width) * height;
+	Pixmap image = syntheticImage(width, height, 4);
+	TiledPixmap tiled(image);
+	vector<Segment> source, dest;
+	syntheticSegments(10, width, height, 5, source, dest);
+	float centreX = width / 2.0;
+	float centreY = height / 2.0;
+	for (int i = 0; i < source.size(); i++){ // (x, y) -> (centreX - (y - centreY), centreY + (x - centreX))
+		Vector2D start = source[i].getStartVect();
+		Vector2D end = source[i].getEndVect();
+		dest[i] = Segment(centreX - (start.y - centreY), centreY + (start.x - centreX),
+			centreX - (end.y - centreY), centreY + (end.x - centreX), source[i].getId());
+	}
+	SegmentTable table;
+	buildSegmentTable(table, source, dest, warpSettings.c);
+
+	Pixmap out[2] = {Pixmap(width, height), Pixmap(width, height)};
+	for (int layout = 0; layout < 2; layout++){
+		out[layout].fillSolidColor(0, 0, 0, 255);
+		function<void()> run = [&](){
+			for (int row = 0; row < height; row += TILE_SIZE){
+				for (int col = 0; col < width; col += TILE_SIZE){
+					if (layout == 0){
+						warpRegion(image, table, out[layout], row, min(row + TILE_SIZE, height), col, min(col + TILE_SIZE, width));
+					}
+					else{
+						warpRegion(tiled, table, out[layout], row, min(row + TILE_SIZE, height), col, min(col + TILE_SIZE, width));
+					}
+				}
+			}
+		};
+		double seconds = timeRuns(run, minSeconds);
+		double cacheMisses, tlbMisses;
+		countMisses(run, pixels, cacheMisses, tlbMisses);
+		addResult(results, "layout/" + sizeName + (layout == 0 ? "/rows" : "/tiled"), pixels, table.count, 1,
+			seconds, cacheMisses, tlbMisses);
+	}
+	if (memcmp(out[0].getDataPointer(), out[1].getDataPointer(), pixels * sizeof(Pixel)) != 0){
+		fprintf(stderr, "layout/%s: the tiled warp differs from the row warp\n", sizeName.c_str());
+	}
+}
+
+//================================================
+/*
+benchPair(vector<BenchResult>& results, string pairName, string imageA, string imageB,
+	  string segmentFile, string outDir, double minSeconds)
+
+* PURPOSE: read, morph and write benchmarks on a bundled pair of images, through the functions
+*          the program itself uses
+* INPUTS: param -- vector<BenchResult>& results -- results so far
+*         param -- string pairName -- name of the pair in the results
+*         param -- string imageA, imageB, segmentFile -- the bundled files
+*         param -- string outDir -- directory the written frames go to
+*         param -- double minSeconds -- least time to spend on each benchmark
+* OUTPUTS: none
+*/
+//================================================
+static void benchPair(vector<BenchResult>& results, string pairName, string imageA, string imageB,
+		string segmentFile, string outDir, double minSeconds){
+	char program[] = "morpher_bench";
+	char* imageArgs[3] = {program, (char*)imageA.c_str(), (char*)imageB.c_str()};
+	double seconds = timeRuns([&](){ readMultiImages(3, imageArgs); }, minSeconds);
+	long pixels = long(pmArray[0].getWidth()) * pmArray[0].getHeight();
+	addResult(results, "read/" + pairName, 2 * pixels, 0, 1, seconds);
+
+	readTextFile(segmentFile);
+	vector<Pixmap*> images;
+	images.push_back(&pmArray[0]);
+	images.push_back(&pmArray[1]);
+	vector<float> times = evenTimes(3);
+	FrameGenerator generator(images, times, pool);
+	Pixmap frame;
+	seconds = timeRuns([&](){ generator.renderFrame(1, frame); }, minSeconds);
+	addResult(results, "morph/" + pairName, pixels, pmArray[0].getNumSegments(), pool->getNumThreads(), seconds);
+
+	NullBuffer discard; // writeImage reports every file on cout
+	streambuf* console = cout.rdbuf(&discard);
+	seconds = timeRuns([&](){ writeMultiImages(outDir + "/" + pairName); }, minSeconds);
+	cout.rdbuf(console);
+	addResult(results, "write/" + pairName, numPixmaps * pixels, 0, pool->getNumThreads(), seconds);
+	for (int i = 0; i < numPixmaps; i++){
+		remove(frameFilename(outDir + "/" + pairName, i).c_str());
+	}
+}
+
+//================================================
+/*
+printJson(ostream& out, vector<BenchResult>& results)
+
+* PURPOSE: print the results as JSON, one benchmark per line (readBaseline relies on it)
+* INPUTS: param -- ostream& out -- where to print
+*         param -- vector<BenchResult>& results -- the results
+* OUTPUTS: none
+*/
+//================================================
+static void printJson(ostream& out, vector<BenchResult>& results){
+	out << "{" << endl;
+	out << "  \"threads\": " << pool->getNumThreads() << "," << endl;
+	out << "  \"simd_width\": " << ((warpSettings.simdWidth < 0) ? simdWidthAvailable() : warpSettings.simdWidth) << "," << endl;
+	out << "  \"peak_rss_mb\": " << peakRssMb() << "," << endl;
+	out << "  \"results\": [" << endl;
+	for (int i = 0; i < results.size(); i++){
+		BenchResult& r = results[i];
+		out << "    {\"name\": \"" << r.name << "\", \"pixels\": " << r.pixels << ", \"segments\": " << r.segments
+		    << ", \"threads\": " << r.threads << ", \"seconds\": " << r.seconds
+		    << ", \"ns_per_pixel\": " << (r.seconds * 1e9) / r.pixels
+		    << ", \"pixels_per_s\": " << r.pixels / r.seconds
+		    << ", \"segment_pixels_per_s\": " << (double(r.segments) * r.pixels) / r.seconds
+		    << ", \"peak_rss_mb\": " << r.peakRssMb;
+		out << ", \"cache_misses_per_pixel\": "; // null if not measured or the counter could not be read
+		(r.cacheMisses >= 0) ? (out << r.cacheMisses) : (out << "null");
+		out << ", \"tlb_misses_per_pixel\": ";
+		(r.tlbMisses >= 0) ? (out << r.tlbMisses) : (out << "null");
+		out << "}" << ((i + 1 < results.size()) ? "," : "") << endl;
+	}
+	out << "  ]" << endl;
+	out << "}" << endl;
+}
+
+//================================================
+/*
+readBaseline(string filename, map<string, double>& nsPerPixel)
+
+* PURPOSE: read the ns per pixel of every benchmark from the JSON of an earlier run
+* INPUTS: param -- string filename -- output of an earlier run
+*         param -- map<string, double>& nsPerPixel -- filled, by benchmark name
+* OUTPUTS: bool, false if the file could not be read
+*/
+//================================================
+static bool readBaseline(string filename, map<string, double>& nsPerPixel){
+	ifstream file(filename.c_str());
+	if (file.fail()){
+		return false;
+	}
+	string line;
+	while (getline(file, line)){
+		string::size_type name = line.find("\"name\": \"");
+		string::size_type value = line.find("\"ns_per_pixel\": ");
+		if (name == string::npos || value == string::npos){
+			continue;
+		}
+		name = name + 9;
+		string key = line.substr(name, line.find('"', name) - name);
+		nsPerPixel[key] = atof(line.c_str() + value + 16);
+	}
+	return true;
+}
+
+//================================================
+/*
+main(int argc, char* argv[])
+
+* PURPOSE: run the benchmarks, print the JSON and compare with a baseline if one is given
+* INPUTS: param -- int argc, char* argv[] -- command line, see the top of the file
+* OUTPUTS: int, 1 if a benchmark regressed or the arguments are wrong, else 0
+*/
+//================================================
+int main(int argc, char* argv[]){
+	parseOptions(argc, argv); // -t, -simd, -approx, -cull ... as for morpher
+	bool quick = false;
+	string baseline = "";
+	double tolerance = 0.10;
+	for (int i = 1; i < argc; i++){
+		if (strcmp(argv[i], "-quick") == 0){
+			quick = true;
+		}
+		else if (strcmp(argv[i], "-baseline") == 0 && i + 1 < argc){
+			baseline = argv[i + 1];
+			i = i + 1;
+		}
+		else if (strcmp(argv[i], "-tolerance") == 0 && i + 1 < argc){
+			tolerance = atof(argv[i + 1]);
+			i = i + 1;
+		}
+		else{
+			cerr << "usage: " << argv[0] << " [morpher options] [-quick] [-baseline file.json] [-tolerance fraction]" << endl;
+			return 1;
+		}
+	}
+	if (traceFilename != "" && !startTracing(traceFilename)){
+		cerr << "Could not write trace " << traceFilename << endl;
+		return 1;
+	}
+	headless = true;
+	pool = new ThreadPool(numThreads);
+
+	double minSeconds = quick ? 0.05 : 0.5;
+	vector<int> segmentCounts;
+	segmentCounts.push_back(10);
+	segmentCounts.push_back(100);
+	if (!quick){
+		segmentCounts.push_back(500);
+	}
+
+	vector<BenchResult> results;
+	benchSynthetic(results, "512", 512, 512, segmentCounts, minSeconds);
+	benchSynthetic(results, "2K", 2048, 1080, segmentCounts, minSeconds);
+	if (!quick){
+		benchSynthetic(results, "4K", 3840, 2160, segmentCounts, minSeconds);
+	}
+	benchLayouts(results, "2K", 2048, 1080, minSeconds);
+	if (!quick){
+		benchLayouts(results, "4K", 3840, 2160, minSeconds);
+		benchLayouts(results, "8K", 7680, 4320, minSeconds);
+	}
+
+	char outDir[] = "/tmp/morpher_benchXXXXXX";
+	if (mkdtemp(outDir) == NULL){
+		cerr << "Could not create a directory for the written frames." << endl;
+		return 1;
+	}
+	benchPair(results, "freud_khalo", "freud.jpg", "khalo.jpg", "freud_khalo_segments", outDir, minSeconds);
+	benchPair(results, "han_leia", "han.jpg", "leia.jpg", "han_leia_segments", outDir, minSeconds);
+	rmdir(outDir);
+
+	printJson(cout, results);
+
+	if (baseline == ""){
+		return 0;
+	}
+	map<string, double> before;
+	if (!readBaseline(baseline, before)){
+		cerr << "Could not read baseline " << baseline << endl;
+		return 1;
+	}
+	int regressions = 0;
+	for (int i = 0; i < results.size(); i++){
+		if (before.count(results[i].name) == 0){
+			continue;
+		}
+		double now = (results[i].seconds * 1e9) / results[i].pixels;
+		double was = before[results[i].name];
+		if (now > was * (1 + tolerance)){
+			fprintf(stderr, "REGRESSION %-28s %9.3f ns/pixel, baseline %9.3f (+%.0f%%)\n", results[i].name.c_str(),
+				now, was, ((now / was) - 1) * 100);
+			regressions = regressions + 1;
+		}
+	}
+	fprintf(stderr, "%d regression(s) against %s (tolerance %.0f%%)\n", regressions, baseline.c_str(), tolerance * 100);
+	return (regressions > 0) ? 1 : 0;
+}
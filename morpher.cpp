@@ -34,12 +34,30 @@ The program's morphing process consists of four major steps:
 #include <OpenImageIO/imageio.h>
 #include <iostream>
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
+#include <sstream>
 #include <vector>
+#include <chrono>
 #include <math.h>
 #include "Segment.h"
 #include "Pixel.h"
 #include "Pixmap.h"
+#include "ThreadPool.h"
+#include "SegmentTable.h"
+#include "Warp.h"
+#include "FrameGenerator.h"
+#include "VideoWriter.h"
+#include "FrameEncoder.h"
+#include "PixelPool.h"
+#include "Trace.h"
+#include "ImageCache.h"
+#include "JobScheduler.h"
+#include "MorphServer.h"
+#include "FrameTextures.h"
+#include "LazyFrames.h"
+#include "FrameRegion.h"
 
 #ifdef __APPLE__
 #  pragma clang diagnostic ignored "-Wdeprecated-declarations"
@@ -59,9 +77,182 @@ OIIO_NAMESPACE_USING
 bool hasReadImage = false; // defines whether an image has been successfully read and stored
 int numPixmaps = 0; // in cases of multiple images, defines the number of images stored
 int currentIndex = 0; // in cases of multiple images index of the currently displayed pixmap
-Pixmap currentPm; // current pixmap being displayed, set when pixmap(s) is read and stored
-Pixmap* pmArray; // in cases of multiple images, pointer to array which contains all pixmaps
+int numIntermImages = 3; // number of in-between frames generated between each pair of source images
+bool headless = false; // true when running the batch pipeline, no GLUT window exists and GL calls are skipped
+int numThreads = 0; // threads used to render, set with "-t n", 0 uses one thread per core
+ThreadPool* pool; // worker threads shared by the rendering stages, created in main
+string frameTimes = ""; // batch mode: explicit comma separated frame times, set with "-times list"
+string easing = "linear"; // batch mode: easing curve of evenly spaced frame times, set with "-ease curve"
+string outputFormat = ""; // batch mode: png, y4m, y4m444 or rgba, set with "-format f", chosen from the output name if empty
+int framesPerSecond = 30; // batch mode: frame rate of a y4m stream, set with "-fps n"
+int compressionLevel = 6; // zlib level of written png files, 0 (fastest) to 9 (smallest), set with "-compress n"
+int numEncoders = 0; // threads writing image files, set with "-encoders n", 0 uses one thread per core
+string traceFilename = ""; // Chrome trace JSON of the stages, written at exit, set with "-trace file"
+string imageCacheDir = ""; // directory of the decoded image cache, set with "-cache dir", no cache if empty
+long imageCacheMB = 1024; // size limit of the decoded image cache in megabytes, set with "-cachesize n"
+long largeJobPixels = 1048576; // manifest mode: frame size from which a job renders across the pool, set with "-jobpixels n"
+long serverCacheMB = 512; // server mode: decoded images kept between requests in megabytes, set with "-servercache n"
+int playbackFps = 30; // frame rate of the playback in the display window ('p'), set with "-playfps n"
+long textureMB = 512; // texture memory the displayed frames may take in megabytes, set with "-texturemb n"
+FrameTextures* frameTextures = NULL; // frames of the display window kept as textures, created in main with the window
+bool playing = false; // true while the frames play in the display window
+chrono::steady_clock::time_point nextPlaybackFrame; // when the playback shows its next frame
+chrono::steady_clock::time_point fpsStart; // start of the second the achieved frame rate is counted over
+int fpsFrames = 0; // frames displayed since fpsStart
+LazyFrames* lazyFrames = NULL; // frames of the morph in the display window, rendered as they are shown, created by morph()
+int prefetchRadius = 2; // frames on each side of the shown one rendered ahead, set with "-prefetch n"
+int previewStep = 8; // block size of the preview a morphed frame shows first, set with "-preview n"
+bool refreshScheduled = false; // true while a redisplay of the frame being rendered is pending
+float editTolerance = 0.25; // movement in pixels of a source position a segment edit leaves unrendered, set with "-edittol px"
+string regionRectangle = ""; // part of the frames rendered, "x,y,width,height", set with "-roi rect", whole frames if empty
+string regionMask = ""; // image whose red channel narrows that part to the pixels it covers, set with "-mask file"
+bool regionCrop = false; // batch mode: frames cropped to the rectangle of the region, set with "-crop"
+string regionFill = "0,0,0,255"; // color of the pixels outside the region, set with "-roifill r,g,b[,a]"
+Pixmap* currentPm = NULL; // current pixmap being displayed (an element of pmArray), set when pixmap(s) is read and stored
+Pixmap* pmArray = NULL; // in cases of multiple images, pointer to array which contains all pixmaps, owned here
 vector<float> newSeg; // holds coordinates of new segment when user clicks to draw segment
+//===============================================================================================
+/*
+readImage(string infilename, Pixmap& image)
+
+* PURPOSE : Read one image file into a pixmap of 4 channels, its filename set. With an image
+*           cache (-cache) the decoded pixels of an earlier run are mapped straight from the
+*           cache, and a decoded image is stored there for the next run. Safe to call from
+*           several threads at once (see JobScheduler).
+* INPUTS :  param -- string infilename, the image file
+*           param -- Pixmap& image, receives the image
+*           global -- imageCacheDir, imageCacheMB, the image cache
+* OUTPUTS : bool, false (with a message) if the image could not be read
+*/
+//===============================================================================================
+bool readImage(string infilename, Pixmap& image){
+
+  // a decoded image cached by an earlier run is mapped straight from the cache file
+  if (imageCacheDir != ""){
+    TraceScope load("cache load");
+    if (loadCachedImage(imageCacheDir, infilename, image)){
+      load.addPixels(long(image.getWidth()) * image.getHeight());
+      image.setFilename(infilename);
+      return true;
+    }
+  }
+  TraceScope decode("decode");
+
+  // open the image using OIIO
+  ImageInput *infile = ImageInput::open (infilename);
+  // error check
+  if(!infile){
+    cerr << "Could not open image " << infilename << ", error = " << geterror() << endl;
+    return false;
+  }
+
+  // get image information using OIIO class ImageSpec
+  const ImageSpec &spec = infile->spec();
+  int xres = spec.width;
+  int yres = spec.height;
+  int numChannels = spec.nchannels;
+
+  if (numChannels != 1 && numChannels != 3 && numChannels != 4){
+    cerr << "Could not read image " << infilename << ", " << numChannels << " channel images are not supported" << endl;
+    delete infile;
+    return false;
+  }
+
+  // read the image pixels into 8-bit integer unsigned char values straight into the memory of
+  // the pixmap, then expand them to 4 channels in place
+  image = Pixmap(xres,yres);
+  decode.addPixels(long(xres) * yres);
+  if (!infile->read_image(TypeDesc::UINT8, image.packedChannels(numChannels))){
+    cerr << "Could not read image " << infilename << ", error = " << infile->geterror() << endl;
+    delete infile;
+    return false;
+  }
+  image.expandChannels(numChannels);
+  image.setFilename(infilename);
+
+  infile->close();
+  delete infile;
+
+  if (imageCacheDir != ""){
+    TraceScope store("cache store", long(xres) * yres);
+    if (!storeCachedImage(imageCacheDir, imageCacheMB * 1048576, infilename, image)){
+      cerr << "Could not store " << infilename << " in the image cache " << imageCacheDir << endl;
+    }
+  }
+  return true;
+}
+
+//===============================================================================================
+/*
+readImageSize(string infilename, int& width, int& height)
+
+* PURPOSE : Find the size of an image file from its header, without decoding it
+* INPUTS :  param -- string infilename, the image file
+*           param -- int& width, height, receive the size
+* OUTPUTS : bool, false if the file could not be opened as an image
+*/
+//===============================================================================================
+bool readImageSize(string infilename, int& width, int& height){
+  ImageInput *infile = ImageInput::open (infilename);
+  if(!infile){
+    return false;
+  }
+  width = infile->spec().width;
+  height = infile->spec().height;
+  infile->close();
+  delete infile;
+  return true;
+}
+
+//===============================================================================================
+/*
+discardLazyFrames()
+
+* PURPOSE : Discard the frames of the last morph (see morph()), waiting for the frame being
+*           rendered ahead, before the images they render from change
+* INPUTS :  global -- lazyFrames, deleted and set to NULL
+* OUTPUTS : none
+*/
+//===============================================================================================
+void discardLazyFrames(){
+  delete lazyFrames;
+  lazyFrames = NULL;
+}
+
+//===============================================================================================
+/*
+readRegion(int width, int height, bool crop, FrameRegion& region, Pixmap& mask, string& error)
+
+* PURPOSE : Build the part of the frames to render from the region options (see FrameRegion.h):
+*           the rectangle of -roi, else the whole frame, with the fill color of -roifill, and
+*           read the mask image of -mask if there is one
+* INPUTS :  param -- int width, height; size of the images of the morph
+*           param -- bool crop; whether the frames are cropped to the rectangle
+*           param -- FrameRegion& region; receives the region, fit by FrameGenerator::setRegion
+*           param -- Pixmap& mask; receives the mask, left empty if there is none
+*           param -- string& error; receives why the options are not valid
+*           global -- regionRectangle, regionMask, regionFill, the options
+* OUTPUTS : bool, false if an option is not valid or the mask could not be read
+*/
+//===============================================================================================
+bool readRegion(int width, int height, bool crop, FrameRegion& region, Pixmap& mask, string& error){
+  region = wholeFrame(width, height);
+  if (regionRectangle != "" && !parseRectangle(regionRectangle, region)){
+    error = "Region " + regionRectangle + " is not x,y,width,height with a positive width and height.";
+    return false;
+  }
+  if (!parseColor(regionFill, region.fill)){
+    error = "Fill color " + regionFill + " is not r,g,b or r,g,b,a from 0 to 255.";
+    return false;
+  }
+  region.crop = crop;
+  if (regionMask != "" && !readImage(regionMask, mask)){
+    error = "Could not read the mask " + regionMask + ".";
+    return false;
+  }
+  return true;
+}
+
 //===============================================================================================
 /*
 readMultiImages(int argc, char* argv[])
@@ -89,124 +280,155 @@ void readMultiImages(int argc, char* argv[]){
   // set numPixmaps to the number of arguments - 1 to account for filenames and ignore the
   // program call
   // allocate space in array to store pixmaps 
+  TraceScope trace("readMultiImages");
   numPixmaps = argc - 1;
+  discardLazyFrames(); // they render from the earlier images
+  delete [] pmArray; // return the pixels of any earlier images to the pool
   pmArray = new Pixmap[numPixmaps];
+  if (frameTextures != NULL){ // the textures show the earlier images
+    frameTextures->clear();
+  }
   int pmIndex = 0;  
 
   // loop through the filenames given
   for (int i = 1; i < argc; i ++){
-  	string infilename = argv[i];
-
-    // open the image using OIIO
-	  ImageInput *infile = ImageInput::open (infilename);
-    // error check
-    if(!infile){
-      cerr << "Could not open image " << infilename << ", error = " << geterror() << endl;}
-	
-    // get image information using OIIO class ImageSpec
-	  const ImageSpec &spec = infile->spec();
-  	int xres = spec.width;
-  	int yres = spec.height;
-  	int numChannels = spec.nchannels;
-	
-    // declare memory in a 1D array using class Pixmap
-  	unsigned char* pointer = new unsigned char [xres*yres*numChannels]; // pointer to the array of image data
-
-    // read image pixels into 8-bit integer unsigned char values and store into pixmap
-  	infile->read_image(TypeDesc::UINT8, &pointer[0]);
-  
-  	Pixmap pm = Pixmap(xres,yres);
-  	pm.fillPixmap(pointer, numChannels); // transfer image color data into 4-channel pixmap
-	pm.setFilename(infilename);
-
-  
-	  // store pixmaps into array
-	  *(pmArray + pmIndex) = pm;
-	  pmIndex = pmIndex + 1;	
-	
-  	infile->close();
-  	delete infile;
+    if (!readImage(argv[i], pmArray[pmIndex])){
+      exit(1);
+    }
+    trace.addPixels(long(pmArray[pmIndex].getWidth()) * pmArray[pmIndex].getHeight());
+    pmIndex = pmIndex + 1;
   }
   
 // set hasReadImage to tell display and write functions that an image has been read
 // set currentPm to the first image that is given in the command line arguments, this will also
 // be the first to be displayed
 hasReadImage = true;
-currentPm = *(pmArray + 0);
+currentPm = pmArray + 0;
 currentIndex = 0;
 
 // reshape window to fit first image
-int xres = currentPm.getWidth();
-int yres = currentPm.getHeight();
-glutReshapeWindow(xres,yres);
+int xres = currentPm->getWidth();
+int yres = currentPm->getHeight();
+if (!headless){
+	glutReshapeWindow(xres,yres);
+}
 
 }
 
 //===============================================================================================
 /*
-writeMultiImages()
-
-* PURPOSE : Writes out the images in pmArray to separate files 
-* INPUTS :  param -- outfilename, name of the file before sequence added (ex. if outfilename = "img", prog
-*	    ram will write to "img0.png")
-* OUTPUTS : no returns, but downloads the written files to the current folder
+writeImage(Pixmap& pm, string filename)
+
+* PURPOSE : Write one pixmap to an image file, the format is chosen by OIIO from the extension.
+*           Safe to call from several threads at once (see FrameEncoder).
+* INPUTS :  param -- Pixmap& pm, image to write
+*           param -- string filename, name of the file to write
+*           global -- compressionLevel, zlib level of png files
+* OUTPUTS : bool, true if the image was written
 */
 //===============================================================================================
 
-void writeMultiImages(string outfilename){
-
-  for (int i = 0; i < numPixmaps; i++){
+bool writeImage(Pixmap& pm, string filename){
 
   // get size specs of the image to be written
-  int w = pmArray[i].getWidth();
-  int h = pmArray[i].getHeight();
-  std::ostringstream sin; // convert sequence number to a string
-  sin << i;
-  std::string val = sin.str();
-  string filename = outfilename.append(val); // append to base name given
-  filename = filename.append(".png");
+  int w = pm.getWidth();
+  int h = pm.getHeight();
+  TraceScope trace("encode", long(w) * h);
 
   // create the oiio file handler for the image
   ImageOutput *outfile = ImageOutput::create(filename);
   if(!outfile){
     cerr << "Could not create output image for " << filename << ", error = " << geterror() << endl;
-    return;
+    return false;
   }
-  #include <stdlib.h>
   // open a file for writing the image. The file header will indicate an image of
   // width w, height h, and 4 channels per pixel (RGBA). All channels will be of
   // type unsigned char
   ImageSpec spec(w, h, 4, TypeDesc::UINT8);
+  spec.x = pm.getOriginX(); // the data window of a cropped frame within its full frame
+  spec.y = pm.getOriginY();
+  spec.full_width = pm.getFullWidth();
+  spec.full_height = pm.getFullHeight();
+  spec.attribute("png:compressionLevel", compressionLevel);
   if(!outfile->open(filename, spec)){
-    cerr << "Could not open " << outfilename << ", error = " << geterror() << endl;
+    cerr << "Could not open " << filename << ", error = " << geterror() << endl;
     delete outfile;
-    return;
+    return false;
   }
 
   // write the image to the file. All channel values in the pixmap are taken to be
   // unsigned chars
 
-  Pixel* pointer = pmArray[i].getDataPointer();
+  Pixel* pointer = pm.getDataPointer();
   if(!outfile->write_image(TypeDesc::UINT8, &pointer[0])){
   	cerr << "Could not write image to " << filename << ", error = " << geterror() << endl;
     	delete outfile;	
-    	return;
+    	return false;
   }
   else{
-    // give notification to user if the image was output
-    cout << "Image "<<filename<<", was successfully stored" << endl;}
+    // give notification to user if the image was output, in one write so that the lines of
+    // images stored by different threads do not interleave
+    cout << ("Image " + filename + ", was successfully stored\n") << flush;}
   
   // close the image file after the image is written
   if(!outfile->close()){
     cerr << "Could not close " << filename << ", error = " << geterror() << endl;
     delete outfile;
-    return;
+    return false;
   }
 
 
   // free up space associated with the oiio file handler
   delete outfile;
+  return true;
 }
+
+//===============================================================================================
+/*
+writeMultiImages()
+
+* PURPOSE : Writes out the images in pmArray to separate files, encoded in parallel by a
+*           FrameEncoder
+* INPUTS :  param -- outfilename, name of the file before sequence added (ex. if outfilename = "img", prog
+*	    ram will write to "img0.png"), or a pattern such as "img%03d.png" (see frameFilename)
+*           After a morph the frames are those of lazyFrames, the ones not shown yet rendered
+*           here; before, an in-between (segments only) is written as a black image.
+*           global -- numEncoders, threads writing the files
+*           global -- lazyFrames, the frames of the morph
+* OUTPUTS : no returns, but downloads the written files to the current folder
+*/
+//===============================================================================================
+
+void writeMultiImages(string outfilename){
+  TraceScope trace("writeMultiImages");
+  string error;
+  if (!checkFramePattern(outfilename, error)){
+    cerr << error << endl;
+    return;
+  }
+
+  Pixmap black; // stands for the in-betweens, made the first time one is written
+  FrameEncoder encoder(numEncoders, 0, writeImage);
+  for (int i = 0; i < numPixmaps; i++){
+    Pixmap* frame = (lazyFrames != NULL) ? lazyFrames->getFrame(i) : &pmArray[i];
+    if (frame->getWidth() == 0 && black.getWidth() == 0){
+      black = Pixmap(pmArray[0].getWidth(), pmArray[0].getHeight());
+      black.fillSolidColor(0, 0, 0, 255);
+    }
+    if (frame->getWidth() == 0){
+      frame = &black;
+    }
+    string filename = frameFilename(outfilename, i);
+    if (filename == ""){
+      cerr << "The name of image " << i << " of " << outfilename << " is too long." << endl;
+      break;
+    }
+    encoder.writeBorrowed(*frame, filename);
+    trace.addPixels(long(frame->getWidth()) * frame->getHeight());
+  }
+  if (!encoder.finish()){
+    cerr << "Some images could not be written." << endl;
+  }
 }
 
 //===============================================================================================
@@ -255,11 +477,13 @@ if (direction == 1){
 }
 
 // set the current pixmap based on the current index
-// reshape window to fit the pixmap
-currentPm = *(pmArray + currentIndex);
-int xres = currentPm.getWidth();
-int yres = currentPm.getHeight();
-glutReshapeWindow(xres,yres);
+// reshape window to fit the pixmap, an in-between (only segments, no pixels) keeps the window
+currentPm = pmArray + currentIndex;
+int xres = currentPm->getWidth();
+int yres = currentPm->getHeight();
+if (xres > 0 && yres > 0){
+  glutReshapeWindow(xres,yres);
+}
 
 }
 
@@ -293,52 +517,67 @@ int getPmByName(string filename){
 }
 //===============================================================================================
 /*
-void readTextFile()
+void readTextFile(string textFilename)
 * PURPOSE : Read in segment information from a text file
-* INPUTS :  none, function reads in hard-coded filename for a ".txt" file
+* INPUTS :  param -- string textFilename, name of the segment file (the 'r' key reads "segments.txt")
 * OUTPUTS : none, adds segments to appropriate pixmap
 */
 //===============================================================================================
 
-void readTextFile(){
-   int numSegments;
-   string filename;
-   string id;
-   float startX;
-   float startY;
-   float endX;
-   float endY;
-   float startOffset;
-   float startYCoord;
-   float endOffset;
-   float endYCoord;
-
-   ifstream textFile;
-   textFile.open("segments.txt");
-
-   if (textFile.fail()){
-      cerr << "Failed to open text file." << endl;
+void readTextFile(string textFilename){
+   TraceScope trace("readTextFile");
+   vector<string> filenames;
+   for (int i = 0; i < numPixmaps; i++){
+      filenames.push_back(pmArray[i].getFilename());
+   }
+   vector< vector<Segment> > segments;
+   string error;
+   if (!readSegmentFile(textFilename, filenames, pmArray[0].getHeight(), segments, error)){
+      cerr << error << endl;
       exit(1);
    }
-   for (int i = 0; i < numPixmaps; i++){ // loop through pixmaps
-	textFile >> filename;   // get filename for next segments
-	int imgIndex = getPmByName(filename);// get pixmap for those segments
-	textFile >> numSegments;
-	for (int j = 0; j < numSegments; j++){ // loop through number of segments in pixmap
-		textFile >> id;		       // get segment data
-		textFile >> startX;
-		textFile >> startY;
-		textFile >> endX;
-		textFile >> endY;
-		startOffset = (pmArray[0].getHeight()/2) - startY;
-		startYCoord = (pmArray[0].getHeight()/2)+ startOffset;
-		endOffset = (pmArray[0].getHeight()/2) - endY;
-		endYCoord = (pmArray[0].getHeight()/2)+ endOffset;
-		Segment seg = Segment( startX, startYCoord, endX, endYCoord, id); //create segment
-		pmArray[imgIndex].addSegment(seg); // add segment to pixmap	
-	}
+   for (int i = 0; i < numPixmaps; i++){ // add the segments to their pixmaps
+      for (int j = 0; j < segments[i].size(); j++){
+         pmArray[i].addSegment(segments[i][j]);
+      }
+      trace.addSegments(segments[i].size());
    }
 }
+//===============================================================================================
+/*
+void editMorph(int image)
+
+* PURPOSE : Bring the morph up to date after the segments of one of its source images changed,
+*           without rendering it again: the frames keep their pixels, and only the tiles of the
+*           frames on either side of the image whose source positions may move by more than
+*           editTolerance pixels are rendered again, as the frames are shown (see
+*           LazyFrames::editSegments). The in-betweens of those frames get their new
+*           segments.
+* INPUTS :  param -- int image, number of the source image, from 0
+*           global -- lazyFrames, the frames of the morph
+*           global -- editTolerance, set by -edittol
+* OUTPUTS : none
+*/
+//===============================================================================================
+void editMorph(int image){
+  int framesPerPair = numIntermImages + 1;
+  vector<Segment> segments = pmArray[image * framesPerPair].getSegmentList();
+  vector<int> changedFrames;
+  long tiles = lazyFrames->editSegments(image, segments, editTolerance, changedFrames);
+  for (int i = max(image - 1, 0) * framesPerPair; i <= (image + 1) * framesPerPair && i < numPixmaps; i++){
+    if (i % framesPerPair != 0){ // an in-between
+      pmArray[i].setSegmentList(lazyFrames->getSegments(i));
+    }
+  }
+  for (int i = 0; i < changedFrames.size(); i++){
+    if (frameTextures != NULL){
+      frameTextures->remove(changedFrames[i]);
+    }
+  }
+  cout << "Segment edit: " << tiles << " tiles of " << changedFrames.size() << " frames to render again, of "
+       << lazyFrames->getTilesPerFrame() << " per frame (tolerance " << editTolerance << " pixels)" << endl;
+}
+
 //===============================================================================================
 /*
 void clickAddSegment(int button, int state, int x, int y)
@@ -346,7 +585,9 @@ void clickAddSegment(int button, int state, int x, int y)
 * PURPOSE : Mouse callback function, Create a segment for the currently displayed image via a sequence of mouse clicks
 *           from the user. The user should be able to click twice anywhere within the window and 
 *	    create a segment between the two click locations. After the user clicks, they will be
-*	    prompted for an identifying name for the segment.
+*	    prompted for an identifying name for the segment. A segment with the id of one the image
+*	    already has replaces it, which moves that segment.
+*	    After a morph, an edit of a source image updates the morph in place (see editMorph).
 * INPUTS :  param -- int button, defines which button on the mouse is being used, comes in as a 
 *                  GLUT enum
 *	    param -- int state, defines state of given button, GLUT enum GLUT_UP or GLUT_DOWN
@@ -373,7 +614,16 @@ void clickAddSegment(int button, int state, int x, int y){
       cin >> id;   
 
       Segment s = Segment(newSeg[0], newSeg[1], newSeg[2], newSeg[3], id); // create a segment
-      pmArray[currentIndex].addSegment(s); // add segment to the currently displayed pixmap
+      int existing = pmArray[currentIndex].getSegmentById(id);
+      if (existing >= 0){ // move the segment of that id
+        pmArray[currentIndex].setSegment(existing, s);
+      }
+      else{
+        pmArray[currentIndex].addSegment(s); // add segment to the currently displayed pixmap
+      }
+      if (lazyFrames != NULL && currentIndex % (numIntermImages + 1) == 0){ // a source image of the morph
+        editMorph(currentIndex / (numIntermImages + 1));
+      }
 	
       float startYOffset = (pmArray[0].getHeight()/2) - s.getStartVect().y;
       float startY= (pmArray[0].getHeight()/2)+ startYOffset;
@@ -404,7 +654,7 @@ void drawSegments()
 //===============================================================================================
 void drawSegments(){
 
-      vector<Segment> segs = currentPm.getSegmentList(); // get segments from the currently displayed image
+      vector<Segment> segs = currentPm->getSegmentList(); // get segments from the currently displayed image
       
       
       glLineWidth(2.5); 
@@ -451,70 +701,118 @@ void drawSegments(){
 /*
 void createIntermImages()
 
-* PURPOSE : 1) Allocate pixmap space for the intermediate frames of the morph
+* PURPOSE : 1) Describe the intermediate frames of the morph, each by a pixmap holding only its
+*	       segments (no pixels, the frames are rendered by morph() when they are shown)
 *	    2) Calculate intermediate segments for the morph using a weighted average
 *	       for between segment pairs.
 *	    Before the function is called, the user will only be able to see the original
 *	    images given with their segments. After the function is called, the user will
 *	    "preview" the warp, being able to rotate through the morph frames. Intermediate
 *	    frames will be represented by black backgrounds with the interpolated segments. 
+*	    The source images are moved into the new sequence, the old array is freed.
 * INPUTS : none
 * OUTPUTS : none, globals pmArray and numPixmaps are updated to make changes to the display.
 */
 //===============================================================================================
 void createIntermImages(){
-	int tempLength = ((numPixmaps - 1) * 3) + numPixmaps; //number of pixmaps in the desired morph sequence
+	int framesPerPair = numIntermImages + 1; // source image plus its in-betweens
+	int tempLength = ((numPixmaps - 1) * framesPerPair) + 1; //number of pixmaps in the desired morph sequence
+	TraceScope trace("createIntermImages");
+	discardLazyFrames(); // a morph of the source images, which are about to move
 	Pixmap* temp = new Pixmap[tempLength]; // create temporary array of Pixmaps
 
-	int numIntermImages = 3; // number of transition images between source images
 	int sourceImageCounter = 0;
 	int transCounter = 0; // tells us which intermediate image we're at in the sequence
-	float transVals[3] = {0.75, 0.5, 0.25}; // determines our calculations for intermediate segments
-	int numSegments = pmArray[0].getNumSegments(); 
+	SegmentTable pairTable; // segments of the previous source image (P, Q) paired with those of the next (P', Q')
 
 	// for i in temp array
 	for (int i = 0; i < tempLength; i++){
-		// if you're in one of the original images (0, 4, 8, 12) index mod 4 == 0
-		if ((i + 4) % 4 == 0){
-			// copy it over using image counter
-			temp[i] = pmArray[sourceImageCounter];
+		// if you're in one of the original images (0, 4, 8, 12 for 3 in-betweens) index mod framesPerPair == 0
+		if (i % framesPerPair == 0){
+			// move it over using image counter
+			temp[i] = move(pmArray[sourceImageCounter]);
 			sourceImageCounter += 1;
+			transCounter = 0;
 		}
 		else{   
-			Pixmap src_image = pmArray[sourceImageCounter -1]; // previous source image in temp array
-			Pixmap dest_image = pmArray[sourceImageCounter]; // next source image in temp array
-
-			temp[i] = Pixmap(pmArray[0].getWidth(), pmArray[0].getHeight()); // create solid black image
-			temp[i].fillSolidColor(0, 0, 0, 255);
-			for (int j = 0; j < numSegments; j++){
-				vector<Segment> src_segs = src_image.getSegmentList();
-				vector<Segment> dest_segs = dest_image.getSegmentList();
-				Segment src_seg = src_segs[j];
-				// find segment in dest image with same id as current segment
-				Segment dest_seg = dest_segs[dest_image.getSegmentById(src_seg.getId())];
-				float startX = ((src_seg.getStartVect().x) * transVals[transCounter]) + ((dest_seg.getStartVect().x) * (1 - transVals[transCounter]));
-				float startY = ((src_seg.getStartVect().y) * transVals[transCounter]) + ((dest_seg.getStartVect().y) * (1 - transVals[transCounter]));
-				float endX = ((src_seg.getEndVect().x) * transVals[transCounter]) + ((dest_seg.getEndVect().x) * (1 - transVals[transCounter]));
-				float endY = ((src_seg.getEndVect().y) * transVals[transCounter]) + ((dest_seg.getEndVect().y) * (1 - transVals[transCounter]));
+			if (transCounter == 0){ // first in-between of a pair, match the segments of the pair once
+				Pixmap& prevSource = temp[i - 1]; // previous source image, already moved
+				vector<Segment> src_segs = prevSource.getSegmentList();
+				vector<Segment> dest_segs = pmArray[sourceImageCounter].getSegmentList(); // next source image
+				int unmatched = buildSegmentTable(pairTable, dest_segs, src_segs, warpSettings.c);
+				if (unmatched > 0){
+					cerr << unmatched << " segment(s) of " << prevSource.getFilename()
+					     << " have no segment with the same id in " << pmArray[sourceImageCounter].getFilename() << endl;
+				}
+			}
+			// weight of the source segments, falls from 1 towards 0 (0.75, 0.5, 0.25 for 3 in-betweens)
+			float transVal = 1.0 - (float(transCounter + 1) / framesPerPair);
+
+			temp[i] = Pixmap(); // segments only, shown over the black background of the window
+			for (int j = 0; j < pairTable.count; j++){
+				float startX = (pairTable.px[j] * transVal) + (pairTable.ppx[j] * (1 - transVal));
+				float startY = (pairTable.py[j] * transVal) + (pairTable.ppy[j] * (1 - transVal));
+				float endX = (pairTable.qx[j] * transVal) + (pairTable.qpx[j] * (1 - transVal));
+				float endY = (pairTable.qy[j] * transVal) + (pairTable.qpy[j] * (1 - transVal));
 				// create segment with new values
-				Segment seg = Segment(startX, startY, endX, endY, src_seg.getId());
+				Segment seg = Segment(startX, startY, endX, endY, pairTable.id[j]);
 				// add segment to interm image
 				temp[i].addSegment(seg);   				
 			}
-			if (transCounter == 2){
-				transCounter == 0;
-			}
-			else if (transCounter < 2){
-				transCounter += 1;
-			}
-
+			trace.addSegments(pairTable.count);
+			transCounter += 1;
 		}
 	}
 
-	// display segment interpolation sequence	
+	// display segment interpolation sequence, the displayed source image keeps its place
 	numPixmaps = tempLength;	
+	delete [] pmArray;
 	pmArray = temp;
-	glutPostRedisplay();
+	if (frameTextures != NULL){ // a frame number now names another image
+		frameTextures->clear();
+	}
+	currentIndex = currentIndex * framesPerPair;
+	currentPm = pmArray + currentIndex;
+	if (!headless){
+		glutPostRedisplay();
+	}
+}
+//===============================================================================================
+/*
+void printWarpReports(ostream& out)
+
+* PURPOSE : Print how the approximate warp and the segment culling did since their reports were
+*           last reset, when those options are on
+* INPUTS :  param -- ostream& out, where to print (cerr when the frames go to standard output)
+* OUTPUTS : none
+*/
+//===============================================================================================
+void printWarpReports(ostream& out){
+	if (warpSettings.approxTolerance > 0){ // report how good the approximate warp was
+		ApproxReport report = getApproxReport();
+		out << "Approximate warp: " << (100.0 * report.exactPixels) / report.pixels << "% of pixels computed exactly, "
+		     << "estimated max error " << report.maxError << " px (tolerance " << warpSettings.approxTolerance << " px)" << endl;
+	}
+	if (warpSettings.cullFraction > 0){ // report how many segments the culling saved
+		CullReport report = getCullReport();
+		out << "Segment culling: " << double(report.keptSegments) / report.tiles << " of "
+		     << double(report.segments) / report.tiles << " segments evaluated per tile on average" << endl;
+	}
+}
+//===============================================================================================
+/*
+void printPoolReport(ostream& out)
+
+* PURPOSE : Print how much memory the pixel pool holds for images and frames (see PixelPool.h)
+* INPUTS :  param -- ostream& out, where to print (cerr when the frames go to standard output)
+* OUTPUTS : none
+*/
+//===============================================================================================
+void printPoolReport(ostream& out){
+	PoolReport report = getPoolReport();
+	out << "Pixel buffers: " << report.bytesInUse / 1048576.0 << " MB in use, "
+	     << report.bytesFree / 1048576.0 << " MB free for reuse, peak " << report.highWater / 1048576.0 << " MB ("
+	     << report.allocations << " allocated, " << report.reuses << " reused)" << endl;
 }
 //===============================================================================================
 /*
@@ -525,222 +823,164 @@ void morph()
 *	     both images should share the same shape and have a different, realistic looking
 *	     subject. After being warped, the images will be gradually cross-dissolved to make
 *	     a smooth morphing sequence.  
+*	     With more than two images the morph runs through the chain (A -> B -> C ...): every
+*	     adjacent pair of source images is morphed over the in-between frames that separate
+*	     them in pmArray (see createIntermImages), by one FrameGenerator for the whole chain.
+*	     No frame is rendered here, nor anywhere on the GLUT thread: the frames are kept by
+*	     a LazyFrames, whose background thread renders the frame the display window shows,
+*	     a coarse preview first and then tile by tile (see display()), and the frames on
+*	     either side of it ahead of time, so the window keeps responding. The tiles of
+*	     a frame are warped and dissolved in one pass (morphRegion) on the global thread
+*	     pool; the output does not depend on the thread count. The frame pixels are recycled
+*	     from the pixel pool (ex. those of the frames of the previous morph).
+*	     The in-between descriptions in pmArray are kept, the sources among them are the
+*	     images the frames render from. With -roi or -mask only that part of the frames is
+*	     rendered, the rest shown in the fill color (the frames are never cropped here).
 * INPUTS :  none, makes use of segment and pixel information of pmArray pixmaps
+*           global -- pool, threads the tiles are rendered on
+*           global -- regionRectangle, regionMask, regionFill, the part rendered
+*           global -- lazyFrames, replaced by the frames of this morph
 * OUTPUTS : none, displays complete morph sequence
 */
 //===============================================================================================
 void morph(){
-   float times[5] = {0.0, 0.25, 0.5, 0.75, 1.0};
-
-   // go through images in pmArray, 
-   // determine images that will be at the beginning and end of each transition
-   int numSourceImages = floor (numPixmaps/ 4) + 1; 
-   for (int src =1; src < numSourceImages; src ++){ // for each image pair 
-   	Pixmap imgA = pmArray[(4 * src) - 4]; // start image in morph
- 	Pixmap imgB = pmArray[4 * src]; //end image in morph
-
-	// create temporary array which will hold the warped images in each morph sequence
-	// this will be larger than the pmArray as it will hold two images for t = 0.5
-	// one where imgA warps to intermediate shape, and one where imgB warps to intermediate shape
-	// later this will be referenced to cross dissolve into final morphed images
-	int warpLength = 10; 
-	Pixmap* warpArray = new Pixmap[warpLength];
-	for (int w = 0; w < warpLength; w ++){  // loop through warp array
-		warpArray[w] = Pixmap(pmArray[0].getWidth(), pmArray[0].getHeight()); // create black pixmaps
-		warpArray[w].fillSolidColor(0, 0, 0, 255);
-		Pixmap source; // informs pixel vals
-		Pixmap dest;   // informs location vals
-		int destIndex;
-		
-		if (w < 5){ // first half of morph
-		        destIndex = w;
-			source = imgA;
-			dest = pmArray[destIndex];
-		}
-		else if( w >= 5){ // second half of morph
-			destIndex = w - 5;
-			source = imgB;
-			dest = pmArray[destIndex]; // there will be two warps for middle of morph, need to re-index
-		}
-	
-		Pixel** sourcePointer = source.getPmPointer();
-		
-		vector<Segment> destSegments = dest.getSegmentList();
-		vector<Segment> sourceSegments = source.getSegmentList();
-		for (int seg = 0; seg < dest.getNumSegments(); seg++){
-			warpArray[w].addSegment(destSegments[seg]);
-		}
-		// constants to determine weights in warp
-		double a = 1; // val barely greater than 0 gives precise control of warp, greater vals have smoother warp but less control
-		double b = 2; // ideally in range 0.5 - 2
-		double c = 0; // if 0, all segments have same weight; if 1, longer segments have more weight
-
-		// for each pixel in destination pixmap
-		for (int row = 0; row < dest.getHeight(); row++){
-			for (int col = 0; col < dest.getWidth(); col++){
-				Vector2D pixelX;
-				pixelX.x = col;
-				pixelX.y = row;				
-				Vector2D pixelXprime;
-
-				Vector2D dsum; // sum of displacements between source and destination pixels across segments
-				dsum.x = 0;
-				dsum.y = 0;
-				float weightsum = 0; 
-				
-				// for each segment
-				for (int s = 0; s < dest.getNumSegments(); s++){
-					//define P,Q,P',Q' // these vals check out
-					Vector2D P = destSegments[s].getStartVect();
-					Vector2D Q = destSegments[s].getEndVect();
-					Vector2D Pprime = sourceSegments[source.getSegmentById(destSegments[s].getId())].getStartVect();
-					Vector2D Qprime = sourceSegments[source.getSegmentById(destSegments[s].getId())].getEndVect(); 
-					//**************************
-					//calculate u,v based on PQ
-					//elements of u calculation					
-					Vector2D XminusP; // (X - P)
-					XminusP.x = pixelX.x - P.x;
-					XminusP.y = pixelX.y - P.y;
-
-					Vector2D QminusP; // (Q - P)
-					QminusP.x = Q.x - P.x;
-					QminusP.y = Q.y - P.y;
-					
-					float uNumer = (XminusP.x * QminusP.x) + (XminusP.y * QminusP.y); // (X-P) dot (Q-P), numerator in u calculation
-					float uDenom = (sqrt((QminusP.x * QminusP.x) + (QminusP.y * QminusP.y))) * (sqrt((QminusP.x * QminusP.x) + (QminusP.y * QminusP.y))); // ||Q - P||^2 
-					float u = uNumer/uDenom; // calculate u
-	
-					//elements of v calculation
-					
-					Vector2D perpQP; //Perpendicular(Q-P) (x, y) -> (-y,x)
-					perpQP.x = (-1) *(QminusP.y);  
-					perpQP.y =  QminusP.x;
-					
-					float vNumer = (XminusP.x * perpQP.x) + (XminusP.y * perpQP.y); // (X - P) dot Perpendicular(Q - P)
-					float vDenom = sqrt((QminusP.x * QminusP.x) + (QminusP.y * QminusP.y)); //||Q -P||
-					float v = vNumer/vDenom; // calculate v
-				
-
-					//**************************
-					// calculate X' Based on u,v and P'Q'
-					// elements of X' calculation
-					
-					Vector2D QminusPprime; //Q' - P'
-					QminusPprime.x = Qprime.x - Pprime.x;
-					QminusPprime.y = Qprime.y - Pprime.y;
-
-					float xPrimeDenom = sqrt((QminusPprime.x * QminusPprime.x) +(QminusPprime.y * QminusPprime.y)); // ||Q' -P'||
-
-					Vector2D perpQPprime; // Perpendicular (Q' - P')
-					perpQPprime.x =  (-1) *(QminusPprime.y);
-					perpQPprime.y =  QminusPprime.x;
-
-					Vector2D uScalarMult; // u dot (Q' - P')
-					uScalarMult.x = QminusPprime.x * u;
-					uScalarMult.y = QminusPprime.y * u;
-					
-					Vector2D xPrimeNumer;  // v dot Perpendicular (Q'- P')
-					xPrimeNumer.x = perpQPprime.x * v;
-					xPrimeNumer.y = perpQPprime.y * v;
-
-					Vector2D quotient;
-					quotient.x = xPrimeNumer.x/ xPrimeDenom;
-					quotient.y = xPrimeNumer.y/ xPrimeDenom;
-					
-					Vector2D localXprime;
-					localXprime.x = (Pprime.x + uScalarMult.x + quotient.x); //calculate X'
-					localXprime.y = (Pprime.y + uScalarMult.y + quotient.y);
-					
-					//**************************
-					// calculate displacement D for this line segment
-					Vector2D d; // displacement between X' and X on the current segment
-					d.x = (localXprime.x - pixelX.x);
-					d.y = (localXprime.y - pixelX.y);
-
-					
-					//**************************
-					// calculate shortest distance from X to line segment PQ
-					float dist;
-					// if 0 > u > 1, shortest distance is abs(v)
-					if (u >= 0 && u <= 1){
-						dist = fabs(v);
-					}
-					// if u < 0, shortest is distance between P and X
-					else if (u < 0){
-						dist = sqrt(((P.x - pixelX.x)*(P.x - pixelX.x)) + ((P.y - pixelX.y) * (P.y - pixelX.y)));
-					}
-					// if u > 1, shortest is distance between Q and X 
-					else if (u > 1){
-						dist = sqrt(((Q.x - pixelX.x)*(Q.x - pixelX.x)) + ((Q.y - pixelX.y) * (Q.y - pixelX.y)));
-					}
-					
-					//**************************
-					// calculate weight
-					double lengthPQ = sqrt(((P.x - Q.x)*(P.x - Q.x)) + ((P.y - Q.y) * (P.y- Q.y)));
-					double weightNumer = pow (lengthPQ, c);//length ^p
-					double weightBase = weightNumer/(a + dist);
-					double weight = pow (weightBase, b);
-					weight = float(weight);
-					
-					
-					// update sums
-					dsum.x += (d.x * (weight));
-					dsum.y += (d.y * (weight));
-					weightsum += weight;
-					
-				} // close loop through segments
-				
-				Pixel** destPointer = warpArray[w].getPmPointer();
-				pixelXprime.x = float(pixelX.x + (dsum.x/weightsum));
-				pixelXprime.y = float(pixelX.y + (dsum.y/weightsum));
-
-				
-				if (pixelXprime.x >= 0 && pixelXprime.x < source.getWidth() && pixelXprime.y >= 0 && pixelXprime.y < source.getHeight()){
-
-					destPointer[int(pixelX.y)][int(pixelX.x)].setRVal(sourcePointer[int(pixelXprime.y)][int(pixelXprime.x)].getRVal());
-					destPointer[int(pixelX.y)][int(pixelX.x)].setGVal(sourcePointer[int(pixelXprime.y)][int(pixelXprime.x)].getGVal());
-					destPointer[int(pixelX.y)][int(pixelX.x)].setBVal(sourcePointer[int(pixelXprime.y)][int(pixelXprime.x)].getBVal());
-				}
-			} // close col loop
-		} // close row loop	
+   int framesPerPair = numIntermImages + 1; // source image plus its in-betweens
+   if (numPixmaps < framesPerPair + 1 || (numPixmaps - 1) % framesPerPair != 0){
+   	cerr << "Cannot morph, create the in-between frames first ('i')." << endl;
+   	return;
+   }
 
-	// overlay images with alphas based on time
-	// create temp array size numPixmaps
-	
-	} // close loop through warp array
-			
-	//**************************
-	// cross dissolve over time
-	Pixmap* temp = new Pixmap[numPixmaps];
-	for (int i = 0; i < numPixmaps; i ++){
-		temp[i] = Pixmap(pmArray[0].getWidth(), pmArray[0].getHeight());
-		temp[i].fillSolidColor(0, 0, 0, 255);
-		int Xindex = i;
-		int Yindex = i + (warpLength/2);
-		Pixmap imageX = warpArray[Xindex]; // image X and Y will be two different images warped to the same segments
-		Pixmap imageY = warpArray[Yindex];
-		float alpha = times[i];  // alpha value of the images coincides with time changes
-		Pixel** XPointer = imageX.getPmPointer();
-		Pixel** YPointer = imageY.getPmPointer();
-		Pixel** newPointer = temp[i].getPmPointer();
-		for (int ro = 0; ro < pmArray[0].getHeight(); ro++){ // loop through pixels
-			for (int co = 0; co < pmArray[0].getWidth(); co++){	
-			// the alpha of imageX = 1 - alpha of imageY (ex. if imageX is at 0.25 visibility, imageY is at 0.75 visibility)
-				unsigned char rVal = ((1 - alpha)*XPointer[ro][co].getRVal()) + (alpha * YPointer[ro][co].getRVal());
-				unsigned char gVal = ((1 - alpha)*XPointer[ro][co].getGVal()) + (alpha * YPointer[ro][co].getGVal());
-				unsigned char bVal = ((1 - alpha)*XPointer[ro][co].getBVal()) + (alpha * YPointer[ro][co].getBVal());
-				// set new blended values to newly allocated space
-				newPointer[ro][co].setRVal(rVal);
-				newPointer[ro][co].setGVal(gVal);
-				newPointer[ro][co].setBVal(bVal);
-			}
-		}
-	}
+   // the source images sit every framesPerPair frames of pmArray, the frames of a pair are
+   // evenly spaced in time (0.0, 0.25, 0.5, 0.75, 1.0 for 3 in-betweens)
+   vector<Pixmap*> sources;
+   for (int i = 0; i < numPixmaps; i += framesPerPair){
+   	sources.push_back(&pmArray[i]);
+   }
+   vector<float> times = evenTimes(framesPerPair + 1);
+
+   TraceScope trace("morph");
+   discardLazyFrames();
+   resetApproxReport();
+   resetCullReport();
+   lazyFrames = new LazyFrames(sources, times, pool, previewStep); // display morph sequence, rendered as it is shown
+   FrameRegion region;
+   Pixmap mask;
+   string error;
+   if (!readRegion(sources[0]->getWidth(), sources[0]->getHeight(), false, region, mask, error)
+       || !lazyFrames->setRegion(region, mask.getWidth() > 0 ? &mask : NULL, error)){
+   	cerr << "Cannot morph. " << error << endl;
+   	discardLazyFrames();
+   	return;
+   }
+   if (frameTextures != NULL){ // the textures show the in-betweens
+   	frameTextures->clear();
+   }
+   lazyFrames->show(currentIndex, prefetchRadius); // display() draws it as it renders
+}
+//===============================================================================================
+/*
+refreshTimer(int value)
 
-	pmArray = temp; // display morph sequence
-	
-   } //close for loop through image pairs 
+* PURPOSE : Timer callback redrawing the display window while the shown frame renders in the
+*           background, so its preview and then its tiles appear as they are done
+* INPUTS :  param -- int value; unused
+*           global -- refreshScheduled, cleared
+* OUTPUTS : none
+*/
+//===============================================================================================
+void refreshTimer(int value){
+  refreshScheduled = false;
+  glutPostRedisplay();
+}
+
+//===============================================================================================
+/*
+toggleRendering()
+
+* PURPOSE : Cancel the rendering of the morph in the background (the frame being rendered stops
+*           between two tiles, keeping what it has), or resume it
+* INPUTS :  global -- lazyFrames, the frames of the morph
+* OUTPUTS : none
+*/
+//===============================================================================================
+void toggleRendering(){
+  if (lazyFrames == NULL){
+    return;
+  }
+  if (lazyFrames->isPaused()){
+    lazyFrames->resume();
+  }
+  else{
+    lazyFrames->cancel();
+  }
+  glutPostRedisplay();
 }
+//===============================================================================================
+/*
+playbackTimer(int value)
+
+* PURPOSE : Timer callback of the playback: show the next frame (looping to the first after the
+*           last) and schedule itself for the frame after. Each frame is due 1 / playbackFps
+*           seconds after the previous one was due, not after this call, so the rate does not
+*           drift by the time the callback takes; when drawing falls behind by more than a frame
+*           the schedule restarts from now rather than rushing to catch up.
+* INPUTS :  param -- int value; unused
+*           global -- playing, the playback stops when it is false
+*           global -- playbackFps, nextPlaybackFrame, the schedule
+* OUTPUTS : none, sets currentIndex and currentPm
+*/
+//===============================================================================================
+void playbackTimer(int value){
+  if (!playing){
+    return;
+  }
+  currentIndex = (currentIndex + 1) % numPixmaps; // the frames are all the same size, no reshape
+  currentPm = pmArray + currentIndex;
+  glutPostRedisplay();
+
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  chrono::steady_clock::duration period = chrono::microseconds(1000000 / playbackFps);
+  nextPlaybackFrame += period;
+  if (nextPlaybackFrame < now - period){
+    nextPlaybackFrame = now;
+  }
+  long delay = chrono::duration_cast<chrono::milliseconds>(nextPlaybackFrame - now).count();
+  glutTimerFunc((delay > 0) ? delay : 0, playbackTimer, 0);
+}
+
+//===============================================================================================
+/*
+togglePlayback()
+
+* PURPOSE : Start or stop playing the frames in the display window at playbackFps frames per
+*           second. The frames are drawn from textures (see FrameTextures.h), uploaded the first
+*           time each is shown, so the frames after the first loop cost no upload while they fit
+*           in -texturemb. The frame rate achieved is shown in the title of the window.
+* INPUTS :  global -- playing, toggled
+*           global -- numPixmaps, nothing plays with fewer than two frames
+* OUTPUTS : none
+*/
+//===============================================================================================
+void togglePlayback(){
+  if (!playing && (numPixmaps < 2 || playbackFps <= 0)){
+    return;
+  }
+  playing = !playing;
+  if (playing){
+    nextPlaybackFrame = chrono::steady_clock::now();
+    fpsStart = nextPlaybackFrame;
+    fpsFrames = 0;
+    glutTimerFunc(0, playbackTimer, 0);
+  }
+  else{
+    glutSetWindowTitle("morpher");
+    if (frameTextures != NULL){
+      cout << "Playback: " << frameTextures->getUploads() << " frames uploaded, " << frameTextures->getEvictions()
+           << " evicted, " << frameTextures->getBytes() / 1048576.0 << " MB of textures" << endl;
+    }
+  }
+}
+
 //===============================================================================================
 /*
 handleKey(unsigned char key, int x, int y)
@@ -758,7 +998,7 @@ void handleKey(unsigned char key, int x, int y){
     
     case 'r':
     case 'R':
-    readTextFile(); // read segment information from text file
+    readTextFile("segments.txt"); // read segment information from text file
     glutPostRedisplay();
     break;
   
@@ -781,6 +1021,16 @@ void handleKey(unsigned char key, int x, int y){
     glutPostRedisplay();
     break;
 
+    case 'p':
+    case 'P':
+    togglePlayback(); // play or stop the frames
+    break;
+
+    case 'x':
+    case 'X':
+    toggleRendering(); // cancel or resume the rendering of the morph
+    break;
+
     case 'w':
     case 'W':
     {
@@ -794,6 +1044,12 @@ void handleKey(unsigned char key, int x, int y){
     case 'q':		// q - quit
     case 'Q':
     case 27:		// esc - quit
+      if (lazyFrames != NULL){ // summary of the frames of the morph rendered so far
+        cout << "Frames rendered: " << lazyFrames->getRenderedShown() << " when shown, "
+             << lazyFrames->getRenderedAhead() << " ahead, of " << lazyFrames->getNumFrames() << endl;
+        printWarpReports(cout);
+        printPoolReport(cout);
+      }
       exit(0);
 
     default:		// not a valid key -- just ignore it
@@ -818,11 +1074,17 @@ void processSpecialKeys(int key, int x, int y) {
    switch(key) {
 
 	case GLUT_KEY_LEFT : // left arrow
+	if (lazyFrames != NULL){ // moving on resumes a cancelled morph
+	  lazyFrames->resume();
+	}
 	selectCurrentImage(0); // select previous pixmap
 	glutPostRedisplay();
  	break;
 
 	case GLUT_KEY_RIGHT : // right arrow
+	if (lazyFrames != NULL){
+	  lazyFrames->resume();
+	}
 	selectCurrentImage(1); // select next pixmap
     	glutPostRedisplay(); 
 	break;
@@ -838,9 +1100,21 @@ display()
 *           image has been read. This routine is called every time the window on the screen 
 *           needs to be redrawn, like if a new image is displayed. It is also
 *           called whenever the program calls glutPostRedisplay() 
+*           The image is drawn from its texture (see FrameTextures.h), uploaded only the first
+*           time it is shown, or with glDrawPixels if it cannot be a texture. The window is
+*           double buffered, so a frame of the playback is never seen half drawn. While playing,
+*           the frames drawn are counted and the achieved rate is put in the window title
+*           once a second.
 * INPUTS :  global -- currentPm, current pixmap displayed
 *           global -- hasReadImage, indicates whether an image was successfully
 *                     read and can therefore be displayed 
+*           global -- frameTextures, textures of the frames
+*           global -- playing, fpsStart, fpsFrames, the achieved frame rate
+*           global -- lazyFrames, after a morph the shown frame is taken from it, never waiting
+*                     for it: the background thread is told to render it (and its neighbours
+*                     ahead), and until it is ready the window shows its preview and the tiles
+*                     done so far, or the in-between's segments before that, redrawn every
+*                     50 ms (see refreshTimer), with the progress in the window title
 * OUTPUTS : no returns, but displays background and images
 */
 //===============================================================================================
@@ -852,13 +1126,34 @@ void display(){
   glClearColor(0, 0, 0, 1);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
  // clear window to background color
-  // flush the OpenGL pipeline to the viewportq
-  glFlush();
+
+  int frameState = FRAME_READY;
+  if (lazyFrames != NULL){ // a morphed frame, as far as it is rendered
+    lazyFrames->show(currentIndex, prefetchRadius);
+    Pixmap* frame = lazyFrames->peekFrame(currentIndex, frameState);
+    currentPm = (frame != NULL) ? frame : pmArray + currentIndex;
+    if (frameState != FRAME_READY && !lazyFrames->isPaused() && !refreshScheduled){
+      refreshScheduled = true;
+      glutTimerFunc(50, refreshTimer, 0);
+    }
+    if (!playing){ // progress of the shown frame and of the sequence
+      char title[96];
+      int percent = 100 * lazyFrames->getTilesDone(currentIndex) / lazyFrames->getTilesPerFrame();
+      snprintf(title, sizeof(title), "morpher - frame %d: %s%d%%, %d of %d frames ready", currentIndex,
+               lazyFrames->isPaused() ? "cancelled at " : "", (frameState == FRAME_READY) ? 100 : percent,
+               lazyFrames->getNumReady(), lazyFrames->getNumFrames());
+      glutSetWindowTitle(title);
+    }
+  }
 
   // if there is an image to display, get image information
+  if (currentPm == NULL){ // no image read yet
+	glutSwapBuffers();
+	return;
+  }
   //if (hasReadImage == true){
-	int xres = currentPm.getWidth();
-	int yres = currentPm.getHeight();
+	int xres = currentPm->getWidth();
+	int yres = currentPm->getHeight();
         
 	// glut tends to display images upside down
   // the following glut code overcomes this to display image starting
@@ -867,14 +1162,30 @@ void display(){
   	glPixelZoom(1, -1);
 	glDepthFunc(GL_DEPTH_TEST);
 
-  // display the image
-      
-      glDrawPixels(xres,yres,GL_RGBA,GL_UNSIGNED_BYTE,currentPm.getDataPointer());
+  // display the image, from its texture if it can have one
+      if (xres == 0 || yres == 0){ // an in-between, only its segments are drawn
+      }
+      else if (frameState != FRAME_READY || frameTextures == NULL || !frameTextures->draw(currentIndex, *currentPm)){
+        glDrawPixels(xres,yres,GL_RGBA,GL_UNSIGNED_BYTE,currentPm->getDataPointer());
+      }
       
       drawSegments();
 
-      glFlush();
+      glutSwapBuffers();
   //}
+
+  if (playing){ // show the frame rate achieved over the last second
+    fpsFrames = fpsFrames + 1;
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(now - fpsStart).count();
+    if (seconds >= 1){
+      char title[64];
+      snprintf(title, sizeof(title), "morpher - %.1f fps (target %d)", fpsFrames / seconds, playbackFps);
+      glutSetWindowTitle(title);
+      fpsStart = now;
+      fpsFrames = 0;
+    }
+  }
 }
 
 //===============================================================================================
@@ -901,6 +1212,466 @@ void handleReshape(int w, int h){
 }
 
 
+//===============================================================================================
+/*
+parseOptions(int& argc, char* argv[])
+
+* PURPOSE : Read the options that may appear anywhere in the command line and remove them from
+*           argv, leaving the arguments main expects (like glutInit does for its own options).
+*           Options:  -t n      render with n threads (default: one per core)
+*                     -simd n   pixels per vector in the warp kernel: 16 (AVX-512), 8 (AVX2),
+*                               0 for the scalar warp (default: widest the processor supports)
+*                     -approx tol   compute the warp exactly only on a coarse lattice and interpolate
+*                                   where it is smooth to within tol pixels
+*                     -approxstep n lattice spacing of -approx in pixels (default 8)
+*                     -cull f   in each tile, skip the segments whose weight stays below
+*                               f of the total weight (ex. 0.001)
+*                     -times list   batch mode: comma separated time of each frame, from 0 to 1
+*                     -ease curve   batch mode: easing of evenly spaced times, linear (default),
+*                                   easein, easeout or easeinout
+*                     -format f batch mode: png (one file per frame), y4m, y4m444 or rgba (one
+*                               video stream), by default chosen from the output name
+*                     -fps n    batch mode: frame rate written in a y4m stream (default 30)
+*                     -compress n   zlib level of png files, 0 (fastest) to 9 (smallest), default 6
+*                     -encoders n   threads writing png files (default one per core)
+*                     -layout l rows (default) or tiled, how the warps store the images they
+*                               read (see TiledPixmap.h)
+*                     -cache dir    keep decoded images in dir and map them from there on
+*                                   later runs instead of decoding (see ImageCache.h)
+*                     -cachesize n  size limit of the image cache in MB (default 1024)
+*                     -jobpixels n  manifest mode: jobs whose frames have at least n pixels
+*                                   render their frames across all threads, smaller jobs run
+*                                   side by side (default 1048576)
+*                     -servercache n    server mode: decoded images kept in memory between
+*                                       requests, in MB (default 512)
+*                     -playfps n    frame rate of the playback in the display window ('p'),
+*                                   default 30
+*                     -texturemb n  texture memory the displayed frames may take, in MB
+*                                   (default 512), the least recently shown are evicted
+*                     -prefetch n   after a morph, frames on each side of the shown one that
+*                                   are rendered ahead in the background (default 2)
+*                     -preview n    after a morph, a frame being rendered first shows a preview
+*                                   of one pixel per n x n block (default 8, 1 for none)
+*                     -edittol px   after a morph, a segment edit renders again the tiles whose
+*                                   source positions may move by more than px pixels (default
+*                                   0.25, 0 for every tile that can change)
+*                     -roi x,y,w,h  render only that rectangle of the frames (see FrameRegion.h)
+*                     -mask file    render only the pixels the red channel of the image covers,
+*                                   blending partly covered ones over the fill color
+*                     -crop     batch mode: write the frames cropped to the rectangle of -roi
+*                               or -mask, their offset kept as the data window of the files
+*                     -roifill c    color r,g,b[,a] of the pixels outside the region in full
+*                                   size frames (default 0,0,0,255)
+*                     -trace file   record the time of every stage (see Trace.h) and write it to
+*                                   file as Chrome trace JSON when the program exits
+* INPUTS :   param -- int& argc; number of arguments, reduced by the number removed
+*            param -- char* argv[]; command line arguments, options are removed in place
+*            global -- numThreads, set by -t
+*            global -- frameTimes, easing, set by -times and -ease
+*            global -- outputFormat, framesPerSecond, set by -format and -fps
+*            global -- compressionLevel, numEncoders, set by -compress and -encoders
+*            global -- traceFilename, set by -trace
+*            global -- imageCacheDir, imageCacheMB, set by -cache and -cachesize
+*            global -- largeJobPixels, set by -jobpixels
+*            global -- serverCacheMB, set by -servercache
+*            global -- playbackFps, textureMB, set by -playfps and -texturemb
+*            global -- prefetchRadius, previewStep, set by -prefetch and -preview
+*            global -- editTolerance, set by -edittol
+*            global -- regionRectangle, regionMask, regionCrop, regionFill, set by -roi, -mask,
+*                      -crop and -roifill
+* OUTPUTS : none
+*/
+//===============================================================================================
+
+void parseOptions(int& argc, char* argv[]){
+  int kept = 1;
+  for (int i = 1; i < argc; i++){
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc){
+      numThreads = atoi(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-simd") == 0 && i + 1 < argc){
+      warpSettings.simdWidth = atoi(argv[i + 1]);
+      if (warpSettings.simdWidth != -1 && warpSettings.simdWidth != 0 && warpSettings.simdWidth != 8
+          && warpSettings.simdWidth != 16){
+        cerr << "Unknown vector width " << argv[i + 1] << ", use 16, 8, 0 (scalar) or -1 (widest)" << endl;
+        exit(1);
+      }
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-approx") == 0 && i + 1 < argc){
+      warpSettings.approxTolerance = atof(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-approxstep") == 0 && i + 1 < argc){
+      warpSettings.approxStep = atoi(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-cull") == 0 && i + 1 < argc){
+      warpSettings.cullFraction = atof(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-times") == 0 && i + 1 < argc){
+      frameTimes = argv[i + 1];
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-ease") == 0 && i + 1 < argc){
+      easing = argv[i + 1];
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-format") == 0 && i + 1 < argc){
+      outputFormat = argv[i + 1];
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-fps") == 0 && i + 1 < argc){
+      framesPerSecond = atoi(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-compress") == 0 && i + 1 < argc){
+      compressionLevel = atoi(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-encoders") == 0 && i + 1 < argc){
+      numEncoders = atoi(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-layout") == 0 && i + 1 < argc){
+      warpSettings.tiledSources = (strcmp(argv[i + 1], "tiled") == 0);
+      if (!warpSettings.tiledSources && strcmp(argv[i + 1], "rows") != 0){
+        cerr << "Unknown source layout " << argv[i + 1] << ", use rows or tiled" << endl;
+        exit(1);
+      }
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc){
+      imageCacheDir = argv[i + 1];
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-cachesize") == 0 && i + 1 < argc){
+      imageCacheMB = atol(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-jobpixels") == 0 && i + 1 < argc){
+      largeJobPixels = atol(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-servercache") == 0 && i + 1 < argc){
+      serverCacheMB = atol(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-playfps") == 0 && i + 1 < argc){
+      playbackFps = atoi(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-texturemb") == 0 && i + 1 < argc){
+      textureMB = atol(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-prefetch") == 0 && i + 1 < argc){
+      prefetchRadius = atoi(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-preview") == 0 && i + 1 < argc){
+      previewStep = atoi(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-edittol") == 0 && i + 1 < argc){
+      editTolerance = atof(argv[i + 1]);
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-roi") == 0 && i + 1 < argc){
+      regionRectangle = argv[i + 1];
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-mask") == 0 && i + 1 < argc){
+      regionMask = argv[i + 1];
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-crop") == 0){
+      regionCrop = true;
+    }
+    else if (strcmp(argv[i], "-roifill") == 0 && i + 1 < argc){
+      regionFill = argv[i + 1];
+      i = i + 1;
+    }
+    else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc){
+      traceFilename = argv[i + 1];
+      i = i + 1;
+    }
+    else{
+      argv[kept] = argv[i];
+      kept = kept + 1;
+    }
+  }
+  argc = kept;
+}
+
+//===============================================================================================
+/*
+runBatch(int argc, char* argv[])
+
+* PURPOSE : Run the whole morph pipeline from the command line without creating a GLUT window, so
+*           that morphs can be rendered on machines with no display. Called from main when the
+*           first argument is "-b", in the form
+*
+*               morpher -b imgA.jpg imgB.jpg [imgC.jpg ...] segments.txt nframes outpattern
+*
+*           With more than two images the morph runs through the chain (A -> B -> C ...), each
+*           adjacent pair over nframes frames, stitched into one sequence in which the image
+*           shared by two pairs appears once. The frames of a pair are evenly spaced in time
+*           (reshaped by -ease), or given one by one with -times, in which case nframes must be
+*           the number of times listed. The frames are rendered by a FrameGenerator a window
+*           of frames at a time (one per thread), so that frames of neighbouring pairs render
+*           in parallel, and memory holds the images and a few frames whatever the length of
+*           the sequence.
+*           The frames are written as one image file each, handed to a FrameEncoder whose
+*           threads compress them while the next frames render (memory then also holds up to
+*           numEncoders frames, whose pixels are recycled through the pixel pool), or streamed
+*           into a single video (see VideoWriter) when the format is y4m, y4m444 or rgba. The
+*           format is taken from -format, else from the output name: "-" (standard output) and
+*           .y4m names are y4m, .rgba and .raw names are rgba, anything else is png.
+* INPUTS :   param -- int argc; number of arguments given in the command line
+*            param -- char* argv[]; command line arguments given
+*            global -- headless, set to true so the pipeline skips GLUT calls
+*            global -- frameTimes, easing, times of the frames
+*            global -- outputFormat, framesPerSecond, how the frames are written
+*            global -- compressionLevel, numEncoders, how png files are written
+*            global -- regionRectangle, regionMask, regionCrop, regionFill, the part of the
+*                      frames rendered
+* OUTPUTS : int, exit status of the program
+*/
+//===============================================================================================
+
+int runBatch(int argc, char* argv[]){
+
+  if (argc < 7){
+    cerr << "usage: " << argv[0] << " [-t threads] [-simd width] [-approx tol] [-approxstep n] [-cull f]"
+         << " [-times list | -ease curve] [-format f] [-fps n] [-compress n] [-encoders n]"
+         << " [-layout rows|tiled] [-cache dir] [-cachesize n] [-roi x,y,w,h] [-mask file] [-crop]"
+         << " [-roifill r,g,b[,a]] [-trace file]"
+         << " -b imgA imgB [imgC ...] segmentfile nframes outpattern" << endl;
+    return 1;
+  }
+
+  int numFrames = atoi(argv[argc - 2]); // frames of each pair, its two source images included
+  vector<float> times;
+  string error;
+  if (!sequenceTimes(numFrames, frameTimes, easing, times, error)){
+    cerr << error << endl;
+    return 1;
+  }
+
+  string outpattern = argv[argc - 1];
+  string format = (outputFormat != "") ? outputFormat : formatForOutput(outpattern);
+  if (format != "png" && videoFormatByName(format) < 0){
+    cerr << "Unknown output format " << format << ", use png, y4m, y4m444 or rgba." << endl;
+    return 1;
+  }
+  if (format == "png" && !checkFramePattern(outpattern, error)){
+    cerr << error << endl;
+    return 1;
+  }
+  if (framesPerSecond <= 0){
+    cerr << "Frame rate must be at least 1." << endl;
+    return 1;
+  }
+  if (compressionLevel < 0 || compressionLevel > 9){
+    cerr << "Compression level must be from 0 to 9." << endl;
+    return 1;
+  }
+  headless = true;
+
+  vector<char*> imageArgs; // same layout readMultiImages expects from main
+  imageArgs.push_back(argv[0]);
+  for (int i = 2; i < argc - 3; i++){
+    imageArgs.push_back(argv[i]);
+  }
+  readMultiImages(imageArgs.size(), &imageArgs[0]);
+  readTextFile(argv[argc - 3]);
+
+  vector<Pixmap*> images;
+  for (int i = 0; i < numPixmaps; i++){
+    if (pmArray[i].getNumSegments() != pmArray[0].getNumSegments()){
+      cerr << "Cannot interpolate segments, images do not have the same number of segments." << endl;
+      return 1;
+    }
+    images.push_back(&pmArray[i]);
+  }
+
+  VideoWriter video;
+  if (format != "png" && !video.open(outpattern, videoFormatByName(format), framesPerSecond)){
+    return 1;
+  }
+
+  FrameEncoder* encoder = NULL; // png files are encoded on their own threads
+  if (format == "png"){
+    encoder = new FrameEncoder(numEncoders, 0, writeImage);
+  }
+
+  FrameGenerator generator(images, times, pool);
+  FrameRegion region;
+  Pixmap mask;
+  if (!readRegion(images[0]->getWidth(), images[0]->getHeight(), regionCrop, region, mask, error)
+      || !generator.setRegion(region, mask.getWidth() > 0 ? &mask : NULL, error)){
+    cerr << error << endl;
+    return 1;
+  }
+  int window = pool->getNumThreads(); // frames rendered together
+  vector<Pixmap> frames(window); // reused for the video, handed to the encoder for png files
+  resetApproxReport();
+  resetCullReport();
+  bool failed = false;
+  for (int first = 0; first < generator.getNumFrames() && !failed; first += window){
+    int count = min(window, generator.getNumFrames() - first);
+    generator.renderFrames(first, count, &frames[0]);
+    for (int f = 0; f < count && !failed; f++){
+      int k = first + f;
+      if (encoder != NULL){
+        // hand the frame to the encoder, waits while its queue is full. The pixels of the frames
+        // it has written are reused for the next frames
+        string filename = frameFilename(outpattern, k);
+        if (filename == ""){
+          cerr << "The name of frame " << k << " of " << outpattern << " is too long." << endl;
+          failed = true;
+        }
+        else{
+          encoder->write(move(frames[f]), filename);
+          failed = encoder->hasFailed();
+        }
+      }
+      else{
+        TraceScope trace("encode video", long(frames[f].getWidth()) * frames[f].getHeight());
+        if (!video.writeFrame(frames[f])){
+          cerr << "Could not write frame " << k << endl;
+          return 1;
+        }
+      }
+    }
+  }
+  if (encoder != NULL){
+    bool written = encoder->finish() && !failed;
+    delete encoder;
+    if (!written){
+      cerr << "Could not write every frame of " << outpattern << endl;
+      return 1;
+    }
+  }
+  if (!video.close()){
+    cerr << "Could not finish writing " << outpattern << endl;
+    return 1;
+  }
+  printWarpReports((outpattern == "-") ? cerr : cout); // keep standard output for the video
+  printPoolReport((outpattern == "-") ? cerr : cout);
+  return 0;
+}
+
+//===============================================================================================
+/*
+runManifest(string manifestFilename)
+
+* PURPOSE : Run every batch morph listed in a manifest file in this one process (see
+*           JobScheduler.h for the format), called from main when the first argument is
+*           "-manifest", in the form
+*
+*               morpher [options] -manifest jobs.txt
+*
+*           The options of the command line (threads, simd, compression, cache ...) apply to
+*           every job; -times, -ease, -format and -fps are given per job in the manifest. Jobs
+*           whose frames are smaller than -jobpixels run side by side, larger ones one after
+*           another with their frames split across the threads. An image named by several jobs
+*           is decoded once. A job that fails does not stop the others; a table of every job and
+*           the throughput of the whole manifest are printed at the end.
+* INPUTS :   param -- string manifestFilename; the manifest
+*            global -- headless, set to true so the pipeline skips GLUT calls
+*            global -- largeJobPixels, how the jobs share the threads
+*            global -- compressionLevel, how png files are written
+* OUTPUTS : int, exit status of the program, 1 if any job failed
+*/
+//===============================================================================================
+
+int runManifest(string manifestFilename){
+
+  if (compressionLevel < 0 || compressionLevel > 9){
+    cerr << "Compression level must be from 0 to 9." << endl;
+    return 1;
+  }
+  vector<MorphJob> jobs;
+  string error;
+  if (!readManifest(manifestFilename, jobs, error)){
+    cerr << error << endl;
+    return 1;
+  }
+  headless = true;
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  JobScheduler scheduler(jobs, pool, readImage, readImageSize, writeImage, largeJobPixels);
+  vector<JobResult> results = scheduler.run();
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  int failed = 0;
+  cout << "line  status  frames        size  mode      seconds  output" << endl;
+  for (int i = 0; i < results.size(); i++){
+    JobResult& result = results[i];
+    stringstream size;
+    size << result.framePixels / 1000000.0 << " MP";
+    char row[96];
+    snprintf(row, sizeof(row), "%4d  %-6s  %6d  %10s  %-8s  %7.3f  ", result.line,
+             result.succeeded ? "ok" : "FAILED", result.frames, size.str().c_str(),
+             result.framesInParallel ? "frames" : "jobs", result.seconds);
+    cout << row << result.output;
+    if (!result.succeeded){
+      cout << ": " << result.error;
+      failed = failed + 1;
+    }
+    cout << endl;
+  }
+  cout << results.size() << " jobs, " << failed << " failed, " << seconds << " s, "
+       << results.size() / seconds << " jobs/s" << endl;
+  printPoolReport(cout);
+  return (failed > 0) ? 1 : 0;
+}
+
+//===============================================================================================
+/*
+runServer(string socketPath)
+
+* PURPOSE : Run as a morph server on a Unix domain socket (see MorphServer.h) until a client
+*           sends it "shutdown", called from main when the first argument is "-serve", in the
+*           form
+*
+*               morpher [options] -serve /tmp/morpher.sock
+*
+*           The options of the command line apply to every request. Clients connect with
+*           "morpher -client /tmp/morpher.sock request ...".
+* INPUTS :   param -- string socketPath; where to listen
+*            global -- headless, set to true so the pipeline skips GLUT calls
+*            global -- serverCacheMB, decoded images kept between requests
+* OUTPUTS : int, exit status of the program
+*/
+//===============================================================================================
+
+int runServer(string socketPath){
+
+  if (compressionLevel < 0 || compressionLevel > 9){
+    cerr << "Compression level must be from 0 to 9." << endl;
+    return 1;
+  }
+  headless = true;
+
+  MorphServer server(socketPath, pool, readImage, writeImage, serverCacheMB * 1048576);
+  string error;
+  if (!server.start(error)){
+    cerr << error << endl;
+    return 1;
+  }
+  cout << "Listening on " << socketPath << endl;
+  server.serve();
+  printPoolReport(cout);
+  return 0;
+}
+
+// the benchmark (bench.cpp) links this file without main, see the bench target of the Makefile
+#ifndef MORPHER_NO_MAIN
 //===============================================================================================
 /*
 main(int argc, char* argv[])
@@ -915,14 +1686,43 @@ main(int argc, char* argv[])
 
 int main(int argc, char* argv[]){
 
+  // the client passes its words on to the server untouched, they are not options of its own
+  if (argc > 3 && strcmp(argv[1], "-client") == 0){
+    string request = argv[3];
+    for (int i = 4; i < argc; i++){
+      request = request + " " + argv[i];
+    }
+    return sendRequest(argv[2], request, cout) ? 0 : 1;
+  }
+
+  parseOptions(argc, argv);
+  if (traceFilename != "" && !startTracing(traceFilename)){
+    cerr << "Could not write trace " << traceFilename << endl;
+    return 1;
+  }
+  pool = new ThreadPool(numThreads);
+
+  // batch mode renders the whole sequence and exits without opening a window
+  if (argc > 1 && strcmp(argv[1], "-b") == 0){
+    return runBatch(argc, argv);
+  }
+  // manifest mode runs a file of batch morphs, see runManifest
+  if (argc > 2 && strcmp(argv[1], "-manifest") == 0){
+    return runManifest(argv[2]);
+  }
+  // server mode answers morph requests on a socket, see runServer
+  if (argc > 2 && strcmp(argv[1], "-serve") == 0){
+    return runServer(argv[2]);
+  }
   
   // start up the glut utilities
   glutInit(&argc, argv);
   
   // create the graphics window, giving width, height, and title text
-  glutInitDisplayMode(GLUT_SINGLE | GLUT_RGBA);
+  glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
   glutInitWindowSize(WIDTH, HEIGHT);
   glutCreateWindow("morpher");
+  frameTextures = new FrameTextures(textureMB * 1048576);
   
   if (argc > 2){
 	readMultiImages(argc,argv); // read in images
@@ -943,3 +1743,4 @@ int main(int argc, char* argv[]){
   glutMainLoop();
   return 0;
 }
+#endif